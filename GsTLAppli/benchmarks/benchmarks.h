@@ -0,0 +1,77 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "benchmarks" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the
+** license defined by the Stanford Center for Reservoir Forecasting and
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#ifndef __GSTLAPPLI_BENCHMARKS_BENCHMARKS_H__
+#define __GSTLAPPLI_BENCHMARKS_BENCHMARKS_H__
+
+#include <GsTLAppli/utils/clock.h>
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+
+/** A benchmark is a function taking the command line arguments that
+ * follow the benchmark name. It returns 0 on success.
+ * To add a benchmark, declare it here and register it in main.cpp
+ */
+typedef int (*Benchmark_function)( int argc, char* argv[] );
+
+int kriging_solver_benchmark( int argc, char* argv[] );
+int neighbor_batch_benchmark( int argc, char* argv[] );
+int pixel_distance_benchmark( int argc, char* argv[] );
+int random_numbers_benchmark( int argc, char* argv[] );
+
+
+/** Runs \c f \c repeat times and returns the best time, in milliseconds.
+ * \c f is taken by reference so that it can keep the result of its last run.
+ */
+template< class Function >
+int best_time_of( Function& f, int repeat = 3 ) {
+  int best = -1;
+  for( int r = 0; r < repeat; r++ ) {
+    Qt_clock clock;
+    clock.start();
+    f();
+    int elapsed = clock.elapsed();
+    if( best < 0 || elapsed < best ) best = elapsed;
+  }
+  return best;
+}
+
+
+inline void print_timing( const std::string& name, int ms_reference, int ms ) {
+  std::cout << "  " << std::setw( 36 ) << std::left << name 
+            << std::setw( 8 ) << std::right << ms_reference << " ms "
+            << std::setw( 8 ) << ms << " ms ";
+  if( ms > 0 )
+    std::cout << "  x" << std::setprecision( 3 ) << double( ms_reference ) / double( ms );
+  std::cout << std::endl;
+}
+
+#endif
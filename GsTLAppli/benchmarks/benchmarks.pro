@@ -0,0 +1,43 @@
+######################################################################
+# Performance benchmarks of the SGeMS libraries.
+# Not part of the default build: run qmake in this directory, then
+#   sgems_benchmarks <benchmark name>
+######################################################################
+
+TEMPLATE = app
+TARGET = 
+DEPENDPATH += .
+INCLUDEPATH += .
+
+# Input
+HEADERS += benchmarks.h
+SOURCES += main.cpp \
+           kriging_solver_benchmark.cpp \
+           neighbor_batch_benchmark.cpp \
+           pixel_distance_benchmark.cpp \
+           random_numbers_benchmark.cpp
+
+TARGET=sgems_benchmarks
+
+
+
+CONFIG      += release console
+INCLUDEPATH += $(QTDIR)/tools/designer/interfaces
+
+
+contains( TEMPLATE, lib ) {
+    DESTDIR = $$GSTLAPPLI_HOME/lib/$$CUR_PLATFORM
+    OBJECTS_DIR = $$GSTLAPPLI_HOME/lib/$$CUR_PLATFORM/obj/benchmarks
+}
+contains( TEMPLATE, app ) {
+    DESTDIR += $$GSTLAPPLI_HOME/bin/$$CUR_PLATFORM
+    OBJECTS_DIR = $$GSTLAPPLI_HOME/bin/$$CUR_PLATFORM/obj/benchmarks
+}
+
+
+include( $$GSTLAPPLI_HOME/config.qmake )
+
+exists( MMakefile ) {
+   include( MMakefile )
+}
+
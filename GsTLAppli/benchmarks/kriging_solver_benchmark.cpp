@@ -0,0 +1,140 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "benchmarks" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the
+** license defined by the Stanford Center for Reservoir Forecasting and
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/benchmarks/benchmarks.h>
+#include <GsTLAppli/math/symmetric_solver.h>
+
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+
+/* Compares the ways of solving a set of simple kriging systems of the same
+ * size: LU decomposition and Cholesky decomposition.
+ * The systems are built from an exponential covariance between random
+ * points, as the systems of a sequential simulation.
+ *
+ * options: [systems_count], default 20000
+ */
+
+namespace {
+
+struct Kriging_systems {
+  int size;
+  int count;
+  std::vector<double> matrices;   // count matrices of size*size
+  std::vector<double> rhs;        // count vectors of size
+
+  Kriging_systems( int n, int systems_count ) 
+    : size( n ), count( systems_count ), 
+      matrices( n*n*systems_count ), rhs( n*systems_count ) {
+    std::vector<double> x( n+1 ), y( n+1 ), z( n+1 );
+    for( int s = 0; s < count; s++ ) {
+      // the last point is the node being estimated
+      for( int i = 0; i <= n; i++ ) {
+        x[i] = double( rand() ) / RAND_MAX * 20;
+        y[i] = double( rand() ) / RAND_MAX * 20;
+        z[i] = double( rand() ) / RAND_MAX * 5;
+      }
+      double* A = &matrices[ s*n*n ];
+      double* b = &rhs[ s*n ];
+      for( int i = 0; i < n; i++ ) {
+        for( int j = 0; j < n; j++ ) 
+          A[ i*n + j ] = covariance( x[i]-x[j], y[i]-y[j], z[i]-z[j] );
+        b[i] = covariance( x[i]-x[n], y[i]-y[n], z[i]-z[n] );
+      }
+    }
+  }
+
+  static double covariance( double dx, double dy, double dz ) {
+    return std::exp( -3 * std::sqrt( dx*dx + dy*dy + dz*dz ) / 10 );
+  }
+};
+
+
+struct Scalar_solve {
+  const Kriging_systems* systems;
+  bool cholesky;
+  double checksum;
+
+  void operator()() {
+    const int n = systems->size;
+    Symmetric_system_solver solver;
+    std::vector<double> x( n );
+    checksum = 0;
+    for( int s = 0; s < systems->count; s++ ) {
+      if( !solver.factorize( &systems->matrices[ s*n*n ], n, cholesky ) ) continue;
+      std::copy( &systems->rhs[ s*n ], &systems->rhs[ s*n ] + n, x.begin() );
+      solver.solve( &x[0] );
+      for( int i = 0; i < n; i++ ) checksum += x[i];
+    }
+  }
+};
+
+}
+
+
+
+int kriging_solver_benchmark( int argc, char* argv[] ) {
+  int systems_count = 20000;
+  if( argc >= 1 ) systems_count = atoi( argv[0] );
+
+  std::cout << systems_count << " simple kriging systems per size" << std::endl;
+  std::cout << "  " << std::setw( 36 ) << std::left << "" 
+            << std::setw( 11 ) << std::right << "LU" 
+            << std::setw( 12 ) << "other" << std::endl;
+
+  srand( 12345 );
+  const int sizes[] = { 12, 24, 48, 64 };
+  bool same = true;
+  for( unsigned int k = 0; k < sizeof( sizes ) / sizeof( int ); k++ ) {
+    Kriging_systems systems( sizes[k], systems_count );
+
+    Scalar_solve lu = { &systems, false, 0 };
+    Scalar_solve cholesky = { &systems, true, 0 };
+    int lu_time = best_time_of( lu );
+    int cholesky_time = best_time_of( cholesky );
+
+    std::ostringstream label;
+    label << sizes[k] << " unknowns";
+    print_timing( label.str() + ", Cholesky", lu_time, cholesky_time );
+
+    const double tolerance = 1e-6 * std::fabs( lu.checksum );
+    same = same && std::fabs( lu.checksum - cholesky.checksum ) <= tolerance;
+  }
+
+  if( !same ) {
+    std::cout << "  ERROR: the solvers gave different results" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "benchmarks" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the
+** license defined by the Stanford Center for Reservoir Forecasting and
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/benchmarks/benchmarks.h>
+
+#include <iostream>
+#include <string>
+#include <string.h>
+
+
+namespace {
+
+struct Benchmark_entry {
+  const char* name;
+  Benchmark_function function;
+  const char* description;
+};
+
+const Benchmark_entry benchmarks[] = {
+  { "kriging_solver", kriging_solver_benchmark,
+    "LU vs Cholesky on kriging systems of 12 to 64 unknowns" },
+  { "neighbor_batch", neighbor_batch_benchmark,
+    "per-node vs batched ellipsoid search, checks that both agree" },
+  { "pixel_distance", pixel_distance_benchmark,
+    "scalar vs vectorized weighted distances between filtersim patterns" },
+  { "random_numbers", random_numbers_benchmark,
+    "global generator vs Random_number_stream" }
+};
+
+const int benchmarks_count = sizeof( benchmarks ) / sizeof( Benchmark_entry );
+
+
+void usage( const char* program ) {
+  std::cout << "usage: " << program << " <benchmark> [options] | all\n"
+            << "available benchmarks:\n";
+  for( int i = 0; i < benchmarks_count; i++ )
+    std::cout << "  " << benchmarks[i].name << "\t" 
+              << benchmarks[i].description << "\n";
+  std::cout << std::flush;
+}
+
+}
+
+
+int main( int argc, char* argv[] ) {
+  if( argc < 2 ) {
+    usage( argv[0] );
+    return 1;
+  }
+
+  const bool run_all = strcmp( argv[1], "all" ) == 0;
+  int status = 0;
+  bool found = false;
+  for( int i = 0; i < benchmarks_count; i++ ) {
+    if( !run_all && strcmp( argv[1], benchmarks[i].name ) != 0 ) continue;
+
+    found = true;
+    std::cout << "=== " << benchmarks[i].name << " ===" << std::endl;
+    status |= benchmarks[i].function( argc-2, argv+2 );
+  }
+
+  if( !found ) {
+    usage( argv[0] );
+    return 1;
+  }
+  return status;
+}
@@ -0,0 +1,198 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "benchmarks" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the
+** license defined by the Stanford Center for Reservoir Forecasting and
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+#include <GsTLAppli/benchmarks/benchmarks.h>
+#include <GsTLAppli/grid/grid_model/cartesian_grid.h>
+#include <GsTLAppli/grid/grid_model/neighborhood.h>
+#include <GsTLAppli/grid/grid_model/geovalue.h>
+
+#include <GsTL/utils/smartptr.h>
+
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+
+
+/* Searches the neighbors of the nodes of a Cartesian grid one node at a
+ * time with find_neighbors, and by chunks of nodes with 
+ * find_neighbors_batch, as the kriging chunks do. The batch must find the
+ * same neighbors, in the same order, for every center, both on the fast
+ * path and when the neighborhood tracks the simulated centers (generic 
+ * path). 
+ *
+ * options: [nx ny nz], default 100 100 50
+ */
+
+namespace {
+
+const int chunk_size = 2048;
+
+struct Node_search {
+  Cartesian_grid* grid;
+  GsTLGridProperty* property;
+  Neighborhood* neighborhood;
+  const std::vector<GsTLInt>* centers;
+  Neighbor_batch result;
+
+  void operator()() {
+    result.clear();
+    for( unsigned int i = 0; i < centers->size(); i++ ) {
+      Geovalue center( grid, property, (*centers)[i] );
+      neighborhood->find_neighbors( center );
+      result.offsets.push_back( result.offsets.back() );
+      result.valid.push_back( neighborhood->is_valid() );
+      for( Neighborhood::iterator it = neighborhood->begin();
+           it != neighborhood->end(); ++it )
+        result.push_back( it->grid(), it->property_array(), it->node_id() );
+    }
+  }
+};
+
+
+struct Batch_search {
+  Cartesian_grid* grid;
+  GsTLGridProperty* property;
+  Neighborhood* neighborhood;
+  const std::vector<GsTLInt>* centers;
+  Neighbor_batch result;
+
+  void operator()() {
+    result.clear();
+    Neighbor_batch batch;
+    for( unsigned int first = 0; first < centers->size(); first += chunk_size ) {
+      int count = std::min( chunk_size, int( centers->size() - first ) );
+      neighborhood->find_neighbors_batch( grid, property, &(*centers)[first],
+                                          count, batch );
+      for( int i = 0; i < count; i++ ) {
+        result.offsets.push_back( result.offsets.back() );
+        result.valid.push_back( batch.valid[i] );
+        for( int j = batch.offsets[i]; j < batch.offsets[i+1]; j++ )
+          result.push_back( batch.grids[ batch.sources[j] ], 
+                            batch.properties[ batch.sources[j] ],
+                            batch.node_ids[j] );
+      }
+    }
+  }
+};
+
+
+// true if the two searches found the same neighbors for each center
+bool same_neighbors( const Neighbor_batch& a, const Neighbor_batch& b ) {
+  if( a.offsets != b.offsets || a.node_ids != b.node_ids || a.valid != b.valid )
+    return false;
+  for( unsigned int j = 0; j < a.node_ids.size(); j++ ) {
+    if( a.grids[ a.sources[j] ] != b.grids[ b.sources[j] ] ||
+        a.properties[ a.sources[j] ] != b.properties[ b.sources[j] ] )
+      return false;
+  }
+  return true;
+}
+
+
+// set_batch_neighbors must give back the neighbors of the batch 
+bool same_after_set( Cartesian_grid& grid, GsTLGridProperty* property,
+                     Neighborhood* neighborhood, 
+                     const std::vector<GsTLInt>& centers ) {
+  int count = std::min( chunk_size, int( centers.size() ) );
+  Neighbor_batch batch;
+  neighborhood->find_neighbors_batch( &grid, property, &centers[0], count, batch );
+  for( int i = 0; i < count; i++ ) {
+    Geovalue center( &grid, property, centers[i] );
+    neighborhood->set_batch_neighbors( center, batch, i );
+    if( neighborhood->center() != center || 
+        neighborhood->size() != batch.size( i ) ) return false;
+
+    int j = batch.offsets[i];
+    for( Neighborhood::iterator it = neighborhood->begin();
+         it != neighborhood->end(); ++it, ++j ) {
+      if( it->node_id() != batch.node_ids[j] ) return false;
+    }
+  }
+  return true;
+}
+
+}
+
+
+
+int neighbor_batch_benchmark( int argc, char* argv[] ) {
+  int nx = 100, ny = 100, nz = 50;
+  if( argc >= 3 ) {
+    nx = atoi( argv[0] );
+    ny = atoi( argv[1] );
+    nz = atoi( argv[2] );
+  }
+  std::cout << "grid " << nx << "x" << ny << "x" << nz << std::endl;
+
+  Cartesian_grid grid( nx, ny, nz );
+  GsTLGridProperty* data = grid.add_property( "data" );
+  GsTLGridProperty* estimate = grid.add_property( "estimate" );
+
+  // 5% of the nodes informed; the centers are the other nodes, in the 
+  // order the kriging visits them
+  srand( 12345 );
+  std::vector<GsTLInt> centers;
+  for( GsTLInt id = 0; id < grid.size(); id++ ) {
+    if( rand() % 20 == 0 ) 
+      data->set_value( float( rand() ) / float( RAND_MAX ), id );
+    else
+      centers.push_back( id );
+  }
+
+  SmartPtr<Neighborhood> neighborhood = grid.neighborhood( 20, 20, 10, 0, 0, 0 );
+  neighborhood->select_property( "data" );
+  neighborhood->max_size( 32 );
+
+  Node_search nodes = { &grid, estimate, neighborhood.raw_ptr(), &centers };
+  Batch_search batch = { &grid, estimate, neighborhood.raw_ptr(), &centers };
+  int nodes_time = best_time_of( nodes );
+  int batch_time = best_time_of( batch );
+
+  std::cout << "  " << std::setw( 36 ) << std::left << "" 
+            << std::setw( 11 ) << std::right << "per node" 
+            << std::setw( 12 ) << "batch" << std::endl;
+  print_timing( "ellipsoid search (all centers)", nodes_time, batch_time );
+
+  bool same = same_neighbors( nodes.result, batch.result ) &&
+              same_after_set( grid, estimate, neighborhood.raw_ptr(), centers );
+
+  // tracking the centers disables the fast path
+  neighborhood->track_simulated_centers( true );
+  nodes();
+  neighborhood->track_simulated_centers( true );
+  batch();
+  neighborhood->track_simulated_centers( false );
+  same = same && same_neighbors( nodes.result, batch.result );
+
+  if( !same ) {
+    std::cout << "  ERROR: the batch and per-node searches found different "
+              << "neighbors" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,162 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "benchmarks" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the
+** license defined by the Stanford Center for Reservoir Forecasting and
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+#include <GsTLAppli/benchmarks/benchmarks.h>
+#include <GsTLAppli/geostat/filtersim_std/pixel_distance.h>
+
+#include <cstdlib>
+#include <cmath>
+#include <sstream>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+
+/* Pixel-wise weighted distance between a data event and a list of 
+ * filtersim prototypes: the scalar loop of Manhattan_Distance and 
+ * Euclidean_Distance against the kernels of pixel_distance.h. 
+ * About 5% of the template nodes of the data event are uninformed. The
+ * categorical case sums one distance per facies, as 
+ * Prototype_Categorical::get_distance does.
+ *
+ * options: [number of prototypes], default 20000
+ */
+
+namespace {
+
+const float no_data_value = -9966699;
+
+float scalar_manhattan( const float* p1, const float* p2, const float* w, 
+                        int n, float no_data ) {
+  float dist = 0;
+  for( int i = 0; i < n; i++ ) {
+    if( p1[i] != no_data && p2[i] != no_data )
+      dist += std::fabs( ( p1[i] - p2[i] ) * w[i] );
+  }
+  return dist;
+}
+
+float scalar_squared( const float* p1, const float* p2, const float* w, 
+                      int n, float no_data ) {
+  float dist = 0;
+  for( int i = 0; i < n; i++ ) {
+    if( p1[i] != no_data && p2[i] != no_data ) {
+      float d = ( p1[i] - p2[i] ) * w[i];
+      dist += d*d;
+    }
+  }
+  return dist;
+}
+
+
+typedef float (*Distance_function)( const float*, const float*, const float*, 
+                                    int, float );
+
+// distance from the data event to every prototype, nb_channels channels of
+// template_size values each
+struct Prototype_scan {
+  Distance_function distance;
+  const std::vector<float>* data_event;
+  const std::vector<float>* prototypes;
+  const std::vector<float>* weights;
+  int template_size;
+  int nb_channels;
+  double sum;
+
+  void operator()() {
+    sum = 0;
+    const int pattern_size = template_size * nb_channels;
+    const int nb_prototypes = int( prototypes->size() ) / pattern_size;
+    for( int p = 0; p < nb_prototypes; p++ ) {
+      const float* prototype = &(*prototypes)[ p * pattern_size ];
+      for( int c = 0; c < nb_channels; c++ )
+        sum += distance( &(*data_event)[ c * template_size ], 
+                         prototype + c * template_size,
+                         &(*weights)[0], template_size, no_data_value );
+    }
+  }
+};
+
+
+void run_case( int nx, int ny, int nz, int nb_channels, int nb_prototypes ) {
+  const int template_size = nx*ny*nz;
+  std::vector<float> weights( template_size );
+  std::vector<float> data_event( template_size * nb_channels );
+  std::vector<float> prototypes( template_size * nb_channels * nb_prototypes );
+
+  for( int i = 0; i < template_size; i++ )
+    weights[i] = 0.5f + float( rand() ) / RAND_MAX;
+  for( int i = 0; i < int( data_event.size() ); i++ )
+    data_event[i] = ( rand() % 20 == 0 ) ? no_data_value : float( rand() ) / RAND_MAX;
+  for( int i = 0; i < int( prototypes.size() ); i++ )
+    prototypes[i] = float( rand() ) / RAND_MAX;
+
+  std::ostringstream name;
+  name << nx << "x" << ny << "x" << nz;
+  if( nb_channels > 1 ) name << ", " << nb_channels << " facies";
+
+  Prototype_scan ref_manhattan = 
+    { scalar_manhattan, &data_event, &prototypes, &weights, template_size, nb_channels, 0 };
+  Prototype_scan manhattan = 
+    { weighted_manhattan_distance, &data_event, &prototypes, &weights, template_size, nb_channels, 0 };
+  print_timing( name.str() + ", manhattan", 
+                best_time_of( ref_manhattan ), best_time_of( manhattan ) );
+
+  Prototype_scan ref_squared = 
+    { scalar_squared, &data_event, &prototypes, &weights, template_size, nb_channels, 0 };
+  Prototype_scan squared = 
+    { weighted_squared_distance, &data_event, &prototypes, &weights, template_size, nb_channels, 0 };
+  print_timing( name.str() + ", euclidean", 
+                best_time_of( ref_squared ), best_time_of( squared ) );
+
+  // the sums should only differ in the last digits
+  std::cout << "    relative differences: " << std::setprecision( 3 )
+            << std::fabs( manhattan.sum - ref_manhattan.sum ) / ref_manhattan.sum << " "
+            << std::fabs( squared.sum - ref_squared.sum ) / ref_squared.sum
+            << std::endl;
+}
+
+}
+
+
+
+int pixel_distance_benchmark( int argc, char* argv[] ) {
+  int nb_prototypes = 20000;
+  if( argc >= 1 ) nb_prototypes = atoi( argv[0] );
+
+  std::cout << "distance to " << nb_prototypes << " prototypes, kernels use: " 
+            << pixel_distance_instruction_set() << std::endl;
+  std::cout << "  " << std::setw( 36 ) << std::left << "" 
+            << std::setw( 11 ) << std::right << "scalar" 
+            << std::setw( 12 ) << "kernel" << std::endl;
+
+  run_case( 9, 9, 1, 1, nb_prototypes );
+  run_case( 11, 11, 5, 1, nb_prototypes );
+  run_case( 21, 21, 7, 1, nb_prototypes );
+  run_case( 11, 11, 5, 3, nb_prototypes );
+  return 0;
+}
@@ -0,0 +1,85 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "benchmarks" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the
+** license defined by the Stanford Center for Reservoir Forecasting and
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/benchmarks/benchmarks.h>
+#include <GsTLAppli/math/random_numbers.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+
+/* Throughput of the random number generators: the global generator used
+ * through Random_number_generator, and a Random_number_stream.
+ *
+ * options: [millions of numbers], default 20
+ */
+
+namespace {
+
+template< class Generator >
+struct Sequence_draw {
+  Generator* generator;
+  long int count;
+  double sum;
+
+  void operator()() {
+    sum = 0;
+    for( long int i = 0; i < count; i++ )
+      sum += (*generator)();
+  }
+};
+
+}
+
+
+
+int random_numbers_benchmark( int argc, char* argv[] ) {
+  long int millions = 20;
+  if( argc >= 1 ) millions = atoi( argv[0] );
+  const long int count = millions * 1000000;
+
+  std::cout << millions << " million uniform numbers" << std::endl;
+  std::cout << "  " << std::setw( 36 ) << std::left << "" 
+            << std::setw( 11 ) << std::right << "global" 
+            << std::setw( 12 ) << "other" << std::endl;
+
+  Random_number_generator global;
+  Sequence_draw<Random_number_generator> global_draw = { &global, count, 0 };
+  int global_time = best_time_of( global_draw );
+
+  Random_number_stream stream( 211175, 1 );
+  Sequence_draw<Random_number_stream> stream_draw = { &stream, count, 0 };
+  print_timing( "Random_number_stream", global_time, best_time_of( stream_draw ) );
+
+  // the means should both be close to 0.5
+  std::cout << "  means: " << std::setprecision( 5 )
+            << global_draw.sum / count << " " << stream_draw.sum / count 
+            << std::endl;
+  return 0;
+}
@@ -658,7 +658,7 @@ Sgems_folder_output_filter::write_properties(QDir dir,
 		elemProps.appendChild(elemProp);
 		prop_filename = dir.absoluteFilePath(prop_filename.c_str()).toStdString();
 
-		// We use the same format than the DiskAccessor, so that we may be able to
+		// We use the same format than the MmapAccessor, so that we may be able to
 		// construct the properties without having to load them in memory
 		// Careful potential incompatibility between 32 and 64 bits machine
 
@@ -675,8 +675,8 @@ Sgems_folder_output_filter::write_properties(QDir dir,
 			GsTLcerr << "Can't write file. Check that the directory is writable\n"
 							 << "and that there is enough disk space left" << gstlIO::end;
 		}
-		if(prop->is_in_memory()) {
 #ifdef SGEMS_ACCESSOR_LARGE_FILE
+		if(prop->is_in_memory()) {
       std::vector<float*> data = prop->data();
       long int array_size = static_cast<long int>( MemoryAccessor::MEM_SIZE_ARRAY ) * 
                              static_cast<long int>( sizeof(float) );
@@ -688,6 +688,7 @@ Sgems_folder_output_filter::write_properties(QDir dir,
                            static_cast<long int>( sizeof(float) );
       prop_stream.write( (char*) data[data.size()-1], array_size );
 #else
+		if(prop->data()) {
 			long int remaining = static_cast<long int>( prop->size() ) *
 													 static_cast<long int>( sizeof(float) );
 			prop_stream.write( (char*) prop->data(), remaining );
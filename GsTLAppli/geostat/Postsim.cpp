@@ -29,12 +29,291 @@
 #include <GsTLAppli/utils/string_manipulation.h>
 #include <GsTLAppli/grid/grid_model/geostat_grid.h>
 #include <GsTLAppli/grid/grid_model/gval_iterator.h>
+#include <GsTLAppli/grid/grid_model/bit_flags.h>
 #include <GsTLAppli/math/gstlpoint.h>
 #include <GsTLAppli/geostat/utilities.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
+#include <GsTLAppli/utils/gstl_messages.h>
 
 #include <algorithm>
 
 
+// number of consecutive nodes processed by a job. It is a multiple of the
+// 64 flags of a Bit_flags word.
+static const int postsim_block_size = 1024;
+
+// Returns the array of values of property \c prop, or 0 if the values
+// are not available as a single array (the property was swapped to disk).
+static inline const float* values_array( const GsTLGridProperty* prop ) {
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+  return prop->data();
+#else
+  return 0;
+#endif
+}
+
+
+// Computes the mean and the sum of the squared deviations from the mean of
+// the nb_real values of each of the n nodes of a block (Welford's update).
+// The values of realization k are values[k*n], ..., values[k*n + n-1]
+static void block_moments( const float* values, int n, int nb_real, 
+                           double* mean, double* m2 ) {
+  std::fill( mean, mean + n, 0.0 );
+  std::fill( m2, m2 + n, 0.0 );
+  for( int k = 0; k < nb_real; k++ ) {
+    const float* x = values + k*n;
+    const double inv = 1.0 / double( k+1 );
+    for( int i = 0; i < n; i++ ) {
+      double delta = x[i] - mean[i];
+      mean[i] += delta * inv;
+      m2[i] += delta * ( x[i] - mean[i] );
+    }
+  }
+}
+
+// Counts, for each node of a block, the values greater than or equal to 
+// threshold t (if above is true) or less than or equal to t, and sums them.
+static void block_threshold( const float* values, int n, int nb_real, 
+                             float t, bool above, double* count, double* sum ) {
+  std::fill( count, count + n, 0.0 );
+  std::fill( sum, sum + n, 0.0 );
+  for( int k = 0; k < nb_real; k++ ) {
+    const float* x = values + k*n;
+    if( above ) {
+      for( int i = 0; i < n; i++ ) {
+        double in = x[i] >= t ? 1.0 : 0.0;
+        count[i] += in;
+        sum[i] += in * x[i];
+      }
+    }
+    else {
+      for( int i = 0; i < n; i++ ) {
+        double in = x[i] <= t ? 1.0 : 0.0;
+        count[i] += in;
+        sum[i] += in * x[i];
+      }
+    }
+  }
+}
+
+
+
+/* Postsim_nodes_task computes the statistics of the realizations by blocks
+ * of postsim_block_size nodes. The values of all the realizations of a block 
+ * are copied to a buffer, one realization after the other, so that the 
+ * moments and the threshold counts are updated by loops over contiguous
+ * nodes. The values of a node are only ranked (by partial selection, no 
+ * sort) if the interquartile range or quantiles are requested.
+ * Two blocks never write to the same node.
+ */
+class Postsim_nodes_task : public Parallel_task {
+  struct Thread_data {
+    std::vector<float> values;
+    std::vector<double> mean;
+    std::vector<double> m2;
+    std::vector<double> count;
+    std::vector<double> sum;
+    std::vector<float> node_values;
+    std::vector<float> ranked_values;
+  };
+
+public:
+  Postsim_nodes_task( const Postsim* postsim, const Bit_flags& informed,
+                      int nb_threads );
+
+  int jobs_count() const {
+    return ( size_ + postsim_block_size - 1 ) / postsim_block_size;
+  }
+
+  virtual bool run( int block, int thread_id );
+
+private:
+  void read_values( float* values, int first, int n ) const;
+  void set_threshold_values( const std::vector<GsTLGridProperty*>& props,
+                             const std::vector<float>& thresholds, 
+                             bool above, bool mean, 
+                             Thread_data& data, int first, int last ) const;
+  void rank_values( Thread_data& data, int i, int n ) const;
+
+private:
+  const Postsim* postsim_;
+  const Bit_flags& informed_;
+  int size_;
+  int nb_real_;
+
+  // the distinct ranks of the requested order statistics, in increasing 
+  // order, and the positions in ranks_ of the 1st and 3rd quartiles and of
+  // each quantile
+  std::vector<int> ranks_;
+  int iqr_ranks_[2];
+  std::vector<int> quantile_ranks_;
+
+  std::vector<Thread_data> threads_data_;
+};
+
+
+Postsim_nodes_task::Postsim_nodes_task( const Postsim* postsim, 
+                                        const Bit_flags& informed, 
+                                        int nb_threads )
+  : postsim_( postsim ), informed_( informed ),
+    size_( postsim->grid_->size() ), nb_real_( postsim->props_.size() ) {
+
+  std::vector<int> ranks;
+  if( postsim->iqr_ ) {
+    int q25 = nb_real_/4;
+    ranks.push_back( q25 );
+    ranks.push_back( 3*q25 );
+  }
+  if( postsim->quantile_ ) {
+    for( unsigned int j = 0; j < postsim->quantile_vals_.size(); j++ ) {
+      int id = postsim->quantile_vals_[j]*nb_real_;
+      ranks.push_back( std::min( id, nb_real_-1 ) );
+    }
+  }
+
+  ranks_ = ranks;
+  std::sort( ranks_.begin(), ranks_.end() );
+  ranks_.erase( std::unique( ranks_.begin(), ranks_.end() ), ranks_.end() );
+  for( unsigned int j = 0; j < ranks.size(); j++ ) {
+    int pos = std::lower_bound( ranks_.begin(), ranks_.end(), ranks[j] ) - ranks_.begin();
+    if( postsim->iqr_ && j < 2 ) 
+      iqr_ranks_[j] = pos;
+    else
+      quantile_ranks_.push_back( pos );
+  }
+
+  bool need_thresholds = postsim->mean_above_ || postsim->mean_below_ ||
+                         postsim->prob_above_ || postsim->prob_below_;
+  threads_data_.resize( nb_threads );
+  for( int i = 0; i < nb_threads; i++ ) {
+    Thread_data& data = threads_data_[i];
+    data.values.resize( nb_real_ * postsim_block_size );
+    if( postsim->etype_ || postsim->cond_var_ ) {
+      data.mean.resize( postsim_block_size );
+      data.m2.resize( postsim_block_size );
+    }
+    if( need_thresholds ) {
+      data.count.resize( postsim_block_size );
+      data.sum.resize( postsim_block_size );
+    }
+    if( !ranks_.empty() ) {
+      data.node_values.resize( nb_real_ );
+      data.ranked_values.resize( ranks_.size() );
+    }
+  }
+}
+
+
+bool Postsim_nodes_task::run( int block, int thread_id ) {
+  const int first = block * postsim_block_size;
+  const int last = std::min( first + postsim_block_size, size_ );
+  const int n = last - first;
+
+  // no node of the block is informed in all the realizations
+  if( informed_.find_next( first-1 ) >= last ) return true;
+
+  Thread_data& data = threads_data_[thread_id];
+  read_values( &data.values[0], first, n );
+
+  if( postsim_->etype_ || postsim_->cond_var_ ) {
+    block_moments( &data.values[0], n, nb_real_, &data.mean[0], &data.m2[0] );
+    for( int node_id = informed_.find_next( first-1 ); node_id < last; 
+         node_id = informed_.find_next( node_id ) ) {
+      int i = node_id - first;
+      if( postsim_->etype_ )
+        postsim_->etype_prop_->set_value( data.mean[i], node_id );
+      if( postsim_->cond_var_ )
+        postsim_->cond_var_prop_->set_value( data.m2[i] / nb_real_, node_id );
+    }
+  }
+
+  if( postsim_->mean_above_ )
+    set_threshold_values( postsim_->mean_above_props_, postsim_->mean_above_vals_,
+                          true, true, data, first, last );
+  if( postsim_->mean_below_ )
+    set_threshold_values( postsim_->mean_below_props_, postsim_->mean_below_vals_,
+                          false, true, data, first, last );
+  if( postsim_->prob_above_ )
+    set_threshold_values( postsim_->prob_above_props_, postsim_->prob_above_vals_,
+                          true, false, data, first, last );
+  if( postsim_->prob_below_ )
+    set_threshold_values( postsim_->prob_below_props_, postsim_->prob_below_vals_,
+                          false, false, data, first, last );
+
+  if( ranks_.empty() ) return true;
+
+  for( int node_id = informed_.find_next( first-1 ); node_id < last; 
+       node_id = informed_.find_next( node_id ) ) {
+    rank_values( data, node_id - first, n );
+
+    if( postsim_->iqr_ ) 
+      postsim_->iqr_prop_->set_value( data.ranked_values[ iqr_ranks_[1] ] - 
+                                      data.ranked_values[ iqr_ranks_[0] ], node_id );
+    for( unsigned int j = 0; j < quantile_ranks_.size(); j++ ) 
+      postsim_->quantile_props_[j]->set_value( 
+        data.ranked_values[ quantile_ranks_[j] ], node_id );
+  }
+
+  return true;
+}
+
+
+void Postsim_nodes_task::read_values( float* values, int first, int n ) const {
+  for( int k = 0; k < nb_real_; k++ ) {
+    const GsTLGridProperty* prop = postsim_->props_[k];
+    float* dest = values + k*n;
+    const float* array = values_array( prop );
+    if( array )
+      std::copy( array + first, array + first + n, dest );
+    else {
+      for( int i = 0; i < n; i++ )
+        dest[i] = prop->get_value( first + i );
+    }
+  }
+}
+
+
+void Postsim_nodes_task::
+set_threshold_values( const std::vector<GsTLGridProperty*>& props,
+                      const std::vector<float>& thresholds, 
+                      bool above, bool mean, 
+                      Thread_data& data, int first, int last ) const {
+  const int n = last - first;
+  for( unsigned int j = 0; j < props.size(); j++ ) {
+    block_threshold( &data.values[0], n, nb_real_, thresholds[j], above, 
+                     &data.count[0], &data.sum[0] );
+    for( int node_id = informed_.find_next( first-1 ); node_id < last; 
+         node_id = informed_.find_next( node_id ) ) {
+      int i = node_id - first;
+      if( !mean ) 
+        props[j]->set_value( float( data.count[i] ) / nb_real_, node_id );
+      else if( data.count[i] > 0 ) 
+        props[j]->set_value( data.sum[i] / data.count[i], node_id );
+      else
+        props[j]->set_not_informed( node_id );
+    }
+  }
+}
+
+
+// Finds the values of ranks ranks_ among the values of node i of the block:
+// each selection only partitions the values above the previous rank
+void Postsim_nodes_task::rank_values( Thread_data& data, int i, int n ) const {
+  std::vector<float>& v = data.node_values;
+  for( int k = 0; k < nb_real_; k++ )
+    v[k] = data.values[ k*n + i ];
+
+  std::vector<float>::iterator lower = v.begin();
+  for( unsigned int j = 0; j < ranks_.size(); j++ ) {
+    std::vector<float>::iterator nth = v.begin() + ranks_[j];
+    std::nth_element( lower, nth, v.end() );
+    data.ranked_values[j] = *nth;
+    lower = nth + 1;
+  }
+}
+
+
+
 bool Postsim::initialize( const Parameters_handler* parameters,
 			Error_messages_handler* errors ) 
 {
@@ -78,6 +357,9 @@ bool Postsim::initialize( const Parameters_handler* parameters,
 	prob_below_ =   parameters->value( "prob_below.value" ) == "1";
   quantile_ =   parameters->value( "quantile.value" ) == "1";
 
+  nb_threads_ = 
+    utils::nb_threads_parameter( parameters->value( "Nb_Threads.value" ) );
+
   if( iqr_ || cond_var_ || mean_above_ || mean_below_ || quantile_ ) {
     if( props_.size() <= 1 ) {
       errors->report( "Hard_Data", "Must have more than one property for the statistics requested" );
@@ -151,106 +433,47 @@ bool Postsim::initialize( const Parameters_handler* parameters,
 
 int Postsim::execute( GsTL_project* ) { 
 
+  // Only the nodes informed in every realization are processed: 
+  // compute the intersection of the informed masks once
+  Bit_flags informed;
+  props_[0]->informed_mask( informed );
+  for(int k = 1; k < props_.size(); ++k ) {
+    Bit_flags prop_informed;
+    props_[k]->informed_mask( prop_informed );
+    informed &= prop_informed;
+  }
 
-	bool flag;
-	std::vector< GsTLGridProperty* >::const_iterator it_prop;;
-	int nprop = props_.size();
-	double sum;
-	std::vector< float > values( props_.size() );
-
-	for(int node_id=0; node_id < grid_->size(); ++node_id ) {
-		flag=true;
-		sum=0;
-		for(int k = 0; k < props_.size(); ++k ) {
-			flag = flag&& props_[k]->is_informed( node_id );
-			if(flag) values[k] = props_[k]->get_value( node_id );
-		}
-		if(flag) {
-		if(etype_ ) 
-			etype_prop_->set_value
-			( std::accumulate(values.begin(),values.end(),0.0)/props_.size(), node_id );
-
-		if(cond_var_)
-		{
-			float s2 = std::accumulate(values.begin(),values.end(),0.0,accumulate_square)/values.size();
-			float s1 = std::accumulate(values.begin(),values.end(),0.0)/values.size();
-			cond_var_prop_->set_value( s2 - std::pow(s1,2),node_id);
-		}
-
-		if(iqr_ || mean_above_ || mean_below_ || prob_above_ || prob_below_ || quantile_)
-			std::sort(values.begin(),values.end());
-
-		if(iqr_)
-		{
-			int q25  = props_.size()/4;
-			int q75 = 3*q25;
-			iqr_prop_->set_value( values[q75] - values[q25] , node_id);
-		}
-
-		if(quantile_)
-		{
-			std::vector<GsTLGridProperty*>::iterator it_prop = quantile_props_.begin();
-			std::vector<float>::iterator it_val = quantile_vals_.begin();
-
-			for(;it_prop != quantile_props_.end(); ++it_prop, ++it_val)
-			{
-        int id = (*it_val)*values.size();
-        (*it_prop)->set_value( values[id], node_id);
-			}
-		}
-
-		if(mean_above_)
-		{
-			std::vector<GsTLGridProperty*>::iterator it_prop = mean_above_props_.begin();
-			std::vector<float>::iterator it_val = mean_above_vals_.begin();
-			for(;it_prop != mean_above_props_.end(); ++it_prop, ++it_val)
-			{
-				std::vector<float>::iterator it_bnd = std::lower_bound(values.begin(),values.end(),*it_val);
-        if( (values.end()-it_bnd) > 0 )  
-				  (*it_prop)->set_value( std::accumulate(it_bnd,values.end(),0.0)/(values.end()-it_bnd), node_id);
-        else 
-          (*it_prop)->set_not_informed( node_id);
-			}
-		}
-
-		if(mean_below_)
-		{
-			std::vector<GsTLGridProperty*>::iterator it_prop = mean_below_props_.begin();
-			std::vector<float>::iterator it_val = mean_below_vals_.begin();
-			for(;it_prop != mean_below_props_.end(); ++it_prop, ++it_val)
-			{
-  			std::vector<float>::iterator it_bnd = std::upper_bound(values.begin(),values.end(),*it_val);
-        if( it_bnd-values.begin() > 0 ) 
-				  (*it_prop)->set_value( std::accumulate(values.begin(),it_bnd,0.0)/(it_bnd-values.begin()),node_id);
-        else 
-          (*it_prop)->set_not_informed( node_id);
-			}
-		}
-
-		if(prob_above_)
-		{
-			std::vector<GsTLGridProperty*>::iterator it_prop = prob_above_props_.begin();
-			std::vector<float>::iterator it_val = prob_above_vals_.begin();
-			for(;it_prop != prob_above_props_.end(); ++it_prop, ++it_val)
-			{
-				std::vector<float>::iterator it_bnd = std::lower_bound(values.begin(),values.end(),*it_val);
-				(*it_prop)->set_value( float(values.end()-it_bnd)/values.size(), node_id);
-			}
-		}
-
-		if(prob_below_)
-		{
-			std::vector<GsTLGridProperty*>::iterator it_prop = prob_below_props_.begin();
-			std::vector<float>::iterator it_val = prob_below_vals_.begin();
-			for(;it_prop != prob_below_props_.end(); ++it_prop, ++it_val)
-			{
-				std::vector<float>::iterator it_bnd = std::upper_bound(values.begin(),values.end(),*it_val);
-				(*it_prop)->set_value( float(it_bnd-values.begin())/values.size(), node_id);
-			}
-		}
-		}
+  // properties swapped to a file are read and written through a single 
+  // stream: the blocks are then processed one after the other
+  int nb_threads = 1;
+  if( nb_threads_ != 0 ) {
+    // the realizations and all the output properties
+    prop_vecT used_props( props_ );
+    if( etype_ ) used_props.push_back( etype_prop_ );
+    if( cond_var_ ) used_props.push_back( cond_var_prop_ );
+    if( iqr_ ) used_props.push_back( iqr_prop_ );
+    used_props.insert( used_props.end(), quantile_props_.begin(), quantile_props_.end() );
+    used_props.insert( used_props.end(), mean_above_props_.begin(), mean_above_props_.end() );
+    used_props.insert( used_props.end(), mean_below_props_.begin(), mean_below_props_.end() );
+    used_props.insert( used_props.end(), prob_above_props_.begin(), prob_above_props_.end() );
+    used_props.insert( used_props.end(), prob_below_props_.begin(), prob_below_props_.end() );
+
+    bool shared = true;
+    for( unsigned int k = 0; k < used_props.size(); ++k ) 
+      shared = shared && used_props[k]->can_be_shared();
+    if( shared )
+      nb_threads = utils::thread_count( nb_threads_ );
+    else
+      GsTLlog << "Postsim: some of the properties are swapped to disk, "
+              << "the nodes are processed on a single thread" << gstlIO::end;
+  }
 
-	}
+  // there is no point in having more threads than blocks
+  int nb_blocks = ( grid_->size() + postsim_block_size - 1 ) / postsim_block_size;
+  nb_threads = std::max( std::min( nb_threads, nb_blocks ), 1 );
+
+  Postsim_nodes_task task( this, informed, nb_threads );
+  utils::run_parallel( task, task.jobs_count(), nb_threads );
 
 	return 0;
 }
@@ -315,6 +538,8 @@ Postsim::Postsim() {
 	mean_below_ = false;
 	prob_above_ = false;
 	prob_below_ = false;
+  quantile_ = false;
+  nb_threads_ = 0;
 }
 
 
@@ -61,6 +61,7 @@ class  Postsim : public Geostat_algo {
 	virtual std::string name() const { return "Postsim"; }
    
   private:
+    friend class Postsim_nodes_task;
 
     int execute_continous();
     int execute_categorical();
@@ -93,6 +94,10 @@ class  Postsim : public Geostat_algo {
 	std::vector<float> prob_below_vals_;
   std::vector<float> quantile_vals_;
 
+  // The nodes are processed by blocks, on nb_threads_ threads (0: a single 
+  // thread, negative: one thread per processor core)
+  int nb_threads_;
+
 	void initialize_operation(std::vector<GsTLGridProperty*>& props, std::vector<float>& vals,
 		Error_messages_handler* errors, const Parameters_handler* parameters, std::string base_name);
 
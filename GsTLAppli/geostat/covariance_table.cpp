@@ -0,0 +1,126 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/geostat/covariance_table.h>
+#include <GsTLAppli/grid/grid_model/rgrid.h>
+#include <GsTLAppli/grid/grid_model/rgrid_neighborhood.h>
+
+#include <GsTL/math/math_functions.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+
+Grid_covariance_table::Grid_covariance_table()
+  : Covariance<Location>() {
+  clear_table();
+}
+
+
+Grid_covariance_table::Grid_covariance_table( const Covariance<Location>& cov )
+  : Covariance<Location>( cov ) {
+  clear_table();
+}
+
+
+Grid_covariance_table& 
+Grid_covariance_table::operator = ( const Covariance<Location>& cov ) {
+  if( &cov != this ) {
+    Covariance<Location>::operator=( cov );
+    clear_table();
+  }
+  return *this;
+}
+
+
+void Grid_covariance_table::clear_table() {
+  table_.clear();
+  max_i_ = max_j_ = max_k_ = -1;
+  table_nx_ = table_nxy_ = 0;
+}
+
+
+bool Grid_covariance_table::build_table( const Geostat_grid* grid,
+                                         const GsTLTripletTmpl<double>& ranges, 
+                                         const GsTLTripletTmpl<double>& angles ) {
+  clear_table();
+
+  const RGrid* rgrid = dynamic_cast<const RGrid*>( grid );
+  if( !rgrid ) return false;
+
+  const GsTLCoordVector& cell_dims = rgrid->geometry()->cell_dims();
+  if( cell_dims.x() <= 0 || cell_dims.y() <= 0 || cell_dims.z() <= 0 ) 
+    return false;
+
+  // Get the template of the search ellipsoid the same way the regular grid
+  // neighborhoods do, and use its bounding box as the extent of the table
+  int rx = GsTL::round( ranges[0] / cell_dims.x() );
+  int ry = GsTL::round( ranges[1] / cell_dims.y() );
+  int rz = GsTL::round( ranges[2] / cell_dims.z() );
+  Ellipsoid_rasterizer rasterizer( 2*rgrid->nx()+1, 2*rgrid->ny()+1, 
+                                   2*rgrid->nz()+1, 
+                                   rx, ry, rz, 
+                                   angles[0], angles[1], angles[2] );
+  std::vector< Ellipsoid_rasterizer::EuclideanVector >& templ = 
+    rasterizer.rasterize();
+  if( templ.empty() ) return false;
+
+  int max_i = 0, max_j = 0, max_k = 0;
+  for( unsigned int n = 0; n < templ.size(); n++ ) {
+    max_i = std::max( max_i, std::abs( templ[n].x() ) );
+    max_j = std::max( max_j, std::abs( templ[n].y() ) );
+    max_k = std::max( max_k, std::abs( templ[n].z() ) );
+  }
+
+  const int nx = 2*max_i + 1;
+  const int ny = 2*max_j + 1;
+  const int nz = 2*max_k + 1;
+  std::vector<double> table( nx*ny*nz );
+
+  const Location origin( 0, 0, 0 );
+  for( int k = -max_k; k <= max_k; k++ ) {
+    for( int j = -max_j; j <= max_j; j++ ) {
+      for( int i = -max_i; i <= max_i; i++ ) {
+        Location u( i * cell_dims.x(), j * cell_dims.y(), k * cell_dims.z() );
+        table[ (k+max_k)*nx*ny + (j+max_j)*nx + i+max_i ] = 
+          model_value( origin, u );
+      }
+    }
+  }
+
+  table_.swap( table );
+  max_i_ = max_i;
+  max_j_ = max_j;
+  max_k_ = max_k;
+  table_nx_ = nx;
+  table_nxy_ = nx*ny;
+  inverse_cell_dims_ = GsTLCoordVector( 1.0 / cell_dims.x(), 
+                                        1.0 / cell_dims.y(),
+                                        1.0 / cell_dims.z() );
+  return true;
+}
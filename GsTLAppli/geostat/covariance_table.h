@@ -0,0 +1,129 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#ifndef __GSTLAPPLI_GEOSTAT_COVARIANCE_TABLE_H__
+#define __GSTLAPPLI_GEOSTAT_COVARIANCE_TABLE_H__
+
+
+#include <GsTLAppli/geostat/common.h>
+#include <GsTLAppli/grid/grid_model/geostat_grid.h>
+#include <GsTLAppli/math/gstlpoint.h>
+#include <GsTLAppli/math/gstlvector.h>
+
+#include <GsTL/geometry/covariance.h>
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+
+
+/** Grid_covariance_table is a covariance model that can also look up its
+* values in a table (as the covtab array of GSLIB). If the two locations 
+* are nodes of a regular grid, the covariance only depends on the integer
+* offset (di,dj,dk) between the two nodes: the covariances for all the
+* offsets of the search template are computed once by \c build_table(), 
+* and then read from the table instead of being evaluated through the 
+* anisotropy transforms and covariance models.
+* Pairs of locations whose offset is not a whole number of cells, or is 
+* larger than the template, are evaluated with the covariance model.
+*
+* The table is not updated if the model is changed after \c build_table()
+* was called.
+*/
+class GEOSTAT_DECL Grid_covariance_table : public Covariance<GsTLPoint> {
+ public:
+  typedef GsTLPoint Location;
+  typedef Location::difference_type EuclideanVector;
+
+ public:
+  Grid_covariance_table();
+  Grid_covariance_table( const Covariance<Location>& cov );
+  virtual ~Grid_covariance_table() {}
+
+  /** Replaces the covariance model. The table is cleared.
+  */
+  Grid_covariance_table& operator = ( const Covariance<Location>& cov );
+
+  /** Computes the covariances between a node of \c grid and all the nodes
+  * in the search ellipsoid of dimensions \c ranges (in actual units, not 
+  * in number of cells) and orientation \c angles. 
+  * @return false, and clears the table, if \c grid is not a regular grid.
+  */
+  bool build_table( const Geostat_grid* grid,
+                    const GsTLTripletTmpl<double>& ranges, 
+                    const GsTLTripletTmpl<double>& angles );
+  void clear_table();
+  bool has_table() const { return !table_.empty(); }
+
+  virtual double operator()( const Location& u1, const Location& u2 ) const;
+
+ private:
+  double model_value( const Location& u1, const Location& u2 ) const {
+    return Covariance<Location>::operator()( u1, u2 );
+  }
+
+ private:
+  std::vector<double> table_;
+
+  // half extents of the table, in number of cells
+  int max_i_, max_j_, max_k_;
+  // dimensions of the table: (2*max_i_+1) and (2*max_i_+1)*(2*max_j_+1)
+  int table_nx_, table_nxy_;
+
+  GsTLCoordVector inverse_cell_dims_;
+};
+
+
+
+inline double 
+Grid_covariance_table::operator()( const Location& u1, 
+                                   const Location& u2 ) const {
+  if( table_.empty() ) return model_value( u1, u2 );
+
+  EuclideanVector h = u2 - u1;
+  double fi = h.x() * inverse_cell_dims_.x();
+  double fj = h.y() * inverse_cell_dims_.y();
+  double fk = h.z() * inverse_cell_dims_.z();
+  int i = int( std::floor( fi + 0.5 ) );
+  int j = int( std::floor( fj + 0.5 ) );
+  int k = int( std::floor( fk + 0.5 ) );
+
+  // The zero offset is left to the model: it decides whether the nugget
+  // applies to two distinct locations that are very close to each other.
+  const double tolerance = 1e-6;
+  if( std::abs( i ) > max_i_ || std::abs( j ) > max_j_ || 
+      std::abs( k ) > max_k_ || ( i == 0 && j == 0 && k == 0 ) ||
+      std::fabs( fi - i ) > tolerance || std::fabs( fj - j ) > tolerance || 
+      std::fabs( fk - k ) > tolerance )
+    return model_value( u1, u2 );
+
+  return table_[ (k+max_k_)*table_nxy_ + (j+max_j_)*table_nx_ + i+max_i_ ];
+}
+
+
+#endif
@@ -87,7 +87,9 @@ execute( PrototypeType& proto, std::vector< ScoresType >& grouped_score  )
 
 /*
  * class Prototype_kmeans
- * to divide one prototype into a set of sub-prototypes
+ * to divide one prototype into a set of sub-prototypes.
+ * The k-means runs on nb_threads threads (see Kmeans), and the centroids 
+ * of the prototypes with many replicates are first estimated on mini-batches.
  */
 class GEOSTAT_DECL Prototype_kmeans
 {
@@ -95,16 +97,22 @@ public:
 	typedef std::pair< int, std::vector<float> > OneScoreType;
 	typedef std::vector< OneScoreType > ScoresType; 
 
+	enum { mini_batch_size = 10000 };
+
 public:
-	Prototype_kmeans( ){};
-	Prototype_kmeans(int k_groups):k_(k_groups){};
+	Prototype_kmeans( ) : nb_threads_( 0 ) {};
+	Prototype_kmeans(int k_groups, int nb_threads = 0)
+		: k_(k_groups), nb_threads_(nb_threads) {};
 	~Prototype_kmeans(){};
 
+	// the group of each replicate, returned in "group", will be used to 
+	// create new prototypes. Returns the number of groups
 	template< class PrototypeType > 
-	bool execute( PrototypeType& proto, std::vector< ScoresType >& grouped_score  ); 
+	int execute( PrototypeType& proto, std::vector<int>& group ); 
 
 private :
 	int k_;
+	int nb_threads_;
 };
 
 
@@ -112,14 +120,15 @@ private :
  * operator function of classification
  */
 template< class PrototypeType >
-bool Prototype_kmeans::
-execute( PrototypeType& proto, std::vector< ScoresType >& grouped_score  )
+int Prototype_kmeans::
+execute( PrototypeType& proto, std::vector<int>& group )
 {
-	Kmeans< OneScoreType > kmeans;
+	Kmeans< OneScoreType > kmeans( nb_threads_, mini_batch_size );
 
-	kmeans(proto.get_score(),grouped_score,k_);
+	int nb_groups = k_;
+	kmeans.classify( proto.get_score(), group, nb_groups );
 
-	return true;
+	return nb_groups;
 }
 
 
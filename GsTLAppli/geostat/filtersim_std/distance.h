@@ -36,6 +36,9 @@
 #include <GsTL/math/math_functions.h>
 
 #include <iterator>
+#include <vector>
+
+#include "pixel_distance.h"
 
 // return the square value 
 template <typename T>
@@ -55,6 +58,132 @@ abs(const T& value)
 }   // abs
 
 
+/*
+ * weighted sums of the distance terms between two patterns, ignoring the
+ * uninformed nodes. The overloads for vectors of floats use the vectorized
+ * kernels of pixel_distance.h, the templates are used for other iterators.
+ * The versions with a "shortest_dist" argument stop as soon as the sum 
+ * exceeds it, and return false; otherwise they write the sum in it.
+ */
+template <class InputIterator1, class InputIterator2, class WeightIterator, class T>
+inline T
+weighted_manhattan_sum( InputIterator1 p1_begin, InputIterator1 p1_end, 
+                        InputIterator2 p2_begin, WeightIterator weight_begin,
+                        T no_data_value )
+{
+    T dist=(T)(0);
+    for (; p1_begin!=p1_end; p1_begin++, p2_begin++, weight_begin++)
+    {
+        // only count the informed nodes
+        if ( !GsTL::equals( *p1_begin, no_data_value ) && !GsTL::equals( *p2_begin, no_data_value ) )
+            dist += abs( ( *p1_begin - *p2_begin )*(*weight_begin) );
+    }
+    return dist;
+}
+
+template <class InputIterator1, class InputIterator2, class WeightIterator, class T>
+inline bool
+weighted_manhattan_sum( InputIterator1 p1_begin, InputIterator1 p1_end, 
+                        InputIterator2 p2_begin, WeightIterator weight_begin,
+                        T no_data_value, T& shortest_dist )
+{
+    T dist=(T)(0);
+    for (; p1_begin!=p1_end; p1_begin++, p2_begin++, weight_begin++)
+    {
+        // only count the informed nodes
+        if ( !GsTL::equals( *p1_begin, no_data_value ) && !GsTL::equals( *p2_begin, no_data_value ) )
+        {
+            dist += abs( ( *p1_begin - *p2_begin )*(*weight_begin) );
+            if(dist>shortest_dist)  return false;
+        }
+    }
+    shortest_dist = dist;
+    return true;
+}
+
+template <class InputIterator1, class InputIterator2, class WeightIterator, class T>
+inline T
+weighted_squared_sum( InputIterator1 p1_begin, InputIterator1 p1_end, 
+                      InputIterator2 p2_begin, WeightIterator weight_begin,
+                      T no_data_value )
+{
+    T dist=(T)(0);
+    for (; p1_begin!=p1_end; p1_begin++, p2_begin++, weight_begin++)
+    {
+        // only count the informed nodes
+        if ( !GsTL::equals( *p1_begin, no_data_value ) && !GsTL::equals( *p2_begin, no_data_value ) )
+            dist += sqr( ( *p1_begin - *p2_begin )*(*weight_begin) );
+    }
+    return dist;
+}
+
+template <class InputIterator1, class InputIterator2, class WeightIterator, class T>
+inline bool
+weighted_squared_sum( InputIterator1 p1_begin, InputIterator1 p1_end, 
+                      InputIterator2 p2_begin, WeightIterator weight_begin,
+                      T no_data_value, T& shortest_dist )
+{
+    T dist=(T)(0);
+    for (; p1_begin!=p1_end; p1_begin++, p2_begin++, weight_begin++)
+    {
+        // only count the informed nodes
+        if ( !GsTL::equals( *p1_begin, no_data_value ) && !GsTL::equals( *p2_begin, no_data_value ) )
+        {
+            dist += sqr( ( *p1_begin - *p2_begin )*(*weight_begin) );
+            if(dist>shortest_dist)  return false;
+        }
+    }
+    shortest_dist = dist;
+    return true;
+}
+
+
+typedef std::vector<float>::iterator FloatVectorIterator;
+
+inline float
+weighted_manhattan_sum( FloatVectorIterator p1_begin, FloatVectorIterator p1_end, 
+                        FloatVectorIterator p2_begin, FloatVectorIterator weight_begin,
+                        float no_data_value )
+{
+    if ( p1_begin == p1_end )   return 0.f;
+    return weighted_manhattan_distance( &(*p1_begin), &(*p2_begin), &(*weight_begin), 
+                                        int( p1_end-p1_begin ), no_data_value );
+}
+
+inline bool
+weighted_manhattan_sum( FloatVectorIterator p1_begin, FloatVectorIterator p1_end, 
+                        FloatVectorIterator p2_begin, FloatVectorIterator weight_begin,
+                        float no_data_value, float& shortest_dist )
+{
+    if ( p1_begin == p1_end )   { shortest_dist = 0.f; return true; }
+    return weighted_manhattan_distance( &(*p1_begin), &(*p2_begin), &(*weight_begin), 
+                                        int( p1_end-p1_begin ), no_data_value, 
+                                        shortest_dist );
+}
+
+inline float
+weighted_squared_sum( FloatVectorIterator p1_begin, FloatVectorIterator p1_end, 
+                      FloatVectorIterator p2_begin, FloatVectorIterator weight_begin,
+                      float no_data_value )
+{
+    if ( p1_begin == p1_end )   return 0.f;
+    return weighted_squared_distance( &(*p1_begin), &(*p2_begin), &(*weight_begin), 
+                                      int( p1_end-p1_begin ), no_data_value );
+}
+
+inline bool
+weighted_squared_sum( FloatVectorIterator p1_begin, FloatVectorIterator p1_end, 
+                      FloatVectorIterator p2_begin, FloatVectorIterator weight_begin,
+                      float no_data_value, float& shortest_dist )
+{
+    if ( p1_begin == p1_end )   { shortest_dist = 0.f; return true; }
+    return weighted_squared_distance( &(*p1_begin), &(*p2_begin), &(*weight_begin), 
+                                      int( p1_end-p1_begin ), no_data_value, 
+                                      shortest_dist );
+}
+
+
+
 /*
  * template class Manhattan_Distance
  * calculate the Manhattan distance between two vector of same length
@@ -97,24 +226,13 @@ public:
     result_type operator() ( InputIterator1 p1_begin, InputIterator1 p1_end, 
                              InputIterator2 p2_begin, WeightIterator weight_begin)
 	{
-        result_type dist=(result_type)(0);
-
-        InputIterator1 itr1 = p1_begin;
-        InputIterator2 itr2 = p2_begin;
-        WeightIterator wtr = weight_begin;
-
-		for (; itr1!=p1_end; itr1++, itr2++, wtr++)
-        {
-            // only count the informed nodes
-            if ( !GsTL::equals( *itr1, UNINFORMED ) && !GsTL::equals( *itr2, UNINFORMED ) )
-                dist += abs( ( *itr1 - *itr2 )*(*wtr) );
-        }
-
-        return dist;
+        return weighted_manhattan_sum( p1_begin, p1_end, p2_begin, weight_begin, UNINFORMED );
 	}
     
 
-    // overloaded function, retun the distance between two vectors
+    // overloaded function, retun the distance between two vectors in 
+    // shortest_dist. The calculation is terminated, and false returned, as
+    // soon as the distance is larger than the given shortest distance
     bool operator() ( InputIterator1 p1_begin, InputIterator1 p1_end, 
                       InputIterator2 p2_begin, result_type& shortest_dist)
 	{
@@ -144,24 +262,8 @@ public:
                       InputIterator2 p2_begin, WeightIterator weight_begin,
                       result_type& shortest_dist )
 	{
-        result_type dist=(result_type)(0);
-
-        InputIterator1 itr1 = p1_begin;
-        InputIterator2 itr2 = p2_begin;
-        WeightIterator wtr = weight_begin;
-
-		for (; itr1!=p1_end; itr1++, itr2++, wtr++)
-        {
-            // only count the informed nodes
-            if ( !GsTL::equals( *itr1, UNINFORMED ) && !GsTL::equals( *itr2, UNINFORMED ) )
-            {
-                dist += abs( ( *itr1 - *itr2 )*(*wtr) );
-                if(dist>shortest_dist)  return false;
-            }
-        }
-
-        shortest_dist = dist;
-        return true;
+        return weighted_manhattan_sum( p1_begin, p1_end, p2_begin, weight_begin, 
+                                       UNINFORMED, shortest_dist );
 	}
 
 private:
@@ -211,28 +313,20 @@ public:
     result_type operator() ( InputIterator1 p1_begin, InputIterator1 p1_end, 
                              InputIterator2 p2_begin, WeightIterator weight_begin)
 	{
-        result_type dist=(result_type)(0);
-
-        InputIterator1 itr1 = p1_begin;
-        InputIterator2 itr2 = p2_begin;
-        WeightIterator wtr = weight_begin;
-
-		for (; itr1!=p1_end; itr1++, itr2++, wtr++)
-        {
-            // only count the informed nodes
-            if ( !GsTL::equals( *itr1, UNINFORMED ) && !GsTL::equals( *itr2, UNINFORMED ) )
-                dist += sqr( ( *itr1 - *itr2 )*(*wtr) );
-        }
-
-        return std::sqrt( dist );
+        return std::sqrt( weighted_squared_sum( p1_begin, p1_end, p2_begin, 
+                                                weight_begin, UNINFORMED ) );
     }
 
-    // overloaded function, retun the distance between two vectors
+    // overloaded function, retun the distance between two vectors in 
+    // shortest_dist. The calculation is terminated, and false returned, as
+    // soon as the distance is larger than the given shortest distance
     bool operator() ( InputIterator1 p1_begin, InputIterator1 p1_end, 
                       InputIterator2 p2_begin, result_type& shortest_dist)
 	{
         result_type dist=(result_type)(0);
-        result_type opt_dist = sqrt( shortest_dist );
+        // the squared distance is accumulated: compare it to the square of
+        // the shortest distance, with a margin for the rounding errors
+        result_type opt_dist = shortest_dist * shortest_dist * (result_type)(1.000001);
 
         InputIterator1 itr1=p1_begin;
         InputIterator2 itr2=p2_begin;
@@ -247,7 +341,7 @@ public:
             }
         }
 
-        shortest_dist = dist;
+        shortest_dist = std::sqrt( dist );
         return true;
 	}
 
@@ -258,24 +352,15 @@ public:
                       InputIterator2 p2_begin, WeightIterator weight_begin,
                       result_type& shortest_dist)
 	{
-        result_type dist=(result_type)(0);
-        result_type opt_dist = sqrt( shortest_dist );
+        // the squared distance is accumulated: compare it to the square of
+        // the shortest distance, with a margin for the rounding errors
+        result_type opt_dist = shortest_dist * shortest_dist * (result_type)(1.000001);
 
-        InputIterator1 itr1 = p1_begin;
-        InputIterator2 itr2 = p2_begin;
-        WeightIterator wtr = weight_begin;
+        if ( !weighted_squared_sum( p1_begin, p1_end, p2_begin, weight_begin, 
+                                    UNINFORMED, opt_dist ) )
+            return false;
 
-		for (; itr1!=p1_end; itr1++, itr2++, wtr++)
-        {
-            // only count the informed nodes
-            if ( !GsTL::equals( *itr1, UNINFORMED ) && !GsTL::equals( *itr2, UNINFORMED ) )
-            {
-                dist += sqr( ( *itr1 - *itr2 )*(*wtr) );
-                if(dist>opt_dist)  return false;
-            }
-        }
-
-        shortest_dist = dist;
+        shortest_dist = std::sqrt( opt_dist );
         return true;
 	}
     
@@ -0,0 +1,510 @@
+/**********************************************************************
+** Author: Jianbing Wu, Alexandre Boucher
+** Contributor: Tuanfeng Zhang
+**
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Stanford Geostatistical 
+** Earth Modeling Software (SGEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include "filter_scores.h"
+#include "filters.h"
+#include "pattern.h"
+#include "pattern_store.h"
+
+#include <GsTLAppli/grid/grid_model/rgrid.h>
+#include <GsTLAppli/grid/grid_model/grid_property.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
+
+#include <cmath>
+#include <algorithm>
+
+
+namespace {
+
+  // the fft method is not used if the fft grid has more nodes than this
+  const int max_fft_size = 1 << 24;
+
+  int next_power_of_2( int n ) 
+  {
+      int p = 1;
+      while( p < n ) p *= 2;
+      return p;
+  }
+
+}
+
+
+/// -----------------------------------------------
+// for class "Filter_convolution"
+
+Filter_convolution::Filter_convolution( int nx, int ny, int nz, 
+                                        int hx, int hy, int hz, int spacing )
+    : nx_( nx ), ny_( ny ), nz_( nz ), hx_( hx ), hy_( hy ), hz_( hz ), 
+      spacing_( spacing ), values_( 0 )
+{
+    px_ = next_power_of_2( nx );
+    py_ = next_power_of_2( ny );
+    pz_ = next_power_of_2( nz );
+}
+
+
+bool Filter_convolution::has_interior() const
+{
+    return nx_ > 2*spacing_*hx_ && ny_ > 2*spacing_*hy_ && nz_ > 2*spacing_*hz_;
+}
+
+
+bool Filter_convolution::is_interior( int i, int j, int k ) const
+{
+    return i >= spacing_*hx_ && i < nx_ - spacing_*hx_ &&
+           j >= spacing_*hy_ && j < ny_ - spacing_*hy_ &&
+           k >= spacing_*hz_ && k < nz_ - spacing_*hz_;
+}
+
+
+/*
+ * the separable weights are always convolved in 1-D. Otherwise the fft is
+ * used if it is expected to be cheaper than the direct convolution.
+ */
+Filter_convolution::Method 
+Filter_convolution::method( const std::vector<float>& weights ) const
+{
+    std::vector<double> a, b, c;
+    if( factorize( weights, a, b, c ) ) return separable;
+
+    double nb_interior = double( nx_ - 2*spacing_*hx_ ) * 
+                         double( ny_ - 2*spacing_*hy_ ) * 
+                         double( nz_ - 2*spacing_*hz_ );
+    double nb_weights = double( weights.size() - 
+                                std::count( weights.begin(), weights.end(), 0.f ) );
+    double fft_size = double( px_ ) * double( py_ ) * double( pz_ );
+
+    // a forward and an inverse transform per filter
+    double direct_cost = nb_interior * nb_weights;
+    double fft_cost = 10. * fft_size * std::log( fft_size ) / std::log( 2.0 );
+
+    if( fft_size <= max_fft_size && fft_cost < direct_cost ) return fft;
+    return direct;
+}
+
+
+void Filter_convolution::set_values( const float* values, bool with_fft )
+{
+    values_ = values;
+    spectrum_.clear();
+    if( !with_fft ) return;
+
+    spectrum_.assign( px_*py_*pz_, std::complex<double>( 0., 0. ) );
+    for( int k = 0; k < nz_; k++ )
+        for( int j = 0; j < ny_; j++ )
+            for( int i = 0; i < nx_; i++ )
+                spectrum_[ i + px_*( j + py_*k ) ] = values[ i + nx_*( j + ny_*k ) ];
+
+    fft_3d( spectrum_, false );
+}
+
+
+void Filter_convolution::convolve( const std::vector<float>& weights, float* out,
+                                   Workspace& work ) const
+{
+    std::vector<double> a, b, c;
+    if( factorize( weights, a, b, c ) ) 
+        convolve_separable( a, b, c, out, work.tmp );
+    else if( !spectrum_.empty() && method( weights ) == fft )
+        convolve_fft( weights, out, work.kernel );
+    else
+        convolve_direct( weights, out );
+}
+
+
+void Filter_convolution::convolve( const std::vector<float>& weights, float* out ) const
+{
+    Workspace work;
+    convolve( weights, out, work );
+}
+
+
+/*
+ * the factors are read on the lines through the largest weight, then all 
+ * the weights are checked against the product.
+ */
+bool Filter_convolution::factorize( const std::vector<float>& weights, 
+                                    std::vector<double>& a, std::vector<double>& b, 
+                                    std::vector<double>& c ) const
+{
+    const int sx = 2*hx_+1;
+    const int sy = 2*hy_+1;
+    const int sz = 2*hz_+1;
+    if( int( weights.size() ) != sx*sy*sz ) return false;
+
+    int pivot = 0;
+    for( int t = 1; t < int( weights.size() ); t++ )
+        if( std::fabs( weights[t] ) > std::fabs( weights[pivot] ) ) pivot = t;
+
+    const int i0 = pivot % sx;
+    const int j0 = ( pivot / sx ) % sy;
+    const int k0 = pivot / ( sx*sy );
+    const double w0 = weights[pivot];
+
+    a.assign( sx, 0. );
+    b.assign( sy, 0. );
+    c.assign( sz, 0. );
+    if( w0 == 0. ) return true;
+
+    for( int i = 0; i < sx; i++ ) a[i] = weights[ i + sx*( j0 + sy*k0 ) ];
+    for( int j = 0; j < sy; j++ ) b[j] = weights[ i0 + sx*( j + sy*k0 ) ] / w0;
+    for( int k = 0; k < sz; k++ ) c[k] = weights[ i0 + sx*( j0 + sy*k ) ] / w0;
+
+    const double tolerance = 1e-6 * std::fabs( w0 );
+    for( int k = 0; k < sz; k++ )
+        for( int j = 0; j < sy; j++ )
+            for( int i = 0; i < sx; i++ ) {
+                double w = weights[ i + sx*( j + sy*k ) ];
+                if( std::fabs( w - a[i]*b[j]*c[k] ) > tolerance ) return false;
+            }
+
+    return true;
+}
+
+
+void Filter_convolution::convolve_direct( const std::vector<float>& weights, 
+                                          float* out ) const
+{
+    // offsets and weights of the non-zero template nodes
+    std::vector<int> offsets;
+    std::vector<double> coefs;
+    int t = 0;
+    for( int k = -hz_; k <= hz_; k++ )
+        for( int j = -hy_; j <= hy_; j++ )
+            for( int i = -hx_; i <= hx_; i++, t++ ) {
+                if( weights[t] == 0.f ) continue;
+                offsets.push_back( spacing_*( i + nx_*( j + ny_*k ) ) );
+                coefs.push_back( weights[t] );
+            }
+
+    const int n = offsets.size();
+    for( int k = spacing_*hz_; k < nz_ - spacing_*hz_; k++ )
+        for( int j = spacing_*hy_; j < ny_ - spacing_*hy_; j++ )
+            for( int i = spacing_*hx_; i < nx_ - spacing_*hx_; i++ ) {
+                const int id = i + nx_*( j + ny_*k );
+                double sum = 0.;
+                for( int m = 0; m < n; m++ )
+                    sum += coefs[m] * values_[ id + offsets[m] ];
+                out[id] = float( sum );
+            }
+}
+
+
+/*
+ * one pass along each axis. Each pass only computes the nodes needed by
+ * the next passes.
+ */
+void Filter_convolution::convolve_separable( const std::vector<double>& a, 
+                                             const std::vector<double>& b,
+                                             const std::vector<double>& c, 
+                                             float* out, 
+                                             std::vector<float>& tmp ) const
+{
+    const int i_min = spacing_*hx_, i_max = nx_ - spacing_*hx_;
+    const int j_min = spacing_*hy_, j_max = ny_ - spacing_*hy_;
+    const int k_min = spacing_*hz_, k_max = nz_ - spacing_*hz_;
+    const int nxy = nx_*ny_;
+
+    // tmp is only read where the pass along y wrote
+    tmp.resize( nx_*ny_*nz_ );
+
+    // along x: values -> out
+    for( int k = 0; k < nz_; k++ )
+        for( int j = 0; j < ny_; j++ )
+            for( int i = i_min; i < i_max; i++ ) {
+                const int id = i + nx_*j + nxy*k;
+                double sum = 0.;
+                for( int m = 0; m < int( a.size() ); m++ )
+                    if( a[m] != 0. ) sum += a[m] * values_[ id + spacing_*( m - hx_ ) ];
+                out[id] = float( sum );
+            }
+
+    // along y: out -> tmp
+    for( int k = 0; k < nz_; k++ )
+        for( int j = j_min; j < j_max; j++ )
+            for( int i = i_min; i < i_max; i++ ) {
+                const int id = i + nx_*j + nxy*k;
+                double sum = 0.;
+                for( int m = 0; m < int( b.size() ); m++ )
+                    if( b[m] != 0. ) sum += b[m] * out[ id + spacing_*nx_*( m - hy_ ) ];
+                tmp[id] = float( sum );
+            }
+
+    // along z: tmp -> out
+    for( int k = k_min; k < k_max; k++ )
+        for( int j = j_min; j < j_max; j++ )
+            for( int i = i_min; i < i_max; i++ ) {
+                const int id = i + nx_*j + nxy*k;
+                double sum = 0.;
+                for( int m = 0; m < int( c.size() ); m++ )
+                    if( c[m] != 0. ) sum += c[m] * tmp[ id + spacing_*nxy*( m - hz_ ) ];
+                out[id] = float( sum );
+            }
+}
+
+
+/*
+ * The kernel is stored at the opposite of the template offsets, so that
+ * the circular convolution gives the score. The interior nodes never read 
+ * values across the border of the fft grid, hence the fft grid only needs 
+ * to be as large as the training image.
+ */
+void Filter_convolution::convolve_fft( const std::vector<float>& weights, 
+                                       float* out,
+                                       std::vector< std::complex<double> >& kernel ) const
+{
+    kernel.assign( spectrum_.size(), std::complex<double>( 0., 0. ) );
+    int t = 0;
+    for( int k = -hz_; k <= hz_; k++ )
+        for( int j = -hy_; j <= hy_; j++ )
+            for( int i = -hx_; i <= hx_; i++, t++ ) {
+                if( weights[t] == 0.f ) continue;
+                int ki = i > 0 ? px_ - spacing_*i : -spacing_*i;
+                int kj = j > 0 ? py_ - spacing_*j : -spacing_*j;
+                int kk = k > 0 ? pz_ - spacing_*k : -spacing_*k;
+                kernel[ ki + px_*( kj + py_*kk ) ] += double( weights[t] );
+            }
+
+    fft_3d( kernel, false );
+    for( unsigned int m = 0; m < kernel.size(); m++ )
+        kernel[m] *= spectrum_[m];
+    fft_3d( kernel, true );
+
+    const double scale = 1.0 / double( kernel.size() );
+    for( int k = spacing_*hz_; k < nz_ - spacing_*hz_; k++ )
+        for( int j = spacing_*hy_; j < ny_ - spacing_*hy_; j++ )
+            for( int i = spacing_*hx_; i < nx_ - spacing_*hx_; i++ )
+                out[ i + nx_*( j + ny_*k ) ] = 
+                    float( kernel[ i + px_*( j + py_*k ) ].real() * scale );
+}
+
+
+/*
+ * in-place radix-2 transform, n must be a power of 2. The inverse 
+ * transform is not scaled.
+ */
+void Filter_convolution::fft_1d( std::complex<double>* data, int n, bool inverse )
+{
+    if( n < 2 ) return;
+
+    // bit reversal permutation
+    for( int i = 1, j = 0; i < n; i++ ) {
+        int bit = n >> 1;
+        for( ; j & bit; bit >>= 1 ) j ^= bit;
+        j ^= bit;
+        if( i < j ) std::swap( data[i], data[j] );
+    }
+
+    const double pi = 3.14159265358979323846;
+    for( int len = 2; len <= n; len <<= 1 ) {
+        const double angle = ( inverse ? 2. : -2. ) * pi / double( len );
+        const int half = len / 2;
+        for( int m = 0; m < half; m++ ) {
+            const std::complex<double> w( std::cos( angle*m ), std::sin( angle*m ) );
+            for( int i = m; i < n; i += len ) {
+                std::complex<double> u = data[i];
+                std::complex<double> v = data[i+half] * w;
+                data[i] = u + v;
+                data[i+half] = u - v;
+            }
+        }
+    }
+}
+
+
+void Filter_convolution::fft_3d( std::vector< std::complex<double> >& data, 
+                                 bool inverse ) const
+{
+    // along x: the rows are contiguous
+    for( int r = 0; r < py_*pz_; r++ )
+        fft_1d( &data[ r*px_ ], px_, inverse );
+
+    // along y and z: each line is copied to a buffer
+    std::vector< std::complex<double> > line( std::max( py_, pz_ ) );
+    if( py_ > 1 ) {
+        for( int k = 0; k < pz_; k++ )
+            for( int i = 0; i < px_; i++ ) {
+                const int first = i + px_*py_*k;
+                for( int j = 0; j < py_; j++ ) line[j] = data[ first + px_*j ];
+                fft_1d( &line[0], py_, inverse );
+                for( int j = 0; j < py_; j++ ) data[ first + px_*j ] = line[j];
+            }
+    }
+    if( pz_ > 1 ) {
+        const int pxy = px_*py_;
+        for( int r = 0; r < pxy; r++ ) {
+            for( int k = 0; k < pz_; k++ ) line[k] = data[ r + pxy*k ];
+            fft_1d( &line[0], pz_, inverse );
+            for( int k = 0; k < pz_; k++ ) data[ r + pxy*k ] = line[k];
+        }
+    }
+}
+
+
+
+/// -----------------------------------------------
+// filter scores of a training image
+
+namespace {
+
+  /*
+   * Each job computes the scores of one filter. The scores are written 
+   * in column "first_column + filter id" of the pattern store. The same
+   * task is run for each facies, so that the buffers of the threads are
+   * only allocated once.
+   */
+  class Filter_scores_task : public Parallel_task 
+  {
+  public:
+      Filter_scores_task( const Filter_convolution& convolution, Filter* filters,
+                          const std::vector<int>& centers, Pattern_store& score,
+                          int nb_threads, int size )
+          : convolution_( convolution ), filters_( filters ), centers_( centers ),
+            score_( score ), first_column_( 0 ), 
+            buffers_( nb_threads ), size_( size ) {}
+
+      void set_first_column( int first_column ) { first_column_ = first_column; }
+
+      virtual bool run( int filter, int thread_id ) 
+      {
+          Thread_buffers& buffers = buffers_[thread_id];
+          std::vector<float>& out = buffers.out;
+          if( int( out.size() ) != size_ ) out.resize( size_ );
+
+          convolution_.convolve( filters_->get_weights( filter ), &out[0], 
+                                 buffers.work );
+
+          // each job writes its own column: no need to lock
+          float* column = score_.column( first_column_ + filter );
+          for( unsigned int n = 0; n < centers_.size(); n++ )
+              column[n] = out[ centers_[n] ];
+          return true;
+      }
+
+  private:
+      // the buffers of a thread are reused for all the filters it convolves
+      struct Thread_buffers {
+          std::vector<float> out;
+          Filter_convolution::Workspace work;
+      };
+
+      const Filter_convolution& convolution_;
+      Filter* filters_;
+      const std::vector<int>& centers_;
+      Pattern_store& score_;
+      int first_column_;
+      std::vector< Thread_buffers > buffers_;
+      int size_;
+  };
+
+}
+
+
+void compute_filter_scores( RGrid* training_image, 
+                            const std::string& property_name,
+                            Filter* filters, int ncoarse, int nb_facies,
+                            Pattern_store& score, int nb_threads )
+{
+    const int nx = training_image->nx();
+    const int ny = training_image->ny();
+    const int nz = training_image->nz();
+    const int size = nx*ny*nz;
+    const int nb_filter = filters->get_total_filter_number();
+
+    int hx, hy, hz;
+    filters->get_template_half_size( hx, hy, hz );
+    const int spacing = int( std::pow( 2.0, ncoarse-1 ) );
+
+    score.resize( 0, 0 );
+    Filter_convolution convolution( nx, ny, nz, hx, hy, hz, spacing );
+    if( !convolution.has_interior() || nb_filter == 0 ) return;
+
+    // copy the property: the node ids are linear (i fastest)
+    const GsTLGridProperty* prop = training_image->property( property_name );
+    std::vector<float> values( size, 0.f );
+    std::vector<float> uninformed( size, 0.f );
+    for( int id = 0; id < size; id++ ) {
+        if( prop->is_informed( id ) )
+            values[id] = prop->get_value( id );
+        else
+            uninformed[id] = 1.f;
+    }
+
+    // a node has a score if all the nodes of its window are informed
+    std::vector<float> nb_uninformed( size, 0.f );
+    convolution.set_values( &uninformed[0], false );
+    convolution.convolve( std::vector<float>( (2*hx+1)*(2*hy+1)*(2*hz+1), 1.f ),
+                          &nb_uninformed[0] );
+
+    // the centers, sorted by node id
+    std::vector<int> centers;
+    for( Geostat_grid::iterator node_iter = training_image->begin(); 
+         node_iter != training_image->end();  node_iter++ ) 
+    {
+        const int loc = node_iter->node_id();
+        const int i = loc % nx;
+        const int j = ( loc / nx ) % ny;
+        const int k = loc / ( nx*ny );
+        if( convolution.is_interior( i, j, k ) && nb_uninformed[loc] < 0.5f )
+            centers.push_back( loc );
+    }
+    std::sort( centers.begin(), centers.end() );
+
+    const int nb_channels = nb_facies > 0 ? nb_facies : 1;
+    score.resize( centers.size(), nb_filter*nb_channels );
+    for( unsigned int n = 0; n < centers.size(); n++ ) 
+        score.node_id( n ) = centers[n];
+
+    bool with_fft = false;
+    for( int f = 0; f < nb_filter; f++ )
+        with_fft = with_fft || 
+            convolution.method( filters->get_weights( f ) ) == Filter_convolution::fft;
+
+    const int threads = nb_threads == 0 ? 1 :
+        std::min( utils::thread_count( nb_threads ), nb_filter );
+
+    Filter_scores_task task( convolution, filters, centers, score, threads, size );
+
+    // a categorical variable is convolved one facies indicator at a time
+    std::vector<float> indicator;
+    for( int c = 0; c < nb_channels; c++ ) {
+        if( nb_facies > 0 ) {
+            indicator.assign( size, 0.f );
+            for( int loc = 0; loc < size; loc++ )
+                if( !uninformed[loc] && int( values[loc] ) == c ) indicator[loc] = 1.f;
+            convolution.set_values( &indicator[0], with_fft );
+        }
+        else
+            convolution.set_values( &values[0], with_fft );
+
+        task.set_first_column( c*nb_filter );
+        utils::run_parallel( task, nb_filter, threads );
+    }
+}
@@ -0,0 +1,148 @@
+/**********************************************************************
+** Author: Jianbing Wu, Alexandre Boucher
+** Contributor: Tuanfeng Zhang
+**
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Stanford Geostatistical 
+** Earth Modeling Software (SGEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+
+
+#ifndef __filtersim_filter_scores_H__
+#define __filtersim_filter_scores_H__
+
+#include <GsTLAppli/geostat/common.h>
+
+#include <vector>
+#include <complex>
+#include <string>
+#include <utility>
+
+class RGrid;
+class Filter;
+class Pattern_store;
+
+
+/*
+ * class Filter_convolution
+ * computes the score of a filter at all the nodes of a training image 
+ * stored as a dense array (i fastest, then j, then k). 
+ * The filter template is the rectangular window of half size (hx, hy, hz) 
+ * returned by Filter::get_window_geometry, with nodes "spacing" cells apart.
+ * The score at node u is 
+ *      sum_t  weight[t] * value[ u + spacing*offset_t ]
+ * and is only computed at the interior nodes, whose whole window is inside
+ * the grid.
+ *
+ * The score is computed by three 1-D convolutions if the weights are 
+ * separable, ie weight(i,j,k) = a(i)*b(j)*c(k) (it is the case of all the 
+ * default filters), by FFT if the template is large, and directly otherwise.
+ */
+class GEOSTAT_DECL Filter_convolution
+{
+public:
+    enum Method { direct, separable, fft };
+
+    /*
+     * the buffers used by convolve. A thread keeps its workspace from one 
+     * filter to the next, so that the fft kernel (as large as the fft grid)
+     * and the separable passes do not allocate for each filter.
+     */
+    struct Workspace {
+        std::vector< std::complex<double> > kernel;
+        std::vector<float> tmp;
+    };
+
+public:
+    Filter_convolution( int nx, int ny, int nz, 
+                        int hx, int hy, int hz, int spacing );
+
+    // false if no window fits in the grid
+    bool has_interior() const;
+    bool is_interior( int i, int j, int k ) const;
+
+    // the method used to convolve with the given weights
+    Method method( const std::vector<float>& weights ) const;
+
+    /*
+     * sets the values to convolve. If "with_fft" is true, the spectrum 
+     * of the values is computed for the filters that use the fft method.
+     * The values are not copied.
+     */
+    void set_values( const float* values, bool with_fft );
+
+    /*
+     * writes the scores of the filter in "out" (nx*ny*nz values), at the 
+     * interior nodes only. Can be called by several threads at once, each
+     * with its own workspace.
+     */
+    void convolve( const std::vector<float>& weights, float* out, 
+                   Workspace& work ) const;
+    void convolve( const std::vector<float>& weights, float* out ) const;
+
+    // weight(i,j,k) = a(i)*b(j)*c(k) up to a relative tolerance
+    bool factorize( const std::vector<float>& weights, std::vector<double>& a, 
+                    std::vector<double>& b, std::vector<double>& c ) const;
+
+private:
+    void convolve_direct( const std::vector<float>& weights, float* out ) const;
+    void convolve_separable( const std::vector<double>& a, const std::vector<double>& b,
+                             const std::vector<double>& c, float* out,
+                             std::vector<float>& tmp ) const;
+    void convolve_fft( const std::vector<float>& weights, float* out,
+                       std::vector< std::complex<double> >& kernel ) const;
+
+    static void fft_1d( std::complex<double>* data, int n, bool inverse );
+    void fft_3d( std::vector< std::complex<double> >& data, bool inverse ) const;
+
+private:
+    int nx_, ny_, nz_;
+    int hx_, hy_, hz_;
+    int spacing_;
+    int px_, py_, pz_;      // size of the fft grid (powers of 2)
+
+    const float* values_;
+    std::vector< std::complex<double> > spectrum_;
+};
+
+
+/*
+ * computes the raw (not normalized) filter scores of all the nodes of the 
+ * training image whose window is inside the grid and fully informed, 
+ * ordered by linear node id. The previous content of "score" is replaced.
+ * For a categorical variable (nb_facies > 0) the scores are computed on 
+ * the indicator of each facies, and ordered first in filter id, then in 
+ * facies id. For a continuous variable, nb_facies must be 0.
+ * The filters are processed by nb_threads threads: 0 for a single thread,
+ * all the processor cores if nb_threads<0.
+ */
+GEOSTAT_DECL
+void compute_filter_scores( RGrid* training_image, 
+                            const std::string& property_name,
+                            Filter* filters, int ncoarse, int nb_facies,
+                            Pattern_store& score, int nb_threads = 0 );
+
+
+#endif  // __filtersim_filter_scores_H__
@@ -68,6 +68,10 @@ public:
     Grid_template* get_dual_window_geometry(int ncoarse, int nx, int ny, int nz);
 
     int get_total_filter_number() { return nfilter_; }
+
+    // return the half size of the searching template
+    void get_template_half_size( int& nxdt, int& nydt, int& nzdt ) const 
+    { nxdt = nxdt_; nydt = nydt_; nzdt = nzdt_; }
     string get_filter_name(int cur_filter) { return filter_name[cur_filter]; }
 
     // return the score load weights for a certain filter
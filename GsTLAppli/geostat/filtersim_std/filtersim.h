@@ -130,7 +130,7 @@ private:
 
     template <class CPrototype > void  create_prototypelist( vector<CPrototype>& proto_list, int nreal, int ncoarse, int nb_facies,
                                                     Window_neighborhood* TI_neighbors, Window_neighborhood* patch_neighbors, 
-                                                    ScoresType& cur_score, int cmin_replicates_ );
+                                                    Pattern_store* cur_score, int cmin_replicates_ );
 
     // for initialize() function
     void get_debug_level( const Parameters_handler* parameters );
@@ -211,6 +211,10 @@ private:
 	std::vector<int> cmin_replicates_;
     int treat_cate_as_cont_;
 
+    // number of threads computing the filter scores and the k-means
+    // classification (0: a single thread)
+    int nb_threads_;
+
     // for target control
     vector<float> target_cpdf_;
     vector<float> current_prop_;
@@ -45,6 +45,7 @@
 #include <GsTLAppli/utils/string_manipulation.h>
 #include <GsTLAppli/utils/progress_notifier.h>
 #include <GsTLAppli/utils/string_manipulation.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
 #include <GsTLAppli/math/random_numbers.h>
 
 #include <sstream>
@@ -89,6 +90,7 @@ Filtersim_Cate::Filtersim_Cate()
 	is_viewscore_ = 0;
     is_view_intermediate_ = 0;
     is_view_indicator_ = 0;
+    nb_threads_ = 0;
 
     is_dist_from_pixel_ = 0;
     use_default_filter_ = 0;
@@ -126,6 +128,8 @@ bool Filtersim_Cate::initialize( const Parameters_handler* parameters,
     transcon_data_ = String_Op::to_number<int>(parameters->value( "Trans_Result.value" ));
 
     seed_ = String_Op::to_number<int>( parameters->value( "Seed.value" ) );
+    nb_threads_ = 
+      utils::nb_threads_parameter( parameters->value( "Nb_Threads.value" ) );
     if ( seed_ == 0 )
     {
         error_mesgs->report( "Seed", "The seed number cannot be zero" );
@@ -1536,19 +1540,19 @@ bool Filtersim_Cate::simulate_one_realization( SmartPtr<Progress_notifier>& prog
         // the level of training image should always be 1
         training_image_->set_level( 1 );
 
-        ScoresType cur_score;
+        SmartPtr<Pattern_store> cur_score = new Pattern_store;
 
         GsTLcout << "Creating filter scores ..."  << gstlIO::end;
 
         const std::clock_t timer_start = std::clock();
 
-        create_filter_scores( training_image_, cur_score, 
+        create_filter_scores( training_image_, *cur_score, 
                                         my_filters_, ncoarse, is_viewscore_,
                                         treat_cate_as_cont_, nb_facies_, 
                                         training_property_name_, scoreProps_, nreal,
-                                        max_value_, min_value_ ); 
+                                        max_value_, min_value_, nb_threads_ );
 
-        if ( cur_score.size() == 0 )     continue;          // the TI is too small, hence no score is calculated
+        if ( cur_score->empty() )     continue;          // the TI is too small, hence no score is calculated
 
         const std::clock_t timer_end = std::clock();
         const float run_time = ( timer_end - timer_start ) / CLOCKS_PER_SEC;
@@ -1612,7 +1616,7 @@ bool Filtersim_Cate::simulate_one_realization( SmartPtr<Progress_notifier>& prog
         {
             PrototypeListType1 proto_list1_;
             create_prototypelist( proto_list1_, nreal, ncoarse, nb_facies_, TI_neighbors, patch_neighbors, 
-                                                                    cur_score, cmin_replicates_[ncoarse-1]);
+                                                                    cur_score.raw_ptr(), cmin_replicates_[ncoarse-1]);
 
             appli_message("Simulating patterns ... ");
 
@@ -1678,7 +1682,7 @@ bool Filtersim_Cate::simulate_one_realization( SmartPtr<Progress_notifier>& prog
         {
             PrototypeListType2 proto_list2_;
             create_prototypelist( proto_list2_, nreal, ncoarse, nb_facies_, TI_neighbors, patch_neighbors, 
-                                                                    cur_score, cmin_replicates_[ncoarse-1]);
+                                                                    cur_score.raw_ptr(), cmin_replicates_[ncoarse-1]);
 
             appli_message("Simulating patterns ... ");
 
@@ -1911,14 +1915,15 @@ Filtersim_Cate::create_prototypelist( CPrototype& proto_list,
                                                      int nreal, int ncoarse, int nb_facies,
                                                      Window_neighborhood* TI_neighbors,
                                                      Window_neighborhood* patch_neighbors, 
-                                                     ScoresType& cur_score, 
+                                                     Pattern_store* cur_score, 
                                                      int cmin_replicates_ )
 {
     appli_message("Creating prototype list ... ");
 
     //GsTLcout << "Creating prototype list ..."  << gstlIO::end;
     proto_list = CPrototype( training_image_, TI_neighbors, patch_neighbors, cur_score, 
-                                            filter_weight_,  nb_facies, cmin_replicates_, nb_bins_, nb_bins_2nd_ );
+                                            filter_weight_,  nb_facies, cmin_replicates_, nb_bins_, nb_bins_2nd_,
+                                            nb_threads_ );
 
     // create the whole pattern prototype list
     proto_list.create_prototype_list();
@@ -101,7 +101,7 @@ operator () ( Prototype& prototype )
 {
     // randomly draw a pattern id from the prototype
 	int pattern_id = floor( gen_()* (prototype.get_replicates()-1) );
-	return (prototype.get_score()).operator[](pattern_id).first;
+	return prototype.get_node_id( pattern_id );
 }
 
 /* // there is no more servo-system
@@ -119,9 +119,9 @@ operator () ( Prototype& prototype )
     // total number of replicates of current prototype
     int nb_replicates = prototype.get_replicates();
 
-    // facies proportions for each replicates
-    vector< vector<float> > each_pattern_prop = prototype.each_pattern_prop();
-    int nb_facies = each_pattern_prop[0].size();
+    // facies proportions for each replicates, nb_facies values per replicate
+    const vector<float>& each_pattern_prop = prototype.each_pattern_prop();
+    int nb_facies = each_pattern_prop.size()/nb_replicates;
 
     // traning image only has two facies
     // refer to Tuanfeng's thesis for the detailed algorithm
@@ -130,7 +130,7 @@ operator () ( Prototype& prototype )
         lambda = target_pdf_[1]/std::max(EPSILON, current_histogram_[1]/nb_of_data_);
 
         for(int repl = 0; repl < nb_replicates; repl++) 
-            v1.push_back( each_pattern_prop[repl][1] );
+            v1.push_back( each_pattern_prop[repl*nb_facies+1] );
     }
     else    // more than two facies
     {
@@ -139,7 +139,7 @@ operator () ( Prototype& prototype )
             vector<float> temp_vec(nb_facies,0.0);
             for(int i=0; i<nb_facies; i++)
             {
-                temp_vec[i] = fabs( ( nb_templ_*each_pattern_prop[repl][i] +
+                temp_vec[i] = fabs( ( nb_templ_*each_pattern_prop[repl*nb_facies+i] +
                                       current_histogram_[i] )/(nb_of_data_ + nb_templ_) 
                                     - target_pdf_[i] );
             }
@@ -194,7 +194,7 @@ operator () ( list<Prototype>& prototype )
     // randomly draw a pattern id from the prototype
 	int pattern_id = floor( gen_()* (itr->get_replicates()-1) );
 
-	return (itr->get_score()).operator[](pattern_id).first;
+	return itr->get_node_id( pattern_id );
 }
 
 
@@ -276,7 +276,7 @@ operator () ( Prototype& prototype )
 {
     // randomly draw a pattern id from the prototype
 	int pattern_id = floor( gen_()* (prototype.get_replicates()-1) );
-	return (prototype.get_score()).operator[](pattern_id).first;
+	return prototype.get_node_id( pattern_id );
 }
 
 /* // there is no more servo-system
@@ -341,7 +341,7 @@ operator () ( list<Prototype>& prototype )
     // randomly draw a pattern id from the prototype
 	int pattern_id = floor( gen_()* (itr->get_replicates()-1) );
 
-	return (itr->get_score()).operator[](pattern_id).first;
+	return itr->get_node_id( pattern_id );
 }
 
 
@@ -32,6 +32,7 @@
 #define __kernelized_kmeans_H__
 
 #include <GsTLAppli/geostat/common.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
 #include <GsTL/math/random_number_generators.h>
 #include <vector>
 #include <algorithm>
@@ -40,11 +41,13 @@
 
 #define TOL 1e-7
 #define MAX_ITER 500
+#define MAX_MINI_BATCH_ITER 100
+#define MINI_BATCH_TOL 1e-6
 
 
 
 template< class Vec >
-bool is_cluster_empty(Vec vec){
+bool is_cluster_empty(const Vec& vec){
 	return vec.empty();
 }
 
@@ -65,9 +68,161 @@ bool equal_score(Scores s1, Scores s2){
 	return true;
 }
 
+/*
+ * class Score_pairs
+ * the scores of a vector of (node id, scores) pairs, accessed as a matrix:
+ * (i,j) is score j of pair i. The k-means works on any class with the 
+ * same interface (see also Pattern_range_scores).
+ */
+template< class XResponse >
+class Score_pairs 
+{
+public:
+    Score_pairs( const std::vector<XResponse>& x ) : x_( x ) {}
+
+    int size() const { return x_.size(); }
+    int dimension() const { return x_.empty() ? 0 : x_[0].second.size(); }
+    float operator()( int i, int j ) const { return x_[i].second[j]; }
+
+private:
+    const std::vector<XResponse>& x_;
+};
+
+
+/*
+ * nearest centroid of a score, the centroids being stored one after the other
+ * in "means"
+ */
+inline int nearest_centroid( const float* score, int nb_filter, const float* means, 
+                             int n_clusters )
+{
+    int id_cl = 0;
+    float min_dist = 0;
+    for( int i=0; i<n_clusters; i++, means += nb_filter )
+    {
+        float dist = 0;
+        for( int j=0; j<nb_filter; j++ )
+        {
+            const float diff = score[j] - means[j];
+            dist += diff*diff;
+        }
+
+        if( i == 0 || dist < min_dist )
+        {
+            min_dist = dist;
+            id_cl = i;
+        }
+    }
+    return id_cl;
+}
+
+
+/*
+ * class Kmeans_assignment_task
+ * assigns the scores to their nearest centroid, by blocks of scores. Each 
+ * block keeps its own sums of scores per cluster: they are reduced in the
+ * block order, hence the centroids do not depend on the number of threads.
+ */
+template < class Scores >
+class Kmeans_assignment_task : public Parallel_task 
+{
+public:
+    enum { block_size = 2048 };
+
+public:
+    Kmeans_assignment_task( const Scores& x, int n_clusters, 
+                            std::vector<int>& cluster_indicator )
+        : x_( x ), n_clusters_( n_clusters ), nb_filter_( x.dimension() ),
+          cluster_indicator_( cluster_indicator ),
+          sums_( nb_blocks()*n_clusters*x.dimension() ),
+          counts_( nb_blocks()*n_clusters ), changed_( nb_blocks() ), means_( 0 ) {}
+
+    int nb_blocks() const { return ( x_.size() + block_size - 1 ) / block_size; }
+
+    // assigns all the scores, on nb_threads threads
+    bool assign( const std::vector<float>& means, int nb_threads ) 
+    {
+        means_ = &means[0];
+        return utils::run_parallel( *this, nb_blocks(), nb_threads );
+    }
+
+    virtual bool run( int index, int )
+    {
+        double* sums = &sums_[ index*n_clusters_*nb_filter_ ];
+        int* counts = &counts_[ index*n_clusters_ ];
+        std::fill( sums, sums + n_clusters_*nb_filter_, 0.0 );
+        std::fill( counts, counts + n_clusters_, 0 );
+        changed_[index] = 0;
+
+        std::vector<float> score( nb_filter_ );
+        const int last = std::min( x_.size(), ( index+1 )*int( block_size ) );
+        for( int repl = index*block_size; repl < last; repl++ )
+        {
+            for( int j=0; j<nb_filter_; j++ )
+                score[j] = x_( repl, j );
+            int id_cl = nearest_centroid( &score[0], nb_filter_, means_, n_clusters_ );
+
+            if( cluster_indicator_[repl] != id_cl ) changed_[index] = 1;
+            cluster_indicator_[repl] = id_cl;
+
+            double* sum = sums + id_cl*nb_filter_;
+            for( int j=0; j<nb_filter_; j++ )
+                sum[j] += score[j];
+            counts[id_cl]++;
+        }
+        return true;
+    }
+
+    // true if a score changed of cluster during the last assignment
+    bool changed() const 
+    {
+        return std::find( changed_.begin(), changed_.end(), 1 ) != changed_.end();
+    }
+
+    // moves the centroid of each non-empty cluster to the mean of its scores
+    void update_means( std::vector<float>& means ) const
+    {
+        std::vector<double> sums( n_clusters_*nb_filter_, 0.0 );
+        std::vector<int> counts( n_clusters_, 0 );
+        for( int b=0; b<nb_blocks(); b++ )
+        {
+            for( int i=0; i<n_clusters_*nb_filter_; i++ )
+                sums[i] += sums_[ b*n_clusters_*nb_filter_ + i ];
+            for( int i=0; i<n_clusters_; i++ )
+                counts[i] += counts_[ b*n_clusters_ + i ];
+        }
+
+        for( int i=0; i<n_clusters_; i++ ) 
+        {
+            if( counts[i] == 0 ) continue;
+            for( int j=0; j<nb_filter_; j++ )
+                means[ i*nb_filter_ + j ] = float( sums[ i*nb_filter_ + j ] / counts[i] );
+        }
+    }
+
+private:
+    const Scores& x_;
+    int n_clusters_;
+    int nb_filter_;
+    std::vector<int>& cluster_indicator_;
+
+    std::vector<double> sums_;
+    std::vector<int> counts_;
+    std::vector<char> changed_;
+    const float* means_;
+};
+
+
+
 /*
  * class Kmeans
- * the based class perform K-Mean clusters classification on score vector
+ * the based class perform K-Mean clusters classification on score vector.
+ * The scores are assigned to the clusters on nb_threads threads (a single
+ * thread if nb_threads is 0, all the processor cores if nb_threads<0).
+ * If a batch size is given and there are more than 4 batches of scores, the
+ * centroids are first estimated by mini-batch k-means, each iteration only 
+ * using a random sample of batch_size scores. The full iterations then start
+ * from these centroids, and usually converge in a few steps.
  */
 template < class XResponse >
 class   Kmeans 
@@ -78,156 +233,206 @@ public:
 	typedef std::vector< float > meansT;
 
 public:
-	Kmeans(){};
+	Kmeans( int nb_threads = 0, int batch_size = 0 )
+		: nb_threads_( nb_threads ), batch_size_( batch_size ) {};
 	~Kmeans(){};
 
-	bool operator()(clusterT& x,  std::vector<clusterT>& new_cluster,int n_clusters );
+	bool operator()( const clusterT& x, std::vector<clusterT>& new_cluster, int n_clusters );
+
+	// classifies the scores of x (see Score_pairs): cluster[i] is the cluster
+	// of score i. The empty clusters are removed, and n_clusters is set to
+	// the number of clusters left.
+	template< class Scores >
+	bool classify( const Scores& x, std::vector<int>& cluster, int& n_clusters );
 
 protected :
-	std::vector< std::vector<float> > initialize_cluster(clusterT& x,int& n_clusters);
+	template< class Scores >
+	meansT initialize_cluster( const Scores& x, int& n_clusters );
+
+	template< class Scores >
+	void mini_batch( const Scores& x, meansT& means, int n_clusters );
+
+private :
+	int nb_threads_;
+	int batch_size_;
 };
 
 
 
 /*
- * function to initialize the centroid location for kmean clusters
+ * function to initialize the centroid location for kmean clusters: 
+ * the centroids are distinct scores drawn at random. They are returned one 
+ * after the other in a single vector.
  */
 template< class XResponse >
-std::vector< std::vector<float> > Kmeans<XResponse>::
-initialize_cluster(clusterT& x, int& n_clusters)
+template< class Scores >
+typename Kmeans<XResponse>::meansT Kmeans<XResponse>::
+initialize_cluster( const Scores& x, int& n_clusters )
 {
-	clusterT x_copy(x);
+    const int nb_filter = x.dimension();
+
+    // visit the scores in random order, and keep the ones that differ from
+    // all the scores already kept
+    std::vector<int> order( x.size() );
+    for( int i=0; i<x.size(); i++ ) order[i] = i;
 
-    // sort the input scores, and only keep the unique ones
-    std::stable_sort(x_copy.begin(), x_copy.end(), less_than_score<typename clusterT::value_type> );
-    typename clusterT::iterator it_unique_last = std::unique(x_copy.begin(), x_copy.end(), equal_score< typename clusterT::value_type> );
-    
     STL_generator gen;
-    std::random_shuffle(x_copy.begin(), it_unique_last, gen );
+    std::random_shuffle( order.begin(), order.end(), gen );
+
+    std::vector<int> seeds;
+    for( int i=0; i<int( order.size() ) && int( seeds.size() ) < n_clusters; i++ )
+    {
+        bool is_unique = true;
+        for( int s=0; s<int( seeds.size() ) && is_unique; s++ )
+        {
+            int j=0;
+            while( j<nb_filter && x( seeds[s], j ) == x( order[i], j ) ) j++;
+            is_unique = j < nb_filter;
+        }
+
+        if( is_unique ) seeds.push_back( order[i] );
+    }
 
     // reset the number of clusters if necessary
-	if( std::distance(x_copy.begin(),it_unique_last) < n_clusters )  
-		n_clusters = std::distance(x_copy.begin(),it_unique_last)/2;
+	if( int( seeds.size() ) < n_clusters )  
+		n_clusters = seeds.size()/2;
 
     n_clusters = max(2, n_clusters);    // at least has two clusters
 
     // calculate the centroid locations
-	std::vector<meansT> means_groups(n_clusters);
+	meansT means( n_clusters*nb_filter );
  
 	for(int i=0; i< n_clusters; i++ )
-		means_groups[i] = x_copy[i].second;
+    {
+        for( int j=0; j<nb_filter; j++ )
+            means[ i*nb_filter + j ] = x( seeds[ i % seeds.size() ], j );
+    }
 
-	return means_groups;
+	return means;
 }
 
 
+/*
+ * mini-batch k-means: each iteration assigns a random sample of the scores
+ * to their nearest centroid, then moves the centroids toward these scores 
+ * with a rate decreasing as the clusters grow.
+ */
+template< class XResponse >
+template< class Scores >
+void Kmeans<XResponse>::
+mini_batch( const Scores& x, meansT& means, int n_clusters )
+{
+    const int nb_filter = x.dimension();
+    std::vector<float> batch( batch_size_*nb_filter );
+    std::vector<int> batch_cluster( batch_size_ );
+    std::vector<int> n_element_cluster( n_clusters, 0 );
+    meansT previous_means;
+
+    STL_generator gen;
+    for( int iter=0; iter<MAX_MINI_BATCH_ITER; iter++ )
+    {
+        for( int b=0; b<batch_size_; b++ )
+        {
+            float* score = &batch[ b*nb_filter ];
+            const int repl = gen( x.size() );
+            for( int j=0; j<nb_filter; j++ )
+                score[j] = x( repl, j );
+            batch_cluster[b] = nearest_centroid( score, nb_filter, &means[0], n_clusters );
+        }
+
+        previous_means = means;
+        for( int b=0; b<batch_size_; b++ )
+        {
+            const float* score = &batch[ b*nb_filter ];
+            const int id_cl = batch_cluster[b];
+            const float rate = 1.0f / ++n_element_cluster[id_cl];
+
+            float* mean = &means[ id_cl*nb_filter ];
+            for( int j=0; j<nb_filter; j++ )
+                mean[j] += rate * ( score[j] - mean[j] );
+        }
+
+        // stop when the centroids hardly move
+        double shift = 0, norm = 0;
+        for( int i=0; i<int( means.size() ); i++ )
+        {
+            const double diff = means[i] - previous_means[i];
+            shift += diff*diff;
+            norm += means[i]*means[i];
+        }
+        if( shift <= MINI_BATCH_TOL * norm ) break;
+    }
+}
+
 
 /*
- * main operator function of general kmean cluster algorithm
+ * main function of general kmean cluster algorithm
  */
 template< class XResponse>
+template< class Scores >
 bool Kmeans<XResponse>::
-operator ()(clusterT& x, std::vector<clusterT>& kmeans_clusters, int nb_clusters )
+classify( const Scores& x, std::vector<int>& cluster_indicator, int& n_clusters )
 {
-    int n_clusters = nb_clusters;
-    int nb_filter = x[0].second.size();
-    typedef typename clusterT::iterator it_xT;
+    cluster_indicator.assign( x.size(), -1 );
+    if( x.size() == 0 ) 
+    {
+        n_clusters = 0;
+        return true;
+    }
 
     // initialize the centroid locations
-	std::vector<meansT> means_clusters = initialize_cluster(x,n_clusters);
-	kmeans_clusters.resize(n_clusters);
-	int id_cl;
-    int repl;
+	meansT means_clusters = initialize_cluster(x,n_clusters);
+    if( batch_size_ > 0 && x.size() > 4*batch_size_ )
+        mini_batch( x, means_clusters, n_clusters );
 
-    // declare an indicator to record the cluster index
-    int n_replicates = x.size();
-    std::vector<int> cluster_indicator(n_replicates,-1);
-    bool no_more_switch;
+    Kmeans_assignment_task<Scores> assignment( x, n_clusters, cluster_indicator );
+    const int nb_threads = nb_threads_ == 0 ? 1 : utils::thread_count( nb_threads_ );
+    bool no_more_switch = false;
 
 	for (int iter=0; iter<MAX_ITER; iter++)
 	{
-        repl=0;
-        no_more_switch = true;
-
-		std::vector<float> dists(n_clusters);
-		meansT mean( nb_filter );
-
-        // the new centroid location for current classification
-		std::vector<meansT> new_means_cl(n_clusters,mean);
+        assignment.assign( means_clusters, nb_threads );
 
-		std::vector<int> n_element_cluster(n_clusters);
-		for(it_xT it_x=x.begin(); it_x != x.end(); ++it_x, repl++)
-		{
-            // calculate the distance between each score and the centroid 
-            for(int i=0; i<n_clusters; i++ )
-
-            {
-				dists[i] = std::inner_product( it_x->second.begin(),it_x->second.end(),
-				                               means_clusters[i].begin(),0.0,
-                                               std::plus<float>(), square_diff<float> );
-            }
-
-            // find the opitmal cluster index
-			id_cl = std::distance(dists.begin(), std::min_element(dists.begin(),dists.end()) );
+        // finish classification
+        no_more_switch = !assignment.changed();
+        if ( no_more_switch )
+            break;
 
-            // check the stop criteria
-            if ( no_more_switch && cluster_indicator[repl] != id_cl )
-                no_more_switch = false;
+        // re-calculate the centroid locations
+        assignment.update_means( means_clusters );
+	}   // end for (int iter=0; iter<MAX_ITER; iter++)
 
-            // assign the cluster index to the score
-            cluster_indicator[repl] = id_cl;
+    // Remove the empty clusters: number the others in order
+    std::vector<int> new_id( n_clusters, -1 );
+    for( int repl=0; repl<x.size(); repl++ )
+        new_id[ cluster_indicator[repl] ] = 0;
 
-            // update the centroid
-			std::transform( it_x->second.begin(),it_x->second.end(), new_means_cl[id_cl].begin(), 
-					        new_means_cl[id_cl].begin(), plus<float>() );
+    int nb_non_empty = 0;
+    for( int i=0; i<n_clusters; i++ )
+        if( new_id[i] == 0 ) new_id[i] = nb_non_empty++;
 
-            // record the number of scores in current cluster
-			n_element_cluster[id_cl]++;
-		}   // end for(it_xT it_x=x.begin(); ...
+    for( int repl=0; repl<x.size(); repl++ )
+        cluster_indicator[repl] = new_id[ cluster_indicator[repl] ];
+    n_clusters = nb_non_empty;
 
-        // finish classification
-        if ( no_more_switch )
-            break;
+    return no_more_switch;
+}
 
-        // re-calculate the centroid locations
-		for( int i=0; i<n_clusters; i++ ) 
-        {
-			if(n_element_cluster[i]>0) 
-            {
-				for(meansT::iterator it = new_means_cl[i].begin(); it != new_means_cl[i].end(); ++it )
-					*it /= n_element_cluster[i];
 
-                // assign the updated centroid location
-                new_means_cl[i].swap(means_clusters[i]);
-			}
-		}
-	}   // end for (int iter=0; iter<MAX_ITER; iter++)
+template< class XResponse>
+bool Kmeans<XResponse>::
+operator ()( const clusterT& x, std::vector<clusterT>& kmeans_clusters, int nb_clusters )
+{
+    std::vector<int> cluster_indicator;
+    int n_clusters = nb_clusters;
+    bool converged = classify( Score_pairs<XResponse>( x ), cluster_indicator, n_clusters );
 
     // initialize the output clusters
-    repl = 0;
-    for(it_xT it_x=x.begin(); it_x != x.end(); ++it_x, repl++)
-        kmeans_clusters[ cluster_indicator[repl] ].push_back(*it_x);
-    
-    // Remove the empty clusters 
-    while(true)
-    {
-      typename std::vector<clusterT>::iterator it = 
-	std::find_if( kmeans_clusters.begin(),
-		      kmeans_clusters.end(),is_cluster_empty<clusterT>);
-        
-        if(it == kmeans_clusters.end())     break;
-        kmeans_clusters.erase(it);
-    }
+    kmeans_clusters.assign( n_clusters, clusterT() );
+    for( int repl=0; repl<int( x.size() ); repl++ )
+        kmeans_clusters[ cluster_indicator[repl] ].push_back( x[repl] );
 
-    if ( no_more_switch )
-    {
-#if defined ( _DEBUG )
-        //cout << " # of iterations for k-mean partition is "<< iter+1 << endl;
-#endif
-        return true;
-    }
-    else
-        return false;
+    return converged;
 }
 
 
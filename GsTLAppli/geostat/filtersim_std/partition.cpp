@@ -67,21 +67,16 @@ void calculateScoreBinThreshold( vector<float>& score_value, vector<float>& thre
  * function to find the bin threshold for all filter scores
  */
 void CrossPartition::
-calculateBinThreshold( const ScoresType& score, vector< vector<float> >& threshold )
+calculateBinThreshold( const Pattern_range_scores& score, vector< vector<float> >& threshold )
 {
-    int i, j;
-    
-    int nscore = score.size();
-    int nfilter = score[0].second.size();
+    int nfilter = score.dimension();
+    vector<float> oneFilterScore;
     
     // loop over all filters
-    for (i=0; i<nfilter; i++)
+    for (int i=0; i<nfilter; i++)
     {
-        vector<float> oneFilterScore;
-        
         // save current filter scores into a vector
-        for (j=0; j<nscore; j++)
-            oneFilterScore.push_back( score[j].second.operator[](i) );
+        score.get_column( i, oneFilterScore );
         
         // find the threshold of current score vector
         vector<float> cutoff;
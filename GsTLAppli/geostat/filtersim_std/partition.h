@@ -35,10 +35,12 @@
 #include <GsTLAppli/geostat/common.h>
 #include <algorithm>
 #include <vector>
+#include <map>
 #include <cmath>
 
 #include "filters.h"
 #include "pattern.h"
+#include "pattern_store.h"
 
 GEOSTAT_DECL 
 void calculateScoreBinThreshold( vector<float>& score_value, vector<float>& threshold, int nbins );
@@ -50,15 +52,17 @@ void calculateScoreBinThreshold( vector<float>& score_value, vector<float>& thre
 class GEOSTAT_DECL CrossPartition
 {
 public:
-    CrossPartition( int bins=2 ):bins_(bins) {}
+    // the partition runs on one thread, nb_threads is ignored
+    CrossPartition( int bins=2, int nb_threads=0 ):bins_(bins) {}
     ~CrossPartition(){}
 
-    // the return vector grouped_score will be used to create new prototypes
+    // the group of each replicate, returned in "group", will be used to 
+    // create new prototypes. Returns the number of groups
     template< class Prototype > 
-        void execute( Prototype& proto, vector< ScoresType >& grouped_score );
+        int execute( Prototype& proto, vector<int>& group );
 
 private:
-    void calculateBinThreshold ( const ScoresType& score, vector< vector<float> >& threshold );
+    void calculateBinThreshold ( const Pattern_range_scores& score, vector< vector<float> >& threshold );
 
 private:
     int bins_;
@@ -72,12 +76,14 @@ private:
 class GEOSTAT_DECL DefaultSplitter
 {
 public:
-    DefaultSplitter( int bins=2 ):bins_(bins) {}
+    // the split runs on one thread, nb_threads is ignored
+    DefaultSplitter( int bins=2, int nb_threads=0 ):bins_(bins) {}
     ~DefaultSplitter(){}
 
-    // the return vector grouped_score will be used to create new prototypes
+    // the group of each replicate, returned in "group", will be used to 
+    // create new prototypes. Returns the number of groups
     template< class Prototype > 
-        void execute( Prototype& proto, vector< ScoresType >& grouped_score );
+        int execute( Prototype& proto, vector<int>& group );
 
 private:
     template< class Prototype > int findFilterToSplit( Prototype& proto );
@@ -90,35 +96,38 @@ private:
 ///---------------------------------------
 /*
  * function to divide the current prototype into several sub_prototype
- * the return value is a vector of score which will be used to create
- * child-prorotypes
+ * the return value is the number of groups, and "group" the group of each
+ * replicate, which will be used to create child-prorotypes
  */
 template< class Prototype > 
-void CrossPartition::
-execute( Prototype& proto, vector< ScoresType >& grouped_score )
+int CrossPartition::
+execute( Prototype& proto, vector<int>& group )
 {   
     // get the score from the parent prototype
-    ScoresType parent_score = proto.get_score();
+    Pattern_range_scores parent_score = proto.get_score();
     int nscore = proto.get_replicates();
-    int nfilter = parent_score[0].second.size();
+    int nfilter = parent_score.dimension();
 
     // divide into equal bins per filter score
     vector< vector<float> > threshold;
     calculateBinThreshold( parent_score, threshold );    
 
-    vector< vector<int> > grouped_index;  // save score group indicator
+    // save score group indicator, and the group index of each indicator
+    map< vector<int>, int > grouped_index;
+    vector<int> tmp_ind( nfilter );
+    group.resize( nscore );
 
     for (int i=0; i<nscore; i++)
     {
-        vector<int> tmp_ind( nfilter );
-        vector<float>& score_value = parent_score[i].second;
+        std::fill( tmp_ind.begin(), tmp_ind.end(), 0 );
 
         // find the bin number for current score
         for (int j=0; j<nfilter; j++)
         {
+            const float score_value = parent_score( i, j );
             for (int k=0; k<bins_; k++)
             {
-                if( score_value[j]<=threshold[j][k])
+                if( score_value<=threshold[j][k])
                 {
                     tmp_ind[j] = k; // bin number
                     break;
@@ -126,23 +135,13 @@ execute( Prototype& proto, vector< ScoresType >& grouped_score )
             }
         }
 
-        vector< vector<int> >::iterator resultIter;
-        resultIter=find(grouped_index.begin(), grouped_index.end(), tmp_ind);
-        
-        // assign current score a group indicator
-        if(resultIter != grouped_index.end())
-        {   // this group indicator exists
-            int index = resultIter - grouped_index.begin();
-            grouped_score[index].push_back( parent_score[i] );
-        }
-        else
-        {   // this group indicator need to created
-            grouped_index.push_back(tmp_ind);
-            ScoresType one_score;
-            one_score.push_back( parent_score[i] );
-            grouped_score.push_back(one_score);
-        }
+        // assign current score a group indicator: the group is created if
+        // this group indicator does not exist yet
+        int nb_groups = grouped_index.size();
+        group[i] = grouped_index.insert( make_pair( tmp_ind, nb_groups ) ).first->second;
     }
+
+    return grouped_index.size();
 }
 
 
@@ -159,55 +158,59 @@ int DefaultSplitter::findFilterToSplit( Prototype& proto )
 
 /*
  * function to divide the current prototype into several sub_prototype
- * the return value is a vector of score which will be used to create
- * child-prorotypes
+ * the return value is the number of groups, and "group" the group of each
+ * replicate, which will be used to create child-prorotypes
  */
 template< class Prototype > 
-void DefaultSplitter::
-execute( Prototype& proto, vector< ScoresType >& grouped_score )
+int DefaultSplitter::
+execute( Prototype& proto, vector<int>& group )
 {   
     // get the score from parent prototype
-    ScoresType parent_score = proto.get_score();
+    Pattern_range_scores parent_score = proto.get_score();
     int nscore = proto.get_replicates();
-    int nfilter = parent_score[0].second.size();
 
     // find the filter to be split
     int split_filter = findFilterToSplit( proto );
 
     // save the selected filter score into a vector
     vector<float> oneFilterScore;
-    for (int i=0; i<nscore; i++)
-        oneFilterScore.push_back( parent_score[i].second.operator[](split_filter) );
+    parent_score.get_column( split_filter, oneFilterScore );
         
     // divide score vector into equal bins 
     vector<float> threshold;
     calculateScoreBinThreshold( oneFilterScore, threshold, bins_ );  
     
-    ScoresType one_score;
-    for (int j=0; j<bins_; j++)
-        grouped_score.push_back( one_score );
-
-    // divide current score into different score group
+    // divide current score into different bins
+    vector<int> bin_size( bins_, 0 );
+    group.assign( nscore, bins_-1 );
     for ( int k=0; k < nscore; k++)
     {
-        float& cur_score = parent_score[k].second.operator[](split_filter);
+        const float cur_score = parent_score( k, split_filter );
 
         for (int j=0; j<bins_; j++)
         {
             if( cur_score<=threshold[j])
             {
-                grouped_score[j].push_back( parent_score[k] );
+                group[k] = j;
                 break;
             }
         }
+        bin_size[ group[k] ]++;
     }
 
     // remove the empty groups
-    for ( int j=bins_-1; j>-1; j--)
+    vector<int> group_id( bins_, 0 );
+    int nb_groups = 0;
+    for ( int j=0; j<bins_; j++)
     {
-        if ( grouped_score[j].size() == 0 )
-            grouped_score.erase( grouped_score.begin()+j );
+        if ( bin_size[j] > 0 )
+            group_id[j] = nb_groups++;
     }
+
+    for ( int k=0; k < nscore; k++)
+        group[k] = group_id[ group[k] ];
+
+    return nb_groups;
 }
 
 
@@ -36,8 +36,11 @@
 #include <GsTLAppli/geostat/common.h>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include "filters.h"
+#include "filter_scores.h"
+#include "pattern_store.h"
 
 using namespace std;
 
@@ -50,25 +53,24 @@ typedef pair< int, vector<float> > OneScoreType;    // node_id, template pixel a
 typedef vector< OneScoreType > ScoresType;      // all score value
 
 /*
- * function to normalize a score  into range [p_start, p_end] in each dimension
+ * function to find the min and max value of each score
  */
-template<typename T>
-void find_score_extreme( vector< pair< int, vector<T> > >& score, vector<T>& max_value, vector<T>& min_value )
+inline 
+void find_score_extreme( const Pattern_store& score, vector<float>& max_value, vector<float>& min_value )
 {
-    int i, j;
     int nb_replicates = score.size();
-    int nb_score = score[0].second.size();
-    max_value.resize( nb_score, (T)(-99999) );
-    min_value.resize( nb_score, (T)(99999) );
+    int nb_score = score.nb_scores();
+    max_value.resize( nb_score, -99999.f );
+    min_value.resize( nb_score, 99999.f );
 
-    // find the min and max
-    for (i=0; i<nb_replicates; i++)
+    // find the min and max, one score column at a time
+    for (int j=0; j<nb_score; j++)
     {
-        vector<T>& one_score = score[i].second;
-        for (j=0; j<nb_score; j++)
+        const float* one_score = score.column(j);
+        for (int i=0; i<nb_replicates; i++)
         {
-            if ( max_value[j] < one_score[j] )   max_value[j] =one_score[j];
-            if ( min_value[j] > one_score[j] )   min_value[j] =one_score[j];
+            if ( max_value[j] < one_score[i] )   max_value[j] =one_score[i];
+            if ( min_value[j] > one_score[i] )   min_value[j] =one_score[i];
         }
     }
 }
@@ -76,37 +78,25 @@ void find_score_extreme( vector< pair< int, vector<T> > >& score, vector<T>& max
 /*
  * function to normalize a score  into range [p_start, p_end] in each dimension
  */
-template<typename T>
-void normalize_score( vector< pair< int, vector<T> > >& score, vector<T>& max_value, 
-                     vector<T>& min_value, T p_start=(T)(0), T p_end=(T)(1) )
+inline 
+void normalize_score( Pattern_store& score, vector<float>& max_value, 
+                      vector<float>& min_value, float p_start=0.f, float p_end=1.f )
 {
-    int i, j;
     int nb_replicates = score.size();
-    int nb_score = score[0].second.size();
-
-    vector<T> denominator( nb_score );
-    vector<T> multiplier( nb_score );
+    int nb_score = score.nb_scores();
 
     // find the min and max
     find_score_extreme(score, max_value, min_value);
 
-    // calculate the multiplier
-    for (j=0; j<nb_score; j++)
-    {
-        denominator[j] = max_value[j]-min_value[j];
-
-        if ( denominator[j] == (T)(0) )
-            multiplier[j] = (T)(0);
-        else
-            multiplier[j] = (p_end-p_start)/denominator[j];
-    }
-
     // normalize the score values in each score dimension
-    for (i=0; i<nb_replicates; i++)
+    for (int j=0; j<nb_score; j++)
     {
-        vector<T>& one_score = score[i].second;
-        for (j=0; j<nb_score; j++)
-            one_score[j] = p_start + ( one_score[j] - min_value[j] )*multiplier[j];
+        float denominator = max_value[j]-min_value[j];
+        float multiplier = ( denominator == 0.f ) ? 0.f : (p_end-p_start)/denominator;
+
+        float* one_score = score.column(j);
+        for (int i=0; i<nb_replicates; i++)
+            one_score[i] = p_start + ( one_score[i] - min_value[j] )*multiplier;
     }
 }
 
@@ -121,54 +111,18 @@ void normalize_score( vector< pair< int, vector<T> > >& score, vector<T>& max_va
  */
 inline GEOSTAT_DECL
 void create_filter_cate_scores( RGrid* training_image_, 
-                          ScoresType& score, Filter* my_filters_, 
+                          Pattern_store& score, Filter* my_filters_, 
                           int ncoarse, int is_viewscore_, int nb_facies, 
                           string training_property_name_,
                           vector<GsTLGridProperty*>& scoreProps_, int nreal,
-                          vector<float>& max_value, vector<float>& min_value )
+                          vector<float>& max_value, vector<float>& min_value,
+                          int nb_threads )
 {
-	int loc=0;          // node location with score values
     int nb_filter = my_filters_->get_total_filter_number();
-	
-    // get filter template, neighborhood & weight
-    Grid_template* geom = my_filters_->get_window_geometry(ncoarse);
-    SmartPtr<Neighborhood> neighborhood = training_image_->window_neighborhood( *geom );
-    neighborhood->select_property( training_property_name_ );
-
-    vector< vector< float > > weight ;
-    for (int cur_filter=0; cur_filter<nb_filter; cur_filter++) 
-        weight.push_back( my_filters_->get_weights(cur_filter) );
 
-    for( Geostat_grid::iterator node_iter = training_image_->begin(); 
-                node_iter != training_image_->end();  node_iter++, loc++ ) 
-    {
-        // find the neighbors of the current node
-        neighborhood->find_neighbors( *node_iter );
-
-        // if the current node does not have full neighbors, skip it
-        if( neighborhood->size() != neighborhood->max_size() ) continue;
-
-        vector<float> temp_score(nb_filter*nb_facies, 0.);
-
-        for(int cur_filter=0; cur_filter<nb_filter; cur_filter++) 
-        {
-            vector<float>::const_iterator weight_iter = weight[cur_filter].begin();
-            vector<float> sum(nb_facies, 0.);
-
-            // calculate filter score
-            for( Neighborhood::iterator neighbor_iter = neighborhood->begin();
-                neighbor_iter != neighborhood->end() ; neighbor_iter++, weight_iter++)	
-            {
-                sum[ neighbor_iter->property_value() ] += *weight_iter;
-            }
-
-            // score is ordered first in filter id, then in facies id
-            for(int cur_facies=0; cur_facies<nb_facies; cur_facies++)
-                temp_score[cur_facies*nb_filter+cur_filter] = sum[cur_facies];
-        }
-
-        score.push_back( make_pair(loc, temp_score) );
-    }
+    // score is ordered first in filter id, then in facies id
+    compute_filter_scores( training_image_, training_property_name_, 
+                           my_filters_, ncoarse, nb_facies, score, nb_threads );
 
     // only output score view in the fineset grid for realization 1 if required
     if( is_viewscore_==1 && nreal==1 && ncoarse==1 ) 
@@ -178,22 +132,15 @@ void create_filter_cate_scores( RGrid* training_image_,
             GsTLGridProperty * prop = training_image_->select_property ( scoreProps_[ j ]->name() );
 
             for (int i=0; i<score.size(); i++)
-                prop->set_value( score[i].second[j], score[i].first );
+                prop->set_value( score.score(i, j), score.node_id(i) );
         }
     }
 
     //remove the redundent score values for the last facies
-    int remove_loc = (nb_facies-1)*nb_filter;
-    for (int i=0; i<score.size(); i++)
-    {
-        vector< float >& one_score = score[i].second;
-        one_score.erase( one_score.begin()+remove_loc, one_score.end() );
-    }
+    score.keep_scores( (nb_facies-1)*nb_filter );
     
     // normalize score to be [0, 1]
     normalize_score( score, max_value, min_value );
-
-    delete geom;
 }
 
 
@@ -203,49 +150,17 @@ void create_filter_cate_scores( RGrid* training_image_,
  */
 inline  GEOSTAT_DECL
 void create_filter_cont_scores( RGrid* training_image_, 
-                          ScoresType& score, Filter* my_filters_, 
+                          Pattern_store& score, Filter* my_filters_, 
                           int ncoarse, int is_viewscore_,
                           string training_property_name_,
                           vector<GsTLGridProperty*>& scoreProps_, int nreal,
-                          vector<float>& max_value, vector<float>& min_value )
+                          vector<float>& max_value, vector<float>& min_value,
+                          int nb_threads )
 {
-	int loc=0;          // node location with score values
     int nb_filter = my_filters_->get_total_filter_number();
-	
-    // get filter template, neighborhood & weight
-    Grid_template* geom = my_filters_->get_window_geometry(ncoarse);
-    SmartPtr<Neighborhood> neighborhood = training_image_->window_neighborhood( *geom );
-    neighborhood->select_property( training_property_name_ );
-
-    vector< vector< float > > weight ;
-    for (int cur_filter=0; cur_filter<nb_filter; cur_filter++) 
-        weight.push_back( my_filters_->get_weights(cur_filter) );
-
-    for( Geostat_grid::iterator node_iter = training_image_->begin(); 
-                node_iter != training_image_->end();  node_iter++, loc++ ) 
-    {
-        // find the neighbors of the current node
-        neighborhood->find_neighbors( *node_iter );
-
-        // if the current node does not have full neighbors, skip it
-        if( neighborhood->size() != neighborhood->max_size() ) continue;
 
-        vector<float> temp_score(nb_filter, 0.);
-
-        for(int cur_filter=0; cur_filter<nb_filter; cur_filter++) 
-        {
-            vector<float>::const_iterator weight_iter = weight[cur_filter].begin();
-
-            // calculate filter score
-            for( Neighborhood::iterator neighbor_iter = neighborhood->begin();
-                 neighbor_iter != neighborhood->end() ; neighbor_iter++, weight_iter++)	
-            {
-                temp_score[cur_filter] += (*weight_iter)*neighbor_iter->property_value();
-            }
-        }
-
-        score.push_back( make_pair(loc, temp_score) );
-    }
+    compute_filter_scores( training_image_, training_property_name_, 
+                           my_filters_, ncoarse, 0, score, nb_threads );
 
     // only output score view in the fineset grid for realization 1 if required
     if( is_viewscore_==1 && nreal==1 && ncoarse==1 ) 
@@ -255,41 +170,41 @@ void create_filter_cont_scores( RGrid* training_image_,
             GsTLGridProperty * prop = training_image_->select_property ( scoreProps_[ cur_filter ]->name() );
 
             for (int i=0; i<score.size(); i++)
-                prop->set_value( score[i].second[cur_filter], score[i].first );
+                prop->set_value( score.score(i, cur_filter), score.node_id(i) );
         }
     }
     
     // normalize score to be [0, 1]
     normalize_score( score, max_value, min_value );
-
-    delete geom;
 }
 
 
 
 /*
- * create filter scores depending on the variable type
+ * create filter scores depending on the variable type. The scores are 
+ * computed on nb_threads threads (see compute_filter_scores)
  */
 inline  GEOSTAT_DECL
 void create_filter_scores( RGrid* training_image_, 
-                          ScoresType& score, Filter* my_filters_, 
+                          Pattern_store& score, Filter* my_filters_, 
                           int ncoarse, int is_viewscore_,
                           int treat_cate_as_cont, int nb_facies, 
                           string training_property_name_,
                           vector<GsTLGridProperty*>& scoreProps_, int nreal,
-                          vector<float>& max_value, vector<float>& min_value )
+                          vector<float>& max_value, vector<float>& min_value,
+                          int nb_threads )
 {
     // for continuous variable
     if ( treat_cate_as_cont == 1 )
         create_filter_cont_scores( training_image_, score,
                 my_filters_, ncoarse, is_viewscore_, 
                 training_property_name_, scoreProps_, nreal,
-                max_value, min_value);
+                max_value, min_value, nb_threads );
     else    // for categorical variable
         create_filter_cate_scores( training_image_, score, 
                 my_filters_, ncoarse, is_viewscore_, nb_facies, 
                 training_property_name_, scoreProps_, nreal,
-                max_value, min_value);
+                max_value, min_value, nb_threads );
 }
 
 
@@ -0,0 +1,99 @@
+/**********************************************************************
+** Author: Jianbing Wu, Alexandre Boucher
+** Contributor: Tuanfeng Zhang
+**
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Stanford Geostatistical 
+** Earth Modeling Software (SGEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include "pattern_store.h"
+
+#include <algorithm>
+
+
+void Pattern_store::resize( std::size_t nb_patterns, std::size_t nb_scores )
+{
+    nb_patterns_ = nb_patterns;
+    nb_scores_ = nb_scores;
+    node_ids_.assign( nb_patterns, 0 );
+    scores_.assign( nb_patterns*nb_scores, 0.f );
+    index_.clear();
+}
+
+
+void Pattern_store::keep_scores( std::size_t nb_scores )
+{
+    if( nb_scores >= nb_scores_ ) return;
+
+    // the matrix is column-major: the columns to remove are at the end
+    nb_scores_ = nb_scores;
+    std::vector<float>( scores_.begin(), scores_.begin() + nb_patterns_*nb_scores ).swap( scores_ );
+}
+
+
+void Pattern_store::release_scores()
+{
+    std::vector<float>().swap( scores_ );
+}
+
+
+void Pattern_store::reset_index()
+{
+    // room for a few levels of splits
+    index_.clear();
+    index_.reserve( 3*nb_patterns_ );
+    for( int i = 0; i < size(); i++ )
+        index_.push_back( i );
+}
+
+
+void Pattern_store::split( int first, int last, const std::vector<int>& group, 
+                           int nb_groups, std::vector<int>& bounds )
+{
+    // count the patterns of each group
+    bounds.assign( nb_groups+1, 0 );
+    for( int i = first; i < last; i++ )
+        bounds[ group[i-first] + 1 ]++;
+
+    const int start = index_.size();
+    bounds[0] = start;
+    for( int g = 0; g < nb_groups; g++ )
+        bounds[g+1] += bounds[g];
+
+    // copy the indices, group after group
+    index_.resize( start + last - first );
+    std::vector<int> next( bounds.begin(), bounds.end()-1 );
+    for( int i = first; i < last; i++ )
+        index_[ next[ group[i-first] ]++ ] = index_[i];
+}
+
+
+void Pattern_range_scores::get_column( int j, std::vector<float>& values ) const
+{
+    const float* column = patterns_->column( j );
+    values.resize( size_ );
+    for( int i = 0; i < size_; i++ )
+        values[i] = column[ patterns_->pattern( first_ + i ) ];
+}
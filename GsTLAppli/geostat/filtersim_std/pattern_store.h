@@ -0,0 +1,146 @@
+/**********************************************************************
+** Author: Jianbing Wu, Alexandre Boucher
+** Contributor: Tuanfeng Zhang
+**
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Stanford Geostatistical 
+** Earth Modeling Software (SGEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+
+#ifndef __filtersim_pattern_store_H__
+#define __filtersim_pattern_store_H__
+
+#include <GsTLAppli/geostat/common.h>
+#include <GsTL/utils/smartptr.h>
+
+#include <vector>
+#include <cstddef>
+
+
+/*
+ * class Pattern_store
+ * the filter scores of all the patterns of a training image, stored in a 
+ * single column-major matrix: the scores of one filter are contiguous.
+ *
+ * The prototypes do not copy their patterns: a prototype is a range of 
+ * the pattern index list of the store. The pattern ids fit in an int, but
+ * the offsets in the score matrix (patterns x filters, or x facies for 
+ * categorical scores) do not: they are computed as std::size_t.
+ * Splitting a prototype appends the 
+ * indices of its patterns to the list, grouped by child prototype, hence 
+ * the ranges of the parent prototypes remain valid.
+ * The store is reference counted, so that the copies of a prototype list
+ * share it.
+ */
+class GEOSTAT_DECL Pattern_store : public SmartPtr_interface<Pattern_store>
+{
+public:
+    Pattern_store() : nb_patterns_( 0 ), nb_scores_( 0 ) {}
+
+    // nb_patterns patterns of nb_scores scores, all set to 0
+    void resize( std::size_t nb_patterns, std::size_t nb_scores );
+
+    // only keeps the first nb_scores scores of each pattern
+    void keep_scores( std::size_t nb_scores );
+
+    // frees the scores once the prototypes are built: the node ids and
+    // the pattern index list are kept
+    void release_scores();
+
+    int size() const { return int( nb_patterns_ ); }
+    bool empty() const { return nb_patterns_ == 0; }
+    int nb_scores() const { return int( nb_scores_ ); }
+
+    // node id, in the training image, of the center of a pattern
+    int& node_id( int pattern ) { return node_ids_[pattern]; }
+    int node_id( int pattern ) const { return node_ids_[pattern]; }
+
+    // score j of a pattern
+    float& score( int pattern, int j ) { return scores_[ offset( j ) + pattern ]; }
+    float score( int pattern, int j ) const { return scores_[ offset( j ) + pattern ]; }
+
+    // the scores of filter j of all the patterns
+    float* column( int j ) { return &scores_[ offset( j ) ]; }
+    const float* column( int j ) const { return &scores_[ offset( j ) ]; }
+
+    // pattern at position i of the index list
+    int pattern( int i ) const { return index_[i]; }
+
+    // resets the index list to all the patterns: range [0, size())
+    void reset_index();
+
+    /*
+     * appends the patterns of range [first, last) of the index list to the
+     * list, grouped by group[i-first] (in [0, nb_groups)). The order of the
+     * patterns within a group is kept. The new range of group g is 
+     * [bounds[g], bounds[g+1]).
+     */
+    void split( int first, int last, const std::vector<int>& group, int nb_groups, 
+                std::vector<int>& bounds );
+
+private:
+    // offset of column j in the score matrix
+    std::size_t offset( int j ) const { return std::size_t( j )*nb_patterns_; }
+
+private:
+    std::size_t nb_patterns_;
+    std::size_t nb_scores_;
+    std::vector<int> node_ids_;
+    std::vector<float> scores_;
+    std::vector<int> index_;
+};
+
+
+
+/*
+ * class Pattern_range_scores
+ * the scores of the patterns of a range of the index list of a store, 
+ * accessed as a matrix: (i,j) is score j of the i-th pattern of the range
+ */
+class GEOSTAT_DECL Pattern_range_scores
+{
+public:
+    Pattern_range_scores( const Pattern_store* patterns, int first, int size )
+        : patterns_( patterns ), first_( first ), size_( size ) {}
+
+    int size() const { return size_; }
+    int dimension() const { return patterns_->nb_scores(); }
+
+    float operator()( int i, int j ) const 
+    { 
+        return patterns_->score( patterns_->pattern( first_ + i ), j ); 
+    }
+
+    // copies the scores of filter j of the range
+    void get_column( int j, std::vector<float>& values ) const;
+
+private:
+    const Pattern_store* patterns_;
+    int first_;
+    int size_;
+};
+
+
+#endif  // __filtersim_pattern_store_H__
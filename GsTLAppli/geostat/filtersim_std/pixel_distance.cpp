@@ -0,0 +1,203 @@
+/**********************************************************************
+** Author: Jianbing Wu, Alexandre Boucher
+** Contributor: Tuanfeng Zhang
+**
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Stanford Geostatistical 
+** Earth Modeling Software (SGEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include "pixel_distance.h"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define PIXEL_DISTANCE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#  include <emmintrin.h>
+#  define PIXEL_DISTANCE_SSE2
+#endif
+
+
+namespace {
+
+  // the nodes are summed by chunks of "chunk_size", the early-terminated
+  // distances are checked after each chunk. The full distances are summed 
+  // the same way, so that both give the same result.
+  const int chunk_size = 64;
+
+  enum Norm { L1, L2 };
+
+  template< Norm norm >
+  inline float scalar_term( float a, float b, float w, float no_data_value ) 
+  {
+      if( a == no_data_value || b == no_data_value ) return 0.f;
+      const float d = ( a - b ) * w;
+      return norm == L1 ? std::fabs( d ) : d*d;
+  }
+
+
+#if defined(PIXEL_DISTANCE_AVX2)
+
+  template< Norm norm >
+  float sum_terms( const float* p1, const float* p2, const float* w, int n, 
+                   float no_data_value ) 
+  {
+      const __m256 nd = _mm256_set1_ps( no_data_value );
+      const __m256 sign = _mm256_set1_ps( -0.f );
+      __m256 acc = _mm256_setzero_ps();
+
+      int i = 0;
+      for( ; i + 8 <= n; i += 8 ) {
+          const __m256 a = _mm256_loadu_ps( p1 + i );
+          const __m256 b = _mm256_loadu_ps( p2 + i );
+          const __m256 mask = _mm256_and_ps( _mm256_cmp_ps( a, nd, _CMP_NEQ_UQ ),
+                                             _mm256_cmp_ps( b, nd, _CMP_NEQ_UQ ) );
+          __m256 d = _mm256_mul_ps( _mm256_sub_ps( a, b ), _mm256_loadu_ps( w + i ) );
+          d = norm == L1 ? _mm256_andnot_ps( sign, d ) : _mm256_mul_ps( d, d );
+          acc = _mm256_add_ps( acc, _mm256_and_ps( d, mask ) );
+      }
+
+      __m128 sum4 = _mm_add_ps( _mm256_castps256_ps128( acc ), 
+                                _mm256_extractf128_ps( acc, 1 ) );
+      sum4 = _mm_add_ps( sum4, _mm_movehl_ps( sum4, sum4 ) );
+      sum4 = _mm_add_ss( sum4, _mm_shuffle_ps( sum4, sum4, 1 ) );
+      float sum = _mm_cvtss_f32( sum4 );
+
+      for( ; i < n; i++ ) 
+          sum += scalar_term<norm>( p1[i], p2[i], w[i], no_data_value );
+      return sum;
+  }
+
+#elif defined(PIXEL_DISTANCE_SSE2)
+
+  template< Norm norm >
+  float sum_terms( const float* p1, const float* p2, const float* w, int n, 
+                   float no_data_value ) 
+  {
+      const __m128 nd = _mm_set1_ps( no_data_value );
+      const __m128 sign = _mm_set1_ps( -0.f );
+      __m128 acc = _mm_setzero_ps();
+
+      int i = 0;
+      for( ; i + 4 <= n; i += 4 ) {
+          const __m128 a = _mm_loadu_ps( p1 + i );
+          const __m128 b = _mm_loadu_ps( p2 + i );
+          const __m128 mask = _mm_and_ps( _mm_cmpneq_ps( a, nd ), _mm_cmpneq_ps( b, nd ) );
+          __m128 d = _mm_mul_ps( _mm_sub_ps( a, b ), _mm_loadu_ps( w + i ) );
+          d = norm == L1 ? _mm_andnot_ps( sign, d ) : _mm_mul_ps( d, d );
+          acc = _mm_add_ps( acc, _mm_and_ps( d, mask ) );
+      }
+
+      acc = _mm_add_ps( acc, _mm_movehl_ps( acc, acc ) );
+      acc = _mm_add_ss( acc, _mm_shuffle_ps( acc, acc, 1 ) );
+      float sum = _mm_cvtss_f32( acc );
+
+      for( ; i < n; i++ ) 
+          sum += scalar_term<norm>( p1[i], p2[i], w[i], no_data_value );
+      return sum;
+  }
+
+#else
+
+  template< Norm norm >
+  float sum_terms( const float* p1, const float* p2, const float* w, int n, 
+                   float no_data_value ) 
+  {
+      float sum = 0.f;
+      for( int i = 0; i < n; i++ ) 
+          sum += scalar_term<norm>( p1[i], p2[i], w[i], no_data_value );
+      return sum;
+  }
+
+#endif
+
+
+  template< Norm norm >
+  bool sum_terms( const float* p1, const float* p2, const float* w, int n, 
+                  float no_data_value, float& limit ) 
+  {
+      float sum = 0.f;
+      for( int first = 0; first < n; first += chunk_size ) {
+          const int size = n - first < chunk_size ? n - first : chunk_size;
+          sum += sum_terms<norm>( p1 + first, p2 + first, w + first, size, 
+                                  no_data_value );
+          if( sum > limit ) return false;
+      }
+      limit = sum;
+      return true;
+  }
+
+}
+
+
+
+float weighted_manhattan_distance( const float* p1, const float* p2, 
+                                   const float* weight, int n, 
+                                   float no_data_value )
+{
+    float sum = std::numeric_limits<float>::infinity();
+    sum_terms<L1>( p1, p2, weight, n, no_data_value, sum );
+    return sum;
+}
+
+
+float weighted_squared_distance( const float* p1, const float* p2, 
+                                 const float* weight, int n, 
+                                 float no_data_value )
+{
+    float sum = std::numeric_limits<float>::infinity();
+    sum_terms<L2>( p1, p2, weight, n, no_data_value, sum );
+    return sum;
+}
+
+
+bool weighted_manhattan_distance( const float* p1, const float* p2, 
+                                  const float* weight, int n, 
+                                  float no_data_value, float& limit )
+{
+    return sum_terms<L1>( p1, p2, weight, n, no_data_value, limit );
+}
+
+
+bool weighted_squared_distance( const float* p1, const float* p2, 
+                                const float* weight, int n, 
+                                float no_data_value, float& limit )
+{
+    return sum_terms<L2>( p1, p2, weight, n, no_data_value, limit );
+}
+
+
+const char* pixel_distance_instruction_set()
+{
+#if defined(PIXEL_DISTANCE_AVX2)
+    return "AVX2";
+#elif defined(PIXEL_DISTANCE_SSE2)
+    return "SSE2";
+#else
+    return "none";
+#endif
+}
@@ -0,0 +1,76 @@
+/**********************************************************************
+** Author: Jianbing Wu, Alexandre Boucher
+** Contributor: Tuanfeng Zhang
+**
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Stanford Geostatistical 
+** Earth Modeling Software (SGEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+
+
+#ifndef __filtersim_pixel_distance_H__
+#define __filtersim_pixel_distance_H__
+
+#include <GsTLAppli/geostat/common.h>
+
+/*
+ * Distances between two patterns stored as contiguous arrays of floats,
+ * with a weight for each template node. The nodes where either pattern is
+ * equal to no_data_value are ignored. 
+ * They are the kernels of the weighted Manhattan_Distance and 
+ * Euclidean_Distance (distance.h) when the patterns are vectors of floats,
+ * and use the AVX2 or SSE2 instructions if the compiler targets them.
+ */
+
+// sum of |(p1-p2)*weight|
+GEOSTAT_DECL 
+float weighted_manhattan_distance( const float* p1, const float* p2, 
+                                   const float* weight, int n, 
+                                   float no_data_value );
+
+// sum of ((p1-p2)*weight)^2
+GEOSTAT_DECL 
+float weighted_squared_distance( const float* p1, const float* p2, 
+                                 const float* weight, int n, 
+                                 float no_data_value );
+
+/*
+ * same as above, but the calculation is terminated (and false returned) as
+ * soon as the sum exceeds "limit". Otherwise the sum is written in "limit".
+ */
+GEOSTAT_DECL 
+bool weighted_manhattan_distance( const float* p1, const float* p2, 
+                                  const float* weight, int n, 
+                                  float no_data_value, float& limit );
+GEOSTAT_DECL 
+bool weighted_squared_distance( const float* p1, const float* p2, 
+                                const float* weight, int n, 
+                                float no_data_value, float& limit );
+
+// name of the instruction set used by the kernels: "AVX2", "SSE2" or "none"
+GEOSTAT_DECL const char* pixel_distance_instruction_set();
+
+
+#endif  // __filtersim_pixel_distance_H__
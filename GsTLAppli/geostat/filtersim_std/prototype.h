@@ -44,6 +44,7 @@
 
 #include "distance.h"
 #include "pattern.h"
+#include "pattern_store.h"
 
 /*
  * template class Prototype_Base
@@ -53,9 +54,11 @@ template< class Distance_ >
 class GEOSTAT_DECL Prototype_Base
 {
 public:
+    // the patterns of the prototype are range [first, last) of the index
+    // list of "patterns"
     Prototype_Base( RGrid* TI_grid, Window_neighborhood* neighbors, 
-                    Window_neighborhood* patch_neighbors, ScoresType pattern_score, 
-                    vector<float>& score_weight, int nfacies=1 );
+                    Window_neighborhood* patch_neighbors, Pattern_store* patterns, 
+                    int first, int last, vector<float>& score_weight, int nfacies=1 );
     
     ~Prototype_Base(){}
 
@@ -64,7 +67,12 @@ public:
     RGrid* get_grid() { return TI_grid_; }
     Window_neighborhood* get_neighbor() { return neighbors_; }
     Window_neighborhood* get_patch_neighbor() { return patch_neighbors_; }
-    ScoresType& get_score() { return pattern_score_; }
+    Pattern_store* get_patterns() { return patterns_; }
+    int get_first_pattern() { return first_; }
+    Pattern_range_scores get_score() { return Pattern_range_scores( patterns_, first_, replicate_ ); }
+
+    // node id of the center of a replicate
+    int get_node_id( int replicate ) { return patterns_->node_id( patterns_->pattern( first_+replicate ) ); }
 
     int get_nb_facies() { return nfacies_; }
     int get_replicates() { return replicate_; }
@@ -81,6 +89,9 @@ public:
 
     void remove_score();
 
+protected:
+    void accumulate_scores( vector<float>& sum, vector<float>& sum_squares );
+
 protected:
     int nfacies_;               // # of facies
     int nscore_;                // # of total filter score
@@ -94,7 +105,9 @@ protected:
 
     vector<float> m_value_;     // ml for each i^{th} filter, also the filter score of each prototype
     vector<float> variance_;    // sigma^2 for each i^{th} filter
-    ScoresType pattern_score_;
+
+    Pattern_store* patterns_;   // the scores of the replicates
+    int first_;                 // first replicate in the index list of patterns_
 
     vector<float> score_weight_;    // weight assigned to each filter score
 
@@ -120,10 +133,10 @@ public:
 
 public:
     Prototype_Continuous( RGrid* TI_grid, Window_neighborhood* neighbors, 
-                          Window_neighborhood* patch_neighbors, ScoresType pattern_score, 
-                          vector<float>& score_weight, int nfacies=1 )
+                          Window_neighborhood* patch_neighbors, Pattern_store* patterns, 
+                          int first, int last, vector<float>& score_weight, int nfacies=1 )
              : Prototype_Base< Distance >( TI_grid, neighbors, patch_neighbors, 
-                                           pattern_score, score_weight, nfacies ){}
+                                           patterns, first, last, score_weight, nfacies ){}
     ~Prototype_Continuous(){}
 
     void calculate_pattern_prototype();
@@ -152,15 +165,15 @@ class GEOSTAT_DECL Prototype_Categorical: public Prototype_Base< Distance >
 {
 public:
     typedef vector< vector<float> > pixel_type;
-    typedef vector< vector<float> > proportion_type;
+    typedef vector<float> proportion_type;    // nfacies proportions per replicate
     typedef vector<float> mean_prop_type;
 
 public:
     Prototype_Categorical( RGrid* TI_grid, Window_neighborhood* neighbors, 
-                           Window_neighborhood* patch_neighbors, ScoresType pattern_score, 
-                           vector<float>& score_weight, int nfacies=2 )
+                           Window_neighborhood* patch_neighbors, Pattern_store* patterns, 
+                           int first, int last, vector<float>& score_weight, int nfacies=2 )
              : Prototype_Base< Distance >( TI_grid, neighbors, patch_neighbors, 
-                                           pattern_score, score_weight, nfacies ) {}
+                                           patterns, first, last, score_weight, nfacies ) {}
 
     ~Prototype_Categorical(){}
 
@@ -188,18 +201,19 @@ private:
 template< class Distance >
 Prototype_Base< Distance >::
 Prototype_Base( RGrid* TI_grid, Window_neighborhood* neighbors, 
-                Window_neighborhood* patch_neighbors, ScoresType pattern_score, 
-                vector<float>& score_weight, int nfacies )
+                Window_neighborhood* patch_neighbors, Pattern_store* patterns, 
+                int first, int last, vector<float>& score_weight, int nfacies )
 {
     TI_grid_ = TI_grid;
     neighbors_ = neighbors;
     patch_neighbors_ = patch_neighbors;
-    pattern_score_ = pattern_score;
+    patterns_ = patterns;
+    first_ = first;
     nfacies_ = nfacies;
     score_weight_ = score_weight;
 
-    replicate_ = pattern_score_.size();
-    nscore_ = pattern_score_[0].second.size();
+    replicate_ = last - first;
+    nscore_ = patterns_->nb_scores();
 
     nb_neighbors_ = neighbors_->max_size();
     pt_nb_neighbors_ = patch_neighbors_->max_size();
@@ -220,18 +234,10 @@ void
 Prototype_Base< Distance >::
 calculate_score_variance()
 {
-    int i,j;
+    int j;
 
     // loop over each pattern
-    for (i=0; i<replicate_; i++)
-    {
-        vector<float>& score = pattern_score_[i].second;
-        for (j=0; j<nscore_; j++)
-        {
-            m_value_[j] += score[j];
-            variance_[j] += (score[j] * score[j]);
-        }
-    }
+    accumulate_scores( m_value_, variance_ );
 
     if ( replicate_ == 1 )
     {
@@ -260,6 +266,29 @@ calculate_score_variance()
 }
 
 
+/*
+ * function to add the sum and the sum of squares of each filter score over
+ * the replicates to "sum" and "sum_squares"
+ */
+template< class Distance >
+void 
+Prototype_Base< Distance >::
+accumulate_scores( vector<float>& sum, vector<float>& sum_squares )
+{
+    // the scores of a filter are contiguous in the pattern store
+    for (int j=0; j<nscore_; j++)
+    {
+        const float* score = patterns_->column(j);
+        for (int i=0; i<replicate_; i++)
+        {
+            const float value = score[ patterns_->pattern( first_+i ) ];
+            sum[j] += value;
+            sum_squares[j] += value * value;
+        }
+    }
+}
+
+
 /*
  * function to calculate the distance between DEV score and prototype score
  */
@@ -284,9 +313,6 @@ remove_score()
     //m_value_.clear();
     variance_.clear();
     score_weight_.clear();
-
-    for (int i=0; i<pattern_score_.size(); i++)
-        pattern_score_[i].second.clear();
 }
 
 
@@ -298,22 +324,14 @@ void
 Prototype_Continuous< Distance >::
 calculate_prototype_sharpness()
 {
-    int i,j;
+    int j;
     //vector<float> m(Base_::nscore_, 0.);    // mean for each pattern location
     //vector<float> v(Base_::nscore_, 0.);     // variance for each pattern location
     vector<float>& m = Base_::m_value_;
     vector<float>& v = Base_::variance_;
 
     // loop over each pattern
-    for (i=0; i<Base_::replicate_; i++)
-    {
-        vector<float>& score = Base_::pattern_score_[i].second;
-        for (j=0; j<Base_::nscore_; j++)
-        {
-            m[j] += score[j];
-            v[j] += (score[j] * score[j]);
-        }
-    }
+    Base_::accumulate_scores( m, v );
 
     if ( Base_::replicate_ == 1 )
     {
@@ -372,7 +390,7 @@ calculate_pattern_prototype()
     
   for (int i=0; i < Base_::replicate_; i++)
     {
-      int node_id = (Base_::pattern_score_)[i].first;
+      int node_id = Base_::get_node_id( i );
       (Base_::neighbors_)->find_neighbors( (Base_::TI_grid_)->geovalue(node_id) );
         
         int j = 0;
@@ -446,15 +464,7 @@ calculate_prototype_sharpness()
     vector<float>& v = Base_::variance_;
 
     // loop over each pattern
-    for (i=0; i<Base_::replicate_; i++)
-    {
-        vector<float>& score = Base_::pattern_score_[i].second;
-        for (j=0; j<Base_::nscore_; j++)
-        {
-            m[j] += score[j];
-            v[j] += (score[j] * score[j]);
-        }
-    }
+    Base_::accumulate_scores( m, v );
 
     if ( Base_::replicate_ == 1 )
     {
@@ -486,9 +496,6 @@ clean_prototype_pattern()
     for (int i=0; i<Base_::nfacies_; i++)
         prototype_pixel_[i].clear();
 
-    for (int j=0; j<Base_::replicate_; j++)
-        each_pattern_prop_[j].clear();
-
     prototype_pixel_.clear();
     each_pattern_prop_.clear();
     pattern_mean_prop_.clear();
@@ -510,10 +517,11 @@ calculate_pattern_prototype()
         prototype_pixel_.push_back( oneFaciesPattern );
 
     pattern_mean_prop_.resize(Base_::nfacies_, 0.0);
+    each_pattern_prop_.resize(Base_::replicate_*Base_::nfacies_, 0.0);
 
     for (i=0; i < Base_::replicate_; i++)
     {
-        int node_id = Base_::pattern_score_[i].first;
+        int node_id = Base_::get_node_id( i );
         Base_::neighbors_->find_neighbors( Base_::TI_grid_->geovalue(node_id) );
 
         j = 0;
@@ -525,7 +533,7 @@ calculate_pattern_prototype()
         }
                 
         Base_::patch_neighbors_->find_neighbors( Base_::TI_grid_->geovalue(node_id) );
-        vector<float> temp_prop( Base_::nfacies_, 0.0);
+        float* temp_prop = &each_pattern_prop_[ i*Base_::nfacies_ ];
         
         // only use the nodes within patch template to calculate pattern proportion
         for( Neighborhood::iterator pt_nb_iter = Base_::patch_neighbors_->begin();
@@ -540,8 +548,6 @@ calculate_pattern_prototype()
             temp_prop[j] /= static_cast<float>( Base_::pt_nb_neighbors_ );
             pattern_mean_prop_[j] += temp_prop[j];
         }
-
-        each_pattern_prop_.push_back( temp_prop );
     }
     
     for (j=0; j < Base_::nfacies_; j++)
@@ -46,6 +46,25 @@
 #include "pattern.h"
 #include "prototype.h"
 #include "partition.h"
+#include "pattern_store.h"
+
+
+/*
+ * function to split the replicates of a prototype into groups with a 
+ * splitter. The replicates of group g are range [bounds[g], bounds[g+1])
+ * of the index list of the pattern store. Returns the number of groups.
+ */
+template< class Splitter, class Prototype >
+int split_replicates( Splitter& splitter, Prototype& proto, vector<int>& bounds )
+{
+    vector<int> group;
+    int nb_groups = splitter.execute( proto, group );
+
+    int first = proto.get_first_pattern();
+    proto.get_patterns()->split( first, first + proto.get_replicates(), 
+                                 group, nb_groups, bounds );
+    return nb_groups;
+}
 
 
 /*
@@ -59,7 +78,10 @@ public:
     typedef typename list< Prototype >::iterator ListItr;
 
 public:
-    InitializePrototypeList( int bins=2 ){ splitter_ = Splitter(bins); }
+    InitializePrototypeList( int bins=2, int nb_threads=0 )
+    { 
+        splitter_ = Splitter(bins, nb_threads); 
+    }
     ~InitializePrototypeList(){}
 
     void execute( list<Prototype>& prototype_list );
@@ -82,11 +104,11 @@ public:
     typedef typename list< Prototype >::iterator ListItr;
 
 public:
-    SplitPrototype( int cmin=10, int nbin=2 ) 
+    SplitPrototype( int cmin=10, int nbin=2, int nb_threads=0 ) 
     { 
         optReplicateCutoff = cmin; 
         optVarianceCutoff = 0.95;
-        splitter_ = Splitter(nbin); 
+        splitter_ = Splitter(nbin, nb_threads); 
     }
 
     ~SplitPrototype(){};
@@ -124,14 +146,16 @@ execute( list<Prototype>& prototype_list )
     vector<float> prototype_weight = itr->get_prototype_weight();
     Window_neighborhood* neighbors = itr->get_neighbor();
     Window_neighborhood* patch_neighbors = itr->get_patch_neighbor();
+    Pattern_store* patterns = itr->get_patterns();
 
-    vector< ScoresType > grouped_score;
-    splitter_.execute( *itr, grouped_score );
+    vector<int> bounds;
+    int nb_groups = split_replicates( splitter_, *itr, bounds );
 
     prototype_list.clear();
-    for ( int i=0; i<grouped_score.size(); i++ )
+    for ( int i=0; i<nb_groups; i++ )
     {
-        Prototype proto( TI_grid, neighbors, patch_neighbors, grouped_score[i], prototype_weight, nb_facies);
+        Prototype proto( TI_grid, neighbors, patch_neighbors, patterns, 
+                         bounds[i], bounds[i+1], prototype_weight, nb_facies);
         prototype_list.push_back( proto );
     }
 
@@ -224,16 +248,18 @@ execute( list<Prototype>& prototype_list )
     vector<float> prototype_weight = itr->get_prototype_weight();
     Window_neighborhood* neighbors = itr->get_neighbor();
     Window_neighborhood* patch_neighbors = itr->get_patch_neighbor();
+    Pattern_store* patterns = itr->get_patterns();
 
+    vector<int> bounds;
     while( splitLocItr.size()>0 )
     {
-        vector< ScoresType > grouped_score;
-        splitter_.execute( *(splitLocItr[0]), grouped_score );
+        int nb_groups = split_replicates( splitter_, *(splitLocItr[0]), bounds );
         
         // create new prototypes
-        for (int j=0; j<grouped_score.size(); j++)
+        for (int j=0; j<nb_groups; j++)
         {
-            Prototype proto( TI_grid, neighbors, patch_neighbors, grouped_score[j], prototype_weight, nb_facies);
+            Prototype proto( TI_grid, neighbors, patch_neighbors, patterns, 
+                             bounds[j], bounds[j+1], prototype_weight, nb_facies);
             prototype_list.push_back( proto );
 
             end_itr++;
@@ -303,16 +329,18 @@ splitOneParentPrototype( list<Prototype>& prototype_list, const ListItr split_it
     vector<float> prototype_weight = split_itr->get_prototype_weight();
     Window_neighborhood* neighbors = split_itr->get_neighbor();
     Window_neighborhood* patch_neighbors = split_itr->get_patch_neighbor();
+    Pattern_store* patterns = split_itr->get_patterns();
 
     // loop until no more split
+    vector<int> bounds;
     while( splitLocItr.size()>0 )
     {
-        vector< ScoresType > grouped_score;
-        splitter_.execute( *(splitLocItr[0]), grouped_score );
+        int nb_groups = split_replicates( splitter_, *(splitLocItr[0]), bounds );
         
-        for (int j=0; j<grouped_score.size(); j++)
+        for (int j=0; j<nb_groups; j++)
         {
-            Prototype proto( TI_grid, neighbors, patch_neighbors, grouped_score[j], prototype_weight, nb_facies);
+            Prototype proto( TI_grid, neighbors, patch_neighbors, patterns, 
+                             bounds[j], bounds[j+1], prototype_weight, nb_facies);
             prototype_list.push_back( proto );
 
             end_itr++;
@@ -323,7 +351,7 @@ splitOneParentPrototype( list<Prototype>& prototype_list, const ListItr split_it
             // for further splitting
             if ( proto.get_replicates() > optReplicateCutoff &&    
                  proto.get_prototype_sharpness() < optVarianceCutoff &&
-                 grouped_score.size() > 1 )
+                 nb_groups > 1 )
             {
                 splitLocItr.push_back( end_itr );
             }
@@ -40,12 +40,15 @@
 #include <GsTLAppli/math/random_numbers.h>
 #include <GsTLAppli/utils/string_manipulation.h>
 #include <GsTLAppli/geostat/utilities.h>
+#include <GsTL/utils/smartptr.h>
 
 #include "filters.h"
 #include "distance.h"
 #include "pattern.h"
+#include "pattern_store.h"
 #include "prototype.h"
 #include "prototype_help.h"
+#include "prototype_search_tree.h"
 
 #include <list>
 #include <sstream> 
@@ -73,14 +76,21 @@ public:
     typedef typename Prototype::mean_prop_type mean_prop_type;
 
 public:
-    // constructor
+    // constructor: the prototypes are built from the patterns of "score", 
+    // which is shared by the copies of the prototype list
     // filter_weight must be created in filtersim, its size is
     //      (nb_facies-1)*filter :  if nb_facies > 2 && treat_cate_as_cont_=0
     //      filter               :  if nb_facies > 2 or treat_cate_as_cont_=1
+    // nb_threads is the number of threads of the splitters (0: one thread)
     PrototypeList( RGrid* TI_grid, Window_neighborhood* neighbors, 
-                   Window_neighborhood* patch_neighbors, ScoresType& score,
-                   vector<float>& filter_weight, int nfacies, int cmin, int nbins, int nbins_2nd );
-    PrototypeList(){}
+                   Window_neighborhood* patch_neighbors, Pattern_store* score,
+                   vector<float>& filter_weight, int nfacies, int cmin, int nbins, int nbins_2nd,
+                   int nb_threads = 0 );
+    PrototypeList() {}
+
+    // the copies rebuild the prototype index over their own lists
+    PrototypeList( const PrototypeList& rhs );
+    PrototypeList& operator=( const PrototypeList& rhs );
 
     ~PrototypeList(){};
 
@@ -101,6 +111,8 @@ public:
 
 private:
     void clean_score_value();
+    void build_search_trees();
+    void update_prototype_index();
 
 private:
     RGrid* TI_grid_;
@@ -115,11 +127,24 @@ private:
     int cmin_;
     int nb_templ_;
 
+    // the scores and node ids of all the patterns
+    SmartPtr< Pattern_store > patterns_;
+
     // parent prototype list
     list< Prototype > prototypes_;
     // for the purpose of secondary prototype searching
     vector< list< Prototype > > child_prototypes_;
 
+    // search trees over the prototype scores, built once for the multiple
+    // grid, to find the closest prototype from a DEV score
+    Prototype_search_tree< Distance > parent_tree_;
+    vector< Prototype_search_tree< Distance > > child_trees_;
+
+    // the prototypes in list order. The index points into the lists of
+    // this object, it is rebuilt whenever the prototype list is copied
+    vector< Prototype* > parent_index_;
+    vector< vector< Prototype* > > child_index_;
+
 private:
     InitializePrototypeList initialization_;
     SplitPrototype split_;
@@ -141,23 +166,91 @@ template
 >
 PrototypeList<Prototype, InitializePrototypeList, SplitPrototype, Distance>::
 PrototypeList( RGrid* TI_grid, Window_neighborhood* neighbors, 
-               Window_neighborhood* patch_neighbors, ScoresType& score,
-               vector<float>& filter_weight, int nfacies, int cmin, int nbins, int nbins_2nd )
+               Window_neighborhood* patch_neighbors, Pattern_store* score,
+               vector<float>& filter_weight, int nfacies, int cmin, int nbins, int nbins_2nd,
+               int nb_threads )
     : TI_grid_(TI_grid), neighbors_(neighbors), 
-      patch_neighbors_(patch_neighbors), filter_weight_(filter_weight) 
+      patch_neighbors_(patch_neighbors), filter_weight_(filter_weight),
+      patterns_( score )
 {
     nfacies_ = nfacies;
     cmin_ = cmin;
     nbins_ = nbins; // # of bins for first partition
     nbins_2nd_ = nbins_2nd; // # of bins for the second partition
 
-    // initialize the root prototype
-    prototypes_.push_back( Prototype(TI_grid, neighbors, patch_neighbors, score, filter_weight, nfacies) );
+    // initialize the root prototype, with all the patterns
+    score->reset_index();
+    prototypes_.push_back( Prototype(TI_grid, neighbors, patch_neighbors, score, 
+                                     0, score->size(), filter_weight, nfacies) );
 
     nb_templ_ = neighbors->max_size();
 
-    initialization_ = InitializePrototypeList( nbins_ );
-    split_ = SplitPrototype( cmin_, nbins_2nd_ );
+    initialization_ = InitializePrototypeList( nbins_, nb_threads );
+    split_ = SplitPrototype( cmin_, nbins_2nd_, nb_threads );
+}
+
+
+/*
+ * copy constructor and assignment: the prototype lists are copied, 
+ * the index is rebuilt to point into the new lists
+ */
+template 
+< 
+    class Prototype,
+    class InitializePrototypeList, 
+    class SplitPrototype, 
+    class Distance
+>
+PrototypeList<Prototype, InitializePrototypeList, SplitPrototype, Distance>::
+PrototypeList( const PrototypeList& rhs )
+    : TI_grid_( rhs.TI_grid_ ), neighbors_( rhs.neighbors_ ),
+      patch_neighbors_( rhs.patch_neighbors_ ), filter_weight_( rhs.filter_weight_ ),
+      nbins_( rhs.nbins_ ), nbins_2nd_( rhs.nbins_2nd_ ), 
+      nb_parent_proto_( rhs.nb_parent_proto_ ), nfacies_( rhs.nfacies_ ),
+      cmin_( rhs.cmin_ ), nb_templ_( rhs.nb_templ_ ), patterns_( rhs.patterns_ ),
+      prototypes_( rhs.prototypes_ ), child_prototypes_( rhs.child_prototypes_ ),
+      parent_tree_( rhs.parent_tree_ ), child_trees_( rhs.child_trees_ ),
+      initialization_( rhs.initialization_ ), split_( rhs.split_ ),
+      distance_( rhs.distance_ ), gen_( rhs.gen_ )
+{
+    update_prototype_index();
+}
+
+template 
+< 
+    class Prototype,
+    class InitializePrototypeList, 
+    class SplitPrototype, 
+    class Distance
+>
+PrototypeList<Prototype, InitializePrototypeList, SplitPrototype, Distance>&
+PrototypeList<Prototype, InitializePrototypeList, SplitPrototype, Distance>::
+operator=( const PrototypeList& rhs )
+{
+    if ( this == &rhs )    return *this;
+
+    TI_grid_ = rhs.TI_grid_;
+    neighbors_ = rhs.neighbors_;
+    patch_neighbors_ = rhs.patch_neighbors_;
+    filter_weight_ = rhs.filter_weight_;
+    nbins_ = rhs.nbins_;
+    nbins_2nd_ = rhs.nbins_2nd_;
+    nb_parent_proto_ = rhs.nb_parent_proto_;
+    nfacies_ = rhs.nfacies_;
+    cmin_ = rhs.cmin_;
+    nb_templ_ = rhs.nb_templ_;
+    patterns_ = rhs.patterns_;
+    prototypes_ = rhs.prototypes_;
+    child_prototypes_ = rhs.child_prototypes_;
+    parent_tree_ = rhs.parent_tree_;
+    child_trees_ = rhs.child_trees_;
+    initialization_ = rhs.initialization_;
+    split_ = rhs.split_;
+    distance_ = rhs.distance_;
+    gen_ = rhs.gen_;
+
+    update_prototype_index();
+    return *this;
 }
 
 
@@ -206,6 +299,9 @@ create_prototype_list()
     GsTLcout << ", total number of children prototypes is " << nb_children 
                     << ".  CPU time: " << run_time << " seconds" << gstlIO::end;
 
+    build_search_trees();
+    update_prototype_index();
+
     // remove the score values which will not be used in the future
     clean_score_value();
 }
@@ -224,60 +320,66 @@ template
 Prototype& PrototypeList<Prototype, InitializePrototypeList, SplitPrototype, Distance>::
 find_closet_prototype( vector<float>& dev_score )
 {
-    // initialize distance vector for parent-prototype-list
-    vector<float> dist( nb_parent_proto_, 0.);
-    int i=0;
-
-    ListItr itr = prototypes_.begin();
-    for (; itr != prototypes_.end(); itr++, i++)
-        dist[i] = itr->get_score_distance( dev_score );
-
     // the best parent-prototype id
-    int prototype_id = std::min_element( dist.begin(), dist.end() ) - dist.begin();
-    /*
-    std::stable_sort( dist.begin(), dist.end() );
-    int icountP=std::count( dist.begin(), dist.end(), *(dist.begin()) );
-    Rand48_generator gen;
-    int prototype_id = floor( gen()*(icountP-1) ); 
-
-    GsTLcout << "selected prototype id: " << prototype_id 
-                    << " out of " << nb_parent_proto_
-                    << " prototypes." << gstlIO::end;
-    */
+    int prototype_id = parent_tree_.find_closest( dev_score );
 
     // has child prototype list
     if ( child_prototypes_[ prototype_id ].size()>0 )
     {
-        list< Prototype >& child = child_prototypes_[ prototype_id ];
-        vector<float> child_dist( child.size(), 0.);
-        i=0;
+        // the best child-prototype id
+        int child_id = child_trees_[ prototype_id ].find_closest( dev_score );
+        return *child_index_[ prototype_id ][ child_id ];
+    }
+    else    // no child prototype list
+        return *parent_index_[ prototype_id ];
+}
 
-        ListItr child_itr = child.begin();
-        for ( ; child_itr != child.end(); child_itr++, i++)
-              child_dist[i] = child_itr->get_score_distance( dev_score );
 
-        // the best child-prototype id
-        prototype_id = std::min_element( child_dist.begin(), child_dist.end() ) - child_dist.begin();
-        /*
-        std::stable_sort( child_dist.begin(), child_dist.end() );
-        int icountC=std::count( child_dist.begin(), child_dist.end(), *(child_dist.begin()) );
-        Rand48_generator gen;
-        prototype_id = floor( gen()*(icountC-1) ); 
-        */
+/*
+ * function to build the search trees over the scores of the parent 
+ * prototypes and of each child-prototype-list
+ */
+template 
+< 
+    class Prototype,
+    class InitializePrototypeList, 
+    class SplitPrototype, 
+    class Distance
+>
+void PrototypeList<Prototype, InitializePrototypeList, SplitPrototype, Distance>::
+build_search_trees()
+{
+    parent_tree_.build( prototypes_.begin(), prototypes_.end() );
 
-        child_itr = child.begin();
-        for (i=0; i<prototype_id; i++)
-            child_itr++;
+    child_trees_.resize( child_prototypes_.size() );
+    for (int i=0; i<child_prototypes_.size(); i++)
+        child_trees_[i].build( child_prototypes_[i].begin(), child_prototypes_[i].end() );
+}
 
-        return *child_itr;
-    }
-    else    // no child prototype list
-    {
-        itr = prototypes_.begin();
-        for (i=0; i<prototype_id; i++)
-            itr++;
 
-        return *itr;
+/*
+ * function to index the prototypes in list order, the search trees
+ * return the position of the prototype in its list
+ */
+template 
+< 
+    class Prototype,
+    class InitializePrototypeList, 
+    class SplitPrototype, 
+    class Distance
+>
+void PrototypeList<Prototype, InitializePrototypeList, SplitPrototype, Distance>::
+update_prototype_index()
+{
+    parent_index_.clear();
+    for ( ListItr itr = prototypes_.begin(); itr != prototypes_.end(); itr++ )
+        parent_index_.push_back( &(*itr) );
+
+    child_index_.assign( child_prototypes_.size(), vector< Prototype* >() );
+    for (int i=0; i<child_prototypes_.size(); i++)
+    {
+        for ( ListItr itr = child_prototypes_[i].begin(); itr != child_prototypes_[i].end(); itr++ )
+            child_index_[i].push_back( &(*itr) );
     }
 }
 
@@ -377,10 +479,9 @@ create_prototype_indicator()
     int prototype_id=0;
     for (ListItr itr = prototypes_.begin(); itr != prototypes_.end(); itr++, prototype_id++)
     {
-        ScoresType cur_score = itr->get_score();
         for (int i=0; i<itr->get_replicates(); i++)
         {
-            int node_id = cur_score[i].first;
+            int node_id = itr->get_node_id( i );
             prop->set_value(prototype_id, node_id);
         }
     }
@@ -413,6 +514,9 @@ clean_score_value()
             }
         }
     }
+
+    // the node ids of the patterns are kept, to paste them
+    patterns_->release_scores();
 }
 
 
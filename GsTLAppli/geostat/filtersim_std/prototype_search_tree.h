@@ -0,0 +1,253 @@
+/**********************************************************************
+** Author: Jianbing Wu, Alexandre Boucher
+** Contributor: Tuanfeng Zhang
+**
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Stanford Geostatistical 
+** Earth Modeling Software (SGEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+
+
+#ifndef __filtersim_prototype_search_tree_H__
+#define __filtersim_prototype_search_tree_H__
+
+#include <GsTLAppli/geostat/common.h>
+#include <GsTL/math/math_functions.h>
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+/*
+ * template class Prototype_search_tree
+ * k-d tree over the score vectors of a list of prototypes. It finds the 
+ * prototype closest to a data event score without computing the distance 
+ * to all the prototypes. 
+ * Distance must be one of the distances of distance.h: the distance between
+ * two vectors is never smaller than the difference of two of their 
+ * coordinates, and the distance can be computed with early termination.
+ * The prototype found is the one a linear scan of the list would return:
+ * if several prototypes are at the same distance, the first one is kept.
+ */
+template< class Distance >
+class GEOSTAT_DECL Prototype_search_tree
+{
+public:
+    Prototype_search_tree( float no_data_value = -9966699 ) 
+        : dim_( 0 ), size_( 0 ), can_split_( true ), UNINFORMED( no_data_value ) {}
+
+    // build the tree from the scores of the prototypes in [begin, end)
+    template< class PrototypeIterator >
+    void build( PrototypeIterator begin, PrototypeIterator end );
+
+    int size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // return the position in the list of the closest prototype, -1 if empty
+    int find_closest( std::vector<float>& score );
+
+private:
+    struct Node 
+    {
+        int first, last;        // range of points_ in the node
+        int split_dim;
+        float split_value;
+        int left, right;        // children, -1 for a leaf
+    };
+
+    enum { leaf_size = 8 };
+
+    int build_node( int first, int last );
+    void search( int node, std::vector<float>& score, 
+                 float& best_dist, int& best_id );
+    float coordinate( int point, int d ) const { return points_[ point*dim_ + d ]; }
+
+private:
+    int dim_;
+    int size_;
+    bool can_split_;        // false if a prototype score is not informed
+    float UNINFORMED;
+
+    std::vector<float> points_;     // scores, reordered by the tree
+    std::vector<int> ids_;          // position in the list of each point
+    std::vector<Node> nodes_;
+
+    Distance distance_;
+};
+
+
+/*
+ * the points are split along their coordinate of largest spread, at the 
+ * median
+ */
+template< class Distance >
+template< class PrototypeIterator >
+void Prototype_search_tree< Distance >::
+build( PrototypeIterator begin, PrototypeIterator end )
+{
+    points_.clear();
+    ids_.clear();
+    nodes_.clear();
+    size_ = 0;
+    dim_ = 0;
+    can_split_ = true;
+    if( begin == end ) return;
+
+    dim_ = begin->get_prototype_score().size();
+    for( int id = 0; begin != end; ++begin, ++id ) 
+    {
+        std::vector<float>& score = begin->get_prototype_score();
+        points_.insert( points_.end(), score.begin(), score.end() );
+        ids_.push_back( id );
+    }
+    size_ = ids_.size();
+
+    // the coordinates of the prototypes are used as bounds: they must all 
+    // be informed, otherwise the tree is a single leaf
+    for( unsigned int i = 0; i < points_.size(); i++ ) 
+        if( GsTL::equals( points_[i], UNINFORMED ) ) can_split_ = false;
+
+    build_node( 0, size_ );
+}
+
+
+template< class Distance >
+int Prototype_search_tree< Distance >::
+build_node( int first, int last )
+{
+    Node node;
+    node.first = first;
+    node.last = last;
+    node.split_dim = 0;
+    node.split_value = 0;
+    node.left = -1;
+    node.right = -1;
+
+    const int id = nodes_.size();
+    nodes_.push_back( node );
+    if( last - first <= leaf_size || dim_ == 0 || !can_split_ ) return id;
+
+    // coordinate of largest spread
+    float max_spread = -1;
+    for( int d = 0; d < dim_; d++ ) 
+    {
+        float min_value = coordinate( first, d ), max_value = min_value;
+        for( int p = first+1; p < last; p++ ) 
+        {
+            min_value = std::min( min_value, coordinate( p, d ) );
+            max_value = std::max( max_value, coordinate( p, d ) );
+        }
+        if( max_value - min_value > max_spread ) 
+        {
+            max_spread = max_value - min_value;
+            node.split_dim = d;
+        }
+    }
+    if( max_spread <= 0 ) return id;
+
+    // sort the points on the split coordinate and cut at the median
+    std::vector< std::pair<float,int> > order;
+    for( int p = first; p < last; p++ )
+        order.push_back( std::make_pair( coordinate( p, node.split_dim ), p ) );
+    std::sort( order.begin(), order.end() );
+
+    std::vector<float> points( ( last-first )*dim_ );
+    std::vector<int> ids( last-first );
+    for( int p = 0; p < last-first; p++ ) 
+    {
+        std::copy( points_.begin() + order[p].second*dim_, 
+                   points_.begin() + ( order[p].second+1 )*dim_, 
+                   points.begin() + p*dim_ );
+        ids[p] = ids_[ order[p].second ];
+    }
+    std::copy( points.begin(), points.end(), points_.begin() + first*dim_ );
+    std::copy( ids.begin(), ids.end(), ids_.begin() + first );
+
+    const int middle = first + ( last-first )/2;
+    node.split_value = coordinate( middle, node.split_dim );
+
+    // the left points are <= split value, the right ones >= split value
+    node.left = build_node( first, middle );
+    node.right = build_node( middle, last );
+    nodes_[id] = node;
+    return id;
+}
+
+
+template< class Distance >
+int Prototype_search_tree< Distance >::
+find_closest( std::vector<float>& score )
+{
+    if( empty() ) return -1;
+
+    float best_dist = std::numeric_limits<float>::max();
+    int best_id = -1;
+    search( 0, score, best_dist, best_id );
+    return best_id;
+}
+
+
+template< class Distance >
+void Prototype_search_tree< Distance >::
+search( int node_id, std::vector<float>& score, float& best_dist, int& best_id )
+{
+    const Node& node = nodes_[ node_id ];
+
+    if( node.left < 0 ) 
+    {
+        for( int p = node.first; p < node.last; p++ ) 
+        {
+            // the distance computation stops as soon as it exceeds best_dist
+            float dist = best_dist;
+            std::vector<float>::iterator point = points_.begin() + p*dim_;
+            if( !distance_( point, point + dim_, score.begin(), dist ) ) 
+                continue;
+            if( dist < best_dist || ( dist == best_dist && ids_[p] < best_id ) ) 
+            {
+                best_dist = dist;
+                best_id = ids_[p];
+            }
+        }
+        return;
+    }
+
+    // visit the side of the query first
+    const float q = score[ node.split_dim ];
+    const bool informed = !GsTL::equals( q, UNINFORMED );
+    const bool left_first = !informed || q < node.split_value;
+    const int near_child = left_first ? node.left : node.right;
+    const int far_child = left_first ? node.right : node.left;
+
+    search( near_child, score, best_dist, best_id );
+
+    // all the points of the other side are at least that far
+    const float bound = informed ? std::fabs( q - node.split_value ) : 0.f;
+    if( bound <= best_dist * ( 1 + 1e-6f ) )
+        search( far_child, score, best_dist, best_id );
+}
+
+
+#endif  // __filtersim_prototype_search_tree_H__
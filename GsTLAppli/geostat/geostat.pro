@@ -12,6 +12,8 @@ HEADERS += cokriging.h \
            common.h \
            cosgsim.h \
            cosisim.h \
+           covariance_table.h \
+           kriging_system_cache.h \
            dssim.h \
            Filtersim_filters.h \
            geostat_algo.h \
@@ -41,6 +43,7 @@ HEADERS += cokriging.h \
            filtersim_std/dev_finder.h \
            filtersim_std/distance.h \
            filtersim_std/distance_kernels.h \
+           filtersim_std/filter_scores.h \
            filtersim_std/filters.h \
            filtersim_std/filtersim.h \
            filtersim_std/filtersim_cate.h \
@@ -54,13 +57,17 @@ HEADERS += cokriging.h \
            filtersim_std/patch_helper.h \
            filtersim_std/pattern.h \
            filtersim_std/pattern_paster.h \
+           filtersim_std/pattern_store.h \
+           filtersim_std/pixel_distance.h \
            filtersim_std/prototype.h \
            filtersim_std/prototype_help.h \
            filtersim_std/Prototype_kernelized_kmeans.h \
            filtersim_std/prototype_list.h \
+           filtersim_std/prototype_search_tree.h \
            filtersim_std/sequential_patch_simulation.h \
            filtersim_std/tau_updating.h \
            filtersim_std/TI_manipulation.h \
+           snesim_std/compact_search_tree.h \
            snesim_std/is_categorical.h \
            snesim_std/is_categorical.hpp \
            snesim_std/layer_sequential_simulation.h \
@@ -74,6 +81,8 @@ HEADERS += cokriging.h \
 SOURCES += cokriging.cpp \
            cosgsim.cpp \
            cosisim.cpp \
+           covariance_table.cpp \
+           kriging_system_cache.cpp \
            dssim.cpp \
            grid_variog_computer.cpp \
            hmatch.cpp \
@@ -97,6 +106,7 @@ SOURCES += cokriging.cpp \
            kriging_mean.cpp \
            Postsim_categorical.cpp \           
            filtersim_std/dev_finder.cpp \
+           filtersim_std/filter_scores.cpp \
            filtersim_std/filters.cpp \
            filtersim_std/filtersim.cpp \
            filtersim_std/filtersim_cate.cpp \
@@ -106,7 +116,10 @@ SOURCES += cokriging.cpp \
            filtersim_std/partition.cpp \
            filtersim_std/patch_helper.cpp \
            filtersim_std/pattern_paster.cpp \
+           filtersim_std/pattern_store.cpp \
+           filtersim_std/pixel_distance.cpp \
            filtersim_std/TI_manipulation.cpp \
+           snesim_std/compact_search_tree.cpp \
            snesim_std/layer_servo_system_sampler.cpp \
            snesim_std/NodeDropped.cpp \
            snesim_std/snesim_std.cpp
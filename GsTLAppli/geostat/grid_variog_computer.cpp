@@ -29,6 +29,7 @@
 #include <GsTLAppli/geostat/grid_variog_computer.h>
 #include <GsTLAppli/grid/grid_model/rgrid.h>
 #include <GsTLAppli/grid/grid_model/sgrid_cursor.h>
+#include <GsTLAppli/grid/grid_model/bit_flags.h>
 #include <GsTLAppli/math/discrete_function.h>
 #include <GsTLAppli/math/correlation_measure.h>
 #include <GsTLAppli/utils/progress_notifier.h>
@@ -106,6 +107,16 @@ compute_variogram_values( Discrete_function &experim_variog,
   std::vector<double> x_values;
   std::vector<double> y_values;
 
+  // a pair can only be used if both properties are informed at both ends.
+  // Compute once the mask of the nodes where both are informed
+  Bit_flags informed;
+  head_prop_->informed_mask( informed );
+  if( tail_prop_ != head_prop_ ) {
+    Bit_flags tail_informed;
+    tail_prop_->informed_mask( tail_informed );
+    informed &= tail_informed;
+  }
+
   for ( int lag = 0 ;  lag < lags_count; lag++ ) {
 
     Correlation_measure* correl_measure = correl_measure_prototype->clone();
@@ -123,12 +134,10 @@ compute_variogram_values( Discrete_function &experim_variog,
           }
 
           int tail_id = cursor.node_id( u,v,w );
-          if( !head_prop_->is_informed( tail_id ) ) continue;
-          if( !tail_prop_->is_informed( tail_id ) ) continue;
+          if( !informed.test( tail_id ) ) continue;
   
           int head_id = cursor.node_id( u+step.x(), v+step.y(), w+step.z() );
-          if( !head_prop_->is_informed( head_id ) ) continue;
-          if( !tail_prop_->is_informed( head_id ) ) continue;
+          if( !informed.test( head_id ) ) continue;
 
           Correlation_measure::ValPair head_prop_pair = 
             std::make_pair( head_prop_->get_value(head_id), head_prop_->get_value(tail_id) );
@@ -168,9 +177,14 @@ double Grid_variog_computer:: compute_covariance() const {
   double tail_mean=0;
   int count=0;
 
-  for( int j=0; j < head_prop_->size() ; j++ ) {
+  Bit_flags informed;
+  head_prop_->informed_mask( informed );
+  Bit_flags tail_informed;
+  tail_prop_->informed_mask( tail_informed );
+  informed &= tail_informed;
 
-    if( !head_prop_->is_informed(j) || !tail_prop_->is_informed(j) ) continue;
+  for( int j=informed.find_first(); j < head_prop_->size() ; 
+       j=informed.find_next(j) ) {
 
     covar += head_prop_->get_value(j) * (tail_prop_->get_value(j) );
     head_mean += head_prop_->get_value(j);
@@ -29,6 +29,7 @@
 #include <GsTLAppli/geostat/indicator_kriging.h>
 #include <GsTLAppli/geostat/parameters_handler.h>
 #include <GsTLAppli/geostat/utilities.h>
+#include <GsTLAppli/geostat/kriging_system_cache.h>
 #include <GsTLAppli/utils/gstl_messages.h>
 #include <GsTLAppli/utils/error_messages_handler.h>
 #include <GsTLAppli/utils/string_manipulation.h>
@@ -92,10 +93,15 @@ int Indicator_kriging::median_ik( Progress_notifier* progress_notifier ) {
   }
 
   std::vector<double> krig_weights;
+  double variance;
   SK_constraints Kconstraints;
   typedef std::vector<double>::const_iterator weight_iterator;
   typedef SK_combiner< weight_iterator, Neighborhood > SKCombiner;
 
+  // neighboring nodes are often informed by the same hard data: the kriging
+  // systems are re-used when possible
+  Kriging_system_cache system_cache;
+
   // the following line could probably be omitted
   simul_grid_->select_property( simul_properties[0]->name() );
 
@@ -115,10 +121,10 @@ int Indicator_kriging::median_ik( Progress_notifier* progress_notifier ) {
       continue;
     }
     else {
-      int status = kriging_weights( krig_weights,
-				    begin->location(), 
-				    *(neighborhood_.raw_ptr()),
-				    covar_, Kconstraints );
+      int status = system_cache.kriging_weights( krig_weights, variance,
+                                                 begin->location(), 
+                                                 *(neighborhood_.raw_ptr()),
+                                                 covar_, Kconstraints );
       
       if(status == 0) {
 	      // the kriging system could be solved
@@ -164,6 +170,7 @@ int Indicator_kriging::median_ik( Progress_notifier* progress_notifier ) {
   if( !ok )
     GsTLcerr << "The kriging system could not be solved for every node\n" << gstlIO::end; 
 
+  system_cache.statistics().report( "Median indicator kriging" );
 
   return 0;
 }
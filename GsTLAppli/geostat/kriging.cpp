@@ -40,11 +40,167 @@
 #include <GsTLAppli/grid/grid_model/cartesian_grid.h>
 #include <GsTLAppli/grid/grid_model/point_set.h>
 #include <GsTLAppli/appli/utilities.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
 
 #include <GsTL/kriging/kriging_weights.h>
 #include <GsTL/geometry/Block_covariance.h>
 
 
+// number of consecutive nodes estimated by a job when kriging is run 
+// on several threads
+static const int kriging_chunk_size = 2048;
+
+
+/* Kriging_nodes_task splits the grid into chunks of kriging_chunk_size 
+ * nodes. The objects used to solve the kriging systems are copied for each
+ * thread so that the threads share nothing but read-only data, and two 
+ * chunks never write to the same node.
+ * The neighbors of all the nodes of a chunk are searched in one batch.
+ */
+class Kriging_nodes_task : public Parallel_task {
+  typedef Geostat_grid::location_type Location;
+
+  typedef std::vector<double>::const_iterator weight_iterator; 
+  typedef Kriging_combiner< weight_iterator, Neighborhood > KrigingCombiner; 
+  typedef Kriging_constraints< Neighborhood, Location > KrigingConstraints; 
+
+  struct Thread_data {
+    Thread_data( Neighborhood* neigh, const Grid_covariance_table& cov,
+                 const KrigingConstraints& kconstraints,
+                 const KrigingCombiner& kcombiner ) 
+      : neighborhood( neigh ), covar( cov ), rhs_covar_blk( 0 ),
+        constraints( kconstraints ), combiner( kcombiner ) {}
+    ~Thread_data() {
+      delete rhs_covar_blk;
+    }
+
+    Neighborhood* neighborhood;
+    Grid_covariance_table covar;
+    Block_covariance<Location>* rhs_covar_blk;
+    KrigingConstraints constraints;
+    KrigingCombiner combiner;
+    std::vector<double> weights;
+    Kriging_system_cache system_cache;
+    std::vector<GsTLInt> centers;
+    Neighbor_batch batch;
+  };
+
+public:
+  Kriging_nodes_task( Kriging* kriging, 
+                      GsTLGridProperty* prop, GsTLGridProperty* var_prop,
+                      int max_index, Parallel_progress* progress )
+    : kriging_( kriging ), prop_( prop ), var_prop_( var_prop ), 
+      max_index_( max_index ), progress_( progress ) {
+    for( unsigned int i = 0; i < kriging->thread_neighborhoods_.size(); i++ ) {
+      Thread_data* data = 
+        new Thread_data( kriging->thread_neighborhoods_[i].raw_ptr(), 
+                         kriging->covar_, *kriging->Kconstraints_, 
+                         *kriging->combiner_ );
+      if( kriging->rhs_covar_blk_ )
+        data->rhs_covar_blk = 
+          new Block_covariance<Location>( *kriging->rhs_covar_blk_ );
+      data->weights.reserve( kriging->kriging_weights_.capacity() );
+      data->centers.reserve( kriging_chunk_size );
+      data->system_cache.set_capacity( kriging->system_cache_.capacity() );
+      threads_data_.push_back( data );
+    }
+  }
+
+  ~Kriging_nodes_task() {
+    for( unsigned int i = 0; i < threads_data_.size(); i++ )
+      delete threads_data_[i];
+  }
+
+  int jobs_count() const {
+    return ( max_index_ + kriging_chunk_size - 1 ) / kriging_chunk_size;
+  }
+
+  virtual bool run( int chunk, int thread_id );
+
+  Kriging_system_cache::Statistics cache_statistics() const {
+    Kriging_system_cache::Statistics stats;
+    for( unsigned int i = 0; i < threads_data_.size(); i++ )
+      stats += threads_data_[i]->system_cache.statistics();
+    return stats;
+  }
+
+private:
+  Kriging* kriging_;
+  GsTLGridProperty* prop_;
+  GsTLGridProperty* var_prop_;
+  int max_index_;
+  Parallel_progress* progress_;
+  std::vector<Thread_data*> threads_data_;
+};
+
+
+bool Kriging_nodes_task::run( int chunk, int thread_id ) {
+  Thread_data& data = *threads_data_[thread_id];
+  Neighborhood& neighborhood = *data.neighborhood;
+  const int min_neigh = kriging_->min_neigh_;
+
+  int first = chunk * kriging_chunk_size;
+  int last = std::min( first + kriging_chunk_size, max_index_ );
+
+  typedef Geostat_grid::iterator iterator;
+  Geostat_grid* grid = kriging_->simul_grid_;
+  iterator begin( grid, prop_, first, last, LinearMapIndex() );
+  iterator end( grid, prop_, last, last, LinearMapIndex() );
+
+  // the nodes to estimate
+  data.centers.clear();
+  for( ; begin != end; ++begin ) {
+    if( !begin->is_informed() ) {
+      data.centers.push_back( begin->node_id() );
+      continue;
+    }
+    if( !progress_->notify() ) return false;
+  }
+  if( data.centers.empty() ) return true;
+
+  neighborhood.find_neighbors_batch( grid, prop_, &data.centers[0], 
+                                     data.centers.size(), data.batch );
+
+  for( unsigned int i = 0; i < data.centers.size(); i++ ) {
+    if( !progress_->notify() ) return false;
+
+    const GsTLInt node_id = data.centers[i];
+    Geovalue center( grid, prop_, node_id );
+    neighborhood.set_batch_neighbors( center, data.batch, i );
+    if( neighborhood.size() < min_neigh )  continue;
+    if( !data.batch.valid[i] ) continue;
+
+    const Location& location = center.location();
+
+    double variance;
+    int status;
+    if( data.rhs_covar_blk ) {
+      status  = kriging_weights_2( data.weights, variance,
+                                   location, neighborhood,
+                      				     data.covar, *data.rhs_covar_blk, 
+                                   data.constraints );
+    } 
+    else {
+      status = data.system_cache.kriging_weights_2( data.weights, variance,
+                                                    location, neighborhood,
+                                                    data.covar, data.covar, 
+                                                    data.constraints );
+    }
+
+    // if the kriging system could not be solved, skip the node
+    if( status != 0 ) continue;
+
+    double estimate = data.combiner( data.weights.begin(), data.weights.end(),
+                                     neighborhood );
+    prop_->set_value( estimate, node_id );
+    var_prop_->set_value( variance, node_id );
+  }
+
+  return true;
+}
+
+
+
 Named_interface* Kriging::create_new_interface( std::string& ) {
   return new Kriging;
 }
@@ -56,6 +212,8 @@ Kriging::Kriging() {
   simul_grid_ = 0;
   neighborhood_ = 0;
   min_neigh_ = 0;
+  nb_threads_ = 0;
+  rhs_covar_blk_ = 0;
 }
  
 
@@ -66,6 +224,8 @@ Kriging::~Kriging() {
   if( combiner_ )
     delete combiner_;
 
+  delete rhs_covar_blk_;
+
  // if(blk_covar_)
  //   delete blk_covar_;
 }
@@ -97,14 +257,34 @@ int Kriging::execute( GsTL_project* ) {
     geostat_utils::add_property_to_grid( simul_grid_, var_prop_name );
 
 
+  // If there are fewer conditioning data than the minimum number of 
+  // neighbors, no node can be estimated: don't search the neighborhoods
+  const GsTLGridProperty* harddata_prop = 
+    harddata_grid_->property( harddata_property_name_ );
+  if( harddata_prop && harddata_prop->informed_count() < min_neigh_ ) {
+    GsTLlog << "Kriging: the hard data property " << harddata_property_name_
+            << " has fewer than " << min_neigh_ << " informed values" 
+            << gstlIO::end;
+    return 0;
+  }
+
   typedef Geostat_grid::iterator iterator;
   iterator begin = simul_grid_->begin();
   iterator end = simul_grid_->end();
 
-  Block_covariance<Location>* rhs_covar_blk = 0;
-  if(do_block_kriging_)  
-    rhs_covar_blk = static_cast<Block_covariance<Location>*>(rhs_covar_);
+  if( nb_threads_ != 0 ) {
+    if( prop->can_be_shared() && var_prop->can_be_shared() &&
+        ( !harddata_prop || harddata_prop->can_be_shared() ) )
+      return execute_parallel( prop, var_prop, progress_notifier.raw_ptr() );
+
+    GsTLlog << "Kriging: some of the properties are swapped to disk, "
+            << "the nodes are estimated on a single thread" << gstlIO::end;
+  }
   
+  // prop was just created: no node is informed, and the is_informed() test
+  // below costs one read per node. The iterator is kept (rather than a mask
+  // of the uninformed nodes) because it skips the nodes outside the 
+  // selected region.
   for( ; begin != end; ++begin ) {
     if( !progress_notifier->notify() ) {
       clean( property_name_ );
@@ -132,15 +312,15 @@ int Kriging::execute( GsTL_project* ) {
 
     int status;
     
-    if(rhs_covar_blk) {
+    if(rhs_covar_blk_) {
       status  = kriging_weights_2( kriging_weights_, variance,
                                    begin->location(), *(neighborhood_.raw_ptr()),
-                      				     covar_,*rhs_covar_blk, *Kconstraints_ );
+                      				     covar_,*rhs_covar_blk_, *Kconstraints_ );
     } 
     else {
-      status = kriging_weights_2( kriging_weights_, variance,
-                                  begin->location(), *(neighborhood_.raw_ptr()),
-                      				    covar_,*rhs_covar_, *Kconstraints_ );
+      status = system_cache_.kriging_weights_2( kriging_weights_, variance,
+                                                begin->location(), *(neighborhood_.raw_ptr()),
+                                                covar_, covar_, *Kconstraints_ );
     }
 
     if(status == 0) {
@@ -171,6 +351,28 @@ int Kriging::execute( GsTL_project* ) {
              << gstlIO::end; 
 */
 
+  system_cache_.statistics().report( "Kriging" );
+  return 0;
+}
+
+
+int Kriging::execute_parallel( GsTLGridProperty* prop, 
+                               GsTLGridProperty* var_prop,
+                               Progress_notifier* progress_notifier ) {
+  // the iterators returned by begin() run from index 0 to max_index
+  Geostat_grid::iterator first( simul_grid_, prop, 0, 0, LinearMapIndex() );
+  int max_index = simul_grid_->end( prop ) - first;
+
+  Parallel_progress progress( progress_notifier );
+  Kriging_nodes_task task( this, prop, var_prop, max_index, &progress );
+  bool ok = utils::run_parallel( task, task.jobs_count(), 
+                                 thread_neighborhoods_.size(), &progress );
+  if( !ok ) {
+    clean( property_name_ );
+    return 1;
+  }
+
+  task.cache_statistics().report( "Kriging" );
   return 0;
 }
 
@@ -248,6 +450,8 @@ bool Kriging::initialize( const Parameters_handler* parameters,
 	                        		            parameters, errors );
   if( !init_cov_ok ) return false;
   do_block_kriging_ = parameters->value("do_block_kriging.value") == "1";
+  delete rhs_covar_blk_;
+  rhs_covar_blk_ = 0;
   if( do_block_kriging_ ) {
 
     RGrid* block_grid = dynamic_cast<RGrid*>(simul_grid_);
@@ -265,9 +469,8 @@ bool Kriging::initialize( const Parameters_handler* parameters,
     errors->report(nblock_pts_[2] <= 0,"npoints_z","At least one point is necessary");
     if(!errors->empty()) return false;
 
-    rhs_covar_ = new Block_covariance<Location>(covar_,nblock_pts_,block_grid->geometry()->cell_dims());
+    rhs_covar_blk_ = new Block_covariance<Location>(covar_,nblock_pts_,block_grid->geometry()->cell_dims());
   }
-  else rhs_covar_ = new Covariance<Location>(covar_);
 
 /*  bool init_blk_cok_ok =  initialize_blk_covariance( &blk_covar_, 
             nblock_pts_,covar_, simul_grid_->geometry->cell_dims());
@@ -311,20 +514,32 @@ bool Kriging::initialize( const Parameters_handler* parameters,
   if( !extract_ok ) return false;
 
 
-  harddata_grid_->select_property(harddata_property_name_);
-  if( dynamic_cast<Point_set*>(harddata_grid_) ) {
-  neighborhood_ = SmartPtr<Neighborhood>(
-    harddata_grid_->neighborhood( ellips_ranges, ellips_angles, &covar_, true ) );
-  } 
-  else {
-    neighborhood_ =  SmartPtr<Neighborhood>(
-      harddata_grid_->neighborhood( ellips_ranges, ellips_angles, &covar_ ));
+  neighborhood_ = SmartPtr<Neighborhood>( 
+    create_neighborhood( ellips_ranges, ellips_angles, max_neigh,
+                         parameters, errors ) );
+
+  // If the data are on a regular grid, the covariances between the data
+  // are read from a table. covar_ is passed by its own type to the kriging
+  // functions so that the table lookup is called, not the model.
+  covar_.build_table( harddata_grid_, ellips_ranges, ellips_angles );
+
+  nb_threads_ = 
+    utils::nb_threads_parameter( parameters->value( "Nb_Threads.value" ) );
+
+  // each thread needs its own neighborhood. There is no point in having
+  // more threads than chunks of nodes.
+  thread_neighborhoods_.clear();
+  if( nb_threads_ != 0 ) {
+    int nb_chunks = 
+      std::max( ( simul_grid_->size() + kriging_chunk_size - 1 ) / kriging_chunk_size, 1 );
+    int nb_threads = std::min( utils::thread_count( nb_threads_ ), nb_chunks );
+    thread_neighborhoods_.push_back( neighborhood_ );
+    for( int i = 1; i < nb_threads; i++ ) {
+      thread_neighborhoods_.push_back( SmartPtr<Neighborhood>( 
+        create_neighborhood( ellips_ranges, ellips_angles, max_neigh,
+                             parameters, errors ) ) );
+    }
   }
-  neighborhood_->select_property( harddata_property_name_ );
-  neighborhood_->max_size( max_neigh );
-
-  geostat_utils::set_advanced_search(neighborhood_.raw_ptr(), 
-                      "AdvancedSearch", parameters, errors);
 
   kriging_weights_.reserve( 2 * max_neigh );
 
@@ -349,6 +564,14 @@ bool Kriging::initialize( const Parameters_handler* parameters,
                              parameters, errors,
                              simul_grid_ );
 
+  // With a trend, or with block kriging, the right hand side of the kriging
+  // system can not be rebuilt from the point covariances alone: the kriging
+  // systems are not re-used
+  if( ktype == geostat_utils::KT || do_block_kriging_ )
+    system_cache_.set_capacity( 0 );
+  else
+    system_cache_.set_capacity( Kriging_system_cache::default_capacity );
+
 
   if( !errors->empty() )
     return false;
@@ -358,3 +581,27 @@ bool Kriging::initialize( const Parameters_handler* parameters,
 }
 
 
+
+Neighborhood* Kriging::create_neighborhood( const GsTLTriplet& ranges, 
+                                            const GsTLTriplet& angles,
+                                            int max_neigh,
+                                            const Parameters_handler* parameters,
+                                            Error_messages_handler* errors ) {
+  Neighborhood* neighborhood;
+
+  harddata_grid_->select_property(harddata_property_name_);
+  if( dynamic_cast<Point_set*>(harddata_grid_) ) {
+    neighborhood = 
+      harddata_grid_->neighborhood( ranges, angles, &covar_, true );
+  } 
+  else {
+    neighborhood = harddata_grid_->neighborhood( ranges, angles, &covar_ );
+  }
+  neighborhood->select_property( harddata_property_name_ );
+  neighborhood->max_size( max_neigh );
+
+  geostat_utils::set_advanced_search(neighborhood, 
+                      "AdvancedSearch", parameters, errors);
+
+  return neighborhood;
+}
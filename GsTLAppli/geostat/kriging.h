@@ -33,15 +33,19 @@
 #include <GsTLAppli/geostat/common.h>
 #include <GsTLAppli/geostat/geostat_algo.h> 
 #include <GsTLAppli/geostat/utilities.h> 
+#include <GsTLAppli/geostat/covariance_table.h>
+#include <GsTLAppli/geostat/kriging_system_cache.h>
 #include <GsTLAppli/grid/grid_model/grid_region_temp_selector.h> 
 
 #include <GsTL/geometry/covariance.h> 
 #include <GsTL/geometry/Block_covariance.h>
  
 #include <string> 
+#include <vector> 
  
 class Neighborhood; 
 class RGrid;
+class Progress_notifier;
  
  
 class GEOSTAT_DECL Kriging : public Geostat_algo { 
@@ -60,6 +64,21 @@ class GEOSTAT_DECL Kriging : public Geostat_algo {
  protected:
    void clean( const std::string& prop ); 
 
+   friend class Kriging_nodes_task;
+
+   Neighborhood* create_neighborhood( const GsTLTriplet& ranges, 
+                                      const GsTLTriplet& angles,
+                                      int max_neigh,
+                                      const Parameters_handler* parameters,
+                                      Error_messages_handler* errors );
+
+   /** Estimates the nodes of the grid by chunks, on thread_neighborhoods_.size()
+   * threads. Each thread works with its own neighborhood, covariances, 
+   * constraints, combiner and kriging weights.
+   */
+   int execute_parallel( GsTLGridProperty* prop, GsTLGridProperty* var_prop,
+                         Progress_notifier* progress_notifier );
+
  protected: 
   typedef Geostat_grid::location_type Location; 
   typedef std::vector<double>::const_iterator weight_iterator; 
@@ -76,14 +95,26 @@ class GEOSTAT_DECL Kriging : public Geostat_algo {
    
   SmartPtr<Neighborhood> neighborhood_; 
  
-  Covariance<Location> covar_;
-  Covariance<Location>*  rhs_covar_;
-//Block_covariance<Location>*  rhs_covar_;
+  // covar_ is used for both sides of the kriging system, unless block
+  // kriging is used: the right hand side is then rhs_covar_blk_
+  Grid_covariance_table covar_;
+  Block_covariance<Location>*  rhs_covar_blk_;
   KrigingCombiner* combiner_; 
   KrigingConstraints* Kconstraints_; 
  
   std::vector<double> kriging_weights_;
 
+  // Factorizations of the last kriging systems solved. The cache is disabled
+  // for kriging with a trend and block kriging.
+  Kriging_system_cache system_cache_;
+
+  // If nb_threads_ is 0, the nodes are estimated one after the other by 
+  // the calling thread. Otherwise they are estimated by several threads 
+  // (a negative value means one thread per core), each using one of the
+  // neighborhoods of thread_neighborhoods_.
+  int nb_threads_;
+  std::vector< SmartPtr<Neighborhood> > thread_neighborhoods_;
+
   int min_neigh_;
   GsTLVector<int> nblock_pts_;
 
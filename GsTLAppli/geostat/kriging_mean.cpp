@@ -116,9 +116,9 @@ int KrigingMean::execute( GsTL_project* ) {
     int status;
     
 
-    status = kriging_weights_2( kriging_weights_, variance,
-                                  begin->location(), *(neighborhood_.raw_ptr()),
-                      				    covar_,*rhs_covar_, *Kconstraints_ );
+    status = system_cache_.kriging_weights_2( kriging_weights_, variance,
+                                              begin->location(), *(neighborhood_.raw_ptr()),
+                                              covar_, *rhs_covar_, *Kconstraints_ );
 
 
     if(status == 0) {
@@ -149,6 +149,7 @@ int KrigingMean::execute( GsTL_project* ) {
              << gstlIO::end; 
 */
 
+  system_cache_.statistics().report( "Kriging mean" );
   return 0;
 }
 
@@ -302,6 +303,10 @@ bool KrigingMean::initialize( const Parameters_handler* parameters,
                              parameters, errors,
                              simul_grid_ );
 
+  // the trend components of the right hand side depend on the location
+  if( ktype == geostat_utils::KT )
+    system_cache_.set_capacity( 0 );
+
 
   if( !errors->empty() )
     return false;
@@ -33,6 +33,7 @@
 #include <GsTLAppli/geostat/common.h>
 #include <GsTLAppli/geostat/geostat_algo.h> 
 #include <GsTLAppli/geostat/utilities.h> 
+#include <GsTLAppli/geostat/kriging_system_cache.h>
 #include <GsTLAppli/grid/grid_model/grid_region_temp_selector.h> 
 
 #include <GsTL/geometry/covariance.h> 
@@ -84,6 +85,11 @@ class GEOSTAT_DECL KrigingMean : public Geostat_algo {
  
   std::vector<double> kriging_weights_;
 
+  // The right hand side of the system is zero but for the unbiasedness 
+  // constraints: nodes with the same neighbors get the same weights.
+  // The cache is disabled for kriging with a trend.
+  Kriging_system_cache system_cache_;
+
   int min_neigh_;
   GsTLVector<int> nblock_pts_;
 
@@ -0,0 +1,137 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/geostat/kriging_system_cache.h>
+#include <GsTLAppli/utils/gstl_messages.h>
+
+#include <cmath>
+
+
+Kriging_system_cache::Statistics& 
+Kriging_system_cache::Statistics::operator += ( const Statistics& rhs ) {
+  lookups += rhs.lookups;
+  hits += rhs.hits;
+  miss_time += rhs.miss_time;
+  hit_time += rhs.hit_time;
+  return *this;
+}
+
+
+double Kriging_system_cache::Statistics::time_saved() const {
+  long misses = lookups - hits;
+  if( misses == 0 ) return 0;
+  double saved = double( hits ) * double( miss_time ) / double( misses ) - hit_time;
+  return std::max( saved, 0.0 );
+}
+
+
+void Kriging_system_cache::Statistics::report( const std::string& caller ) const {
+  if( lookups == 0 ) return;
+  GsTLlog << caller << ": " << hits << " of the " << lookups 
+          << " kriging systems were read from the cache ("
+          << int( 100.0 * double( hits ) / double( lookups ) ) << "% hit rate), "
+          << "about " << int( time_saved() ) << " ms saved" << gstlIO::end;
+}
+
+
+
+Kriging_system_cache::Kriging_system_cache( int capacity ) 
+  : capacity_( std::max( capacity, 0 ) ), key_grid_( 0 ) {
+}
+
+
+void Kriging_system_cache::set_capacity( int capacity ) {
+  capacity_ = std::max( capacity, 0 );
+  while( int( systems_.size() ) > capacity_ )
+    systems_.pop_back();
+}
+
+
+void Kriging_system_cache::clear() {
+  systems_.clear();
+}
+
+
+Kriging_system_cache::System* Kriging_system_cache::find_system() {
+  for( SystemList::iterator it = systems_.begin(); it != systems_.end(); ++it ) {
+    if( it->grid != key_grid_ || it->rows.size() != key_.size() ) continue;
+
+    bool same_ids = true;
+    for( unsigned int k = 0; k < key_.size(); k++ ) {
+      if( it->rows[k].first != key_[k].first ) {
+        same_ids = false;
+        break;
+      }
+    }
+    if( !same_ids ) continue;
+
+    // move the system to the front of the list (most recently used)
+    if( it != systems_.begin() )
+      systems_.splice( systems_.begin(), systems_, it );
+    return &systems_.front();
+  }
+  return 0;
+}
+
+
+// The system is not stored if A is singular
+Kriging_system_cache::System* 
+Kriging_system_cache::add_system( const SymMatrix& A, const TNTvector& b ) {
+  const int n = key_.size();
+  const int size = A.num_rows();
+  if( size < n || int( b.size() ) != size ) return 0;
+
+  lhs_.resize( size * size );
+  for( int i = 0; i < size; i++ ) {
+    for( int j = 0; j < size; j++ )
+      lhs_[ i*size + j ] = A( i+1, j+1 );
+  }
+
+  systems_.push_front( System() );
+  System& system = systems_.front();
+  if( !system.solver.factorize( &lhs_[0], size ) ) {
+    systems_.pop_front();
+    return 0;
+  }
+  if( int( systems_.size() ) > capacity_ )
+    systems_.pop_back();
+
+  system.grid = key_grid_;
+  system.rows = key_;
+  system.size = size;
+  for( int r = n; r < size; r++ )
+    system.rhs_constraints.push_back( b( r+1 ) );
+  return &system;
+}
+
+
+// Solves the system for rhs_, the result is written in solution_
+void Kriging_system_cache::solve_factorized( const System& system ) {
+  solution_.assign( rhs_.begin(), rhs_.begin() + system.size );
+  system.solver.solve( &solution_[0] );
+}
@@ -0,0 +1,296 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#ifndef __GSTLAPPLI_GEOSTAT_KRIGING_SYSTEM_CACHE_H__
+#define __GSTLAPPLI_GEOSTAT_KRIGING_SYSTEM_CACHE_H__
+
+
+#include <GsTLAppli/geostat/common.h>
+#include <GsTLAppli/math/symmetric_solver.h>
+#include <GsTLAppli/utils/clock.h>
+
+#include <GsTL/kriging/kriging_weights.h>
+#include <GsTL/matrix_library/tnt_lib.h>
+
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <string>
+#include <utility>
+
+class Geostat_grid;
+
+/** Kriging_system_cache keeps the factorizations of the last few kriging 
+* systems that were solved, keyed by the (sorted) node ids of the 
+* conditioning data. When consecutive nodes are estimated from the same
+* set of conditioning data - dense hard data, median indicator kriging, 
+* kriging of the mean - the left hand side of the kriging system is the 
+* same: only the right hand side is recomputed, and the weights are 
+* obtained by back-substitution.
+*
+* The right hand side of a cached system is rebuilt from the covariances
+* between the conditioning data and the node being estimated. The rows 
+* of the constraints (unbiasedness condition of ordinary kriging) are 
+* assumed not to depend on the location of the node: the cache must be 
+* disabled (capacity 0) for kriging with a trend and for block kriging.
+* When disabled, or if the neighbors do not all belong to the same grid,
+* the systems are solved by the GsTL kriging_weights functions.
+*
+* When the system is solved from the cache, \c weights contains one 
+* weight per conditioning data (the Lagrange parameters are not returned).
+*/
+class GEOSTAT_DECL Kriging_system_cache {
+ public:
+  typedef matrix_lib_traits<GSTL_TNT_lib>::Symmetric_matrix SymMatrix;
+  typedef matrix_lib_traits<GSTL_TNT_lib>::Vector TNTvector;
+
+  struct GEOSTAT_DECL Statistics {
+    Statistics() : lookups( 0 ), hits( 0 ), miss_time( 0 ), hit_time( 0 ) {}
+    Statistics& operator += ( const Statistics& rhs );
+
+    /** Estimate of the time saved by the cache, in milliseconds: the 
+    * average time taken to build and factorize a system, times the number
+    * of hits, minus the time spent on the hits.
+    */
+    double time_saved() const;
+
+    /** Writes the hit rate and time saved to the log, prefixed by \a caller
+    */
+    void report( const std::string& caller ) const;
+
+    long lookups;
+    long hits;
+    double miss_time;   // in ms
+    double hit_time;
+  };
+
+ public:
+  enum { default_capacity = 8 };
+
+  Kriging_system_cache( int capacity = default_capacity );
+
+  /** Sets the maximum number of systems kept. 0 disables the cache.
+  */
+  void set_capacity( int capacity );
+  int capacity() const { return capacity_; }
+  void clear();
+
+  const Statistics& statistics() const { return stats_; }
+  void reset_statistics() { stats_ = Statistics(); }
+
+  /** Same as the GsTL function of the same name
+  */
+  template< class Location, class Neighborhood, 
+            class Covariance, class KrigingConstraints >
+  int kriging_weights( std::vector<double>& weights, double& variance,
+                       const Location& center, const Neighborhood& neighbors,
+                       Covariance& covar, KrigingConstraints& Kconstraints );
+
+  /** Same as the GsTL function of the same name: \a covar_rhs is the 
+  * covariance used for the right hand side of the system.
+  */
+  template< class Location, class Neighborhood, 
+            class Covariance, class Covariance2, class KrigingConstraints >
+  int kriging_weights_2( std::vector<double>& weights, double& variance,
+                         const Location& center, const Neighborhood& neighbors,
+                         Covariance& covar, Covariance2& covar_rhs,
+                         KrigingConstraints& Kconstraints );
+
+ private:
+  // A system is stored as the factorization of its left hand side, with 
+  // the node ids of the conditioning data in the order of the rows
+  struct System {
+    const Geostat_grid* grid;
+    std::vector< std::pair<int,int> > rows;   // (node id, row), sorted by id
+    int size;
+    Symmetric_system_solver solver;
+    std::vector<double> rhs_constraints;
+  };
+
+  typedef std::list<System> SystemList;
+
+  template< class Neighborhood >
+  bool make_key( const Neighborhood& neighbors );
+
+  System* find_system();
+  System* add_system( const SymMatrix& A, const TNTvector& b );
+
+  template< class Location, class Neighborhood, class Covariance >
+  int solve( const System& system, std::vector<double>& weights, 
+             double& variance, const Location& center, 
+             const Neighborhood& neighbors, Covariance& covar_rhs );
+
+  void solve_factorized( const System& system );
+
+  Kriging_system_cache( const Kriging_system_cache& );
+  Kriging_system_cache& operator = ( const Kriging_system_cache& );
+
+ private:
+  int capacity_;
+  SystemList systems_;   // the most recently used system first
+
+  // scratch arrays
+  const Geostat_grid* key_grid_;
+  std::vector< std::pair<int,int> > key_;   // (node id, neighbor index)
+  std::vector<int> row_of_neighbor_;
+  std::vector<double> lhs_;
+  std::vector<double> rhs_;
+  std::vector<double> solution_;
+
+  Statistics stats_;
+  Precise_clock clock_;
+};
+
+
+
+//=================================================
+//   Definition of template functions
+
+template< class Neighborhood >
+bool Kriging_system_cache::make_key( const Neighborhood& neighbors ) {
+  key_.clear();
+  if( neighbors.size() == 0 ) return false;
+
+  typename Neighborhood::const_iterator it = neighbors.begin();
+  key_grid_ = it->grid();
+  for( int i = 0; it != neighbors.end(); ++it, ++i ) {
+    if( it->grid() != key_grid_ ) return false;
+    key_.push_back( std::make_pair( it->node_id(), i ) );
+  }
+
+  std::sort( key_.begin(), key_.end() );
+  for( unsigned int k = 1; k < key_.size(); k++ ) {
+    if( key_[k].first == key_[k-1].first ) return false;
+  }
+  return true;
+}
+
+
+template< class Location, class Neighborhood, class Covariance >
+int Kriging_system_cache::solve( const System& system, 
+                                 std::vector<double>& weights, 
+                                 double& variance, const Location& center, 
+                                 const Neighborhood& neighbors, 
+                                 Covariance& covar_rhs ) {
+  const int n = key_.size();
+  row_of_neighbor_.resize( n );
+  for( int k = 0; k < n; k++ )
+    row_of_neighbor_[ key_[k].second ] = system.rows[k].second;
+
+  rhs_.resize( system.size );
+  typename Neighborhood::const_iterator it = neighbors.begin();
+  for( int i = 0; it != neighbors.end(); ++it, ++i ) 
+    rhs_[ row_of_neighbor_[i] ] = covar_rhs( it->location(), center );
+  std::copy( system.rhs_constraints.begin(), system.rhs_constraints.end(),
+             rhs_.begin() + n );
+
+  solve_factorized( system );
+
+  weights.resize( n );
+  for( int i = 0; i < n; i++ )
+    weights[i] = solution_[ row_of_neighbor_[i] ];
+
+  variance = covar_rhs( center, center );
+  for( int r = 0; r < system.size; r++ )
+    variance -= solution_[r] * rhs_[r];
+
+  return 0;
+}
+
+
+template< class Location, class Neighborhood, 
+          class Covariance, class KrigingConstraints >
+int Kriging_system_cache::kriging_weights( std::vector<double>& weights, 
+                                           double& variance,
+                                           const Location& center, 
+                                           const Neighborhood& neighbors,
+                                           Covariance& covar, 
+                                           KrigingConstraints& Kconstraints ) {
+  if( capacity_ == 0 || !make_key( neighbors ) )
+    return ::kriging_weights( weights, variance, center, neighbors,
+                              covar, Kconstraints );
+
+  clock_.start();
+  stats_.lookups++;
+  System* system = find_system();
+  if( system ) {
+    stats_.hits++;
+    int status = solve( *system, weights, variance, center, neighbors, covar );
+    stats_.hit_time += clock_.elapsed();
+    return status;
+  }
+
+  SymMatrix A;
+  TNTvector b;
+  Kconstraints( A, b, center, neighbors, covar );
+  system = add_system( A, b );
+  int status = 1;
+  if( system )
+    status = solve( *system, weights, variance, center, neighbors, covar );
+  stats_.miss_time += clock_.elapsed();
+  return status;
+}
+
+
+template< class Location, class Neighborhood, 
+          class Covariance, class Covariance2, class KrigingConstraints >
+int Kriging_system_cache::kriging_weights_2( std::vector<double>& weights, 
+                                             double& variance,
+                                             const Location& center, 
+                                             const Neighborhood& neighbors,
+                                             Covariance& covar, 
+                                             Covariance2& covar_rhs,
+                                             KrigingConstraints& Kconstraints ) {
+  if( capacity_ == 0 || !make_key( neighbors ) )
+    return ::kriging_weights_2( weights, variance, center, neighbors,
+                                covar, covar_rhs, Kconstraints );
+
+  clock_.start();
+  stats_.lookups++;
+  System* system = find_system();
+  if( system ) {
+    stats_.hits++;
+    int status = 
+      solve( *system, weights, variance, center, neighbors, covar_rhs );
+    stats_.hit_time += clock_.elapsed();
+    return status;
+  }
+
+  SymMatrix A;
+  TNTvector b;
+  Kconstraints( A, b, center, neighbors, covar, covar_rhs );
+  system = add_system( A, b );
+  int status = 1;
+  if( system )
+    status = solve( *system, weights, variance, center, neighbors, covar_rhs );
+  stats_.miss_time += clock_.elapsed();
+  return status;
+}
+
+
+#endif
@@ -29,6 +29,7 @@
 #include <GsTLAppli/geostat/pset_variog_computer.h>
 #include <GsTLAppli/grid/grid_model/point_set.h>
 #include <GsTLAppli/grid/grid_model/grid_property.h>
+#include <GsTLAppli/grid/grid_model/bit_flags.h>
 #include <GsTLAppli/math/discrete_function.h>
 #include <GsTLAppli/math/gstlvector.h>
 #include <GsTLAppli/math/correlation_measure.h>
@@ -83,6 +84,14 @@ compute_variogram_values( Discrete_function& experim_variog,
   for( unsigned int i = 0 ; i < lags.size() ; i++ )
     correl_measures.push_back( correl_measure->clone() );
                                              
+  // a pair can only be used if both properties are informed at both ends.
+  // Compute once the mask of the points where both are informed
+  Bit_flags informed;
+  head_prop_->informed_mask( informed );
+  Bit_flags tail_informed;
+  tail_prop_->informed_mask( tail_informed );
+  informed &= tail_informed;
+
   const std::vector<Point_set::location_type>& points = pset_->point_locations();
   for( unsigned int i = 0 ; i < points.size() ; i++ ) {
     for( unsigned int j = i+1 ; j < points.size() ; j++ ) {
@@ -99,8 +108,7 @@ compute_variogram_values( Discrete_function& experim_variog,
       /* Check if the 2 points are in the correct direction.
        * If they are, determine which lag the pair belongs to
        */
-      if( !head_prop_->is_informed(i) || !head_prop_->is_informed(j) ) continue; 
-      if( !tail_prop_->is_informed(i) || !tail_prop_->is_informed(j) ) continue; 
+      if( !informed.test(i) || !informed.test(j) ) continue; 
       if( !direction.is_colinear( points[i]-points[j] ) ) continue;
 
       double d = euclidean_distance( points[i], points[j] );
@@ -154,9 +162,8 @@ compute_variogram_values( Discrete_function& experim_variog,
     double head_mean=0;
     double tail_mean=0;
     int count=0;
-    for( int j=0; j < head_prop_->size() ; j++ ) {
-      if( !head_prop_->is_informed(j) || !tail_prop_->is_informed(j) )
-        continue;
+    for( int j=informed.find_first(); j < head_prop_->size() ; 
+         j=informed.find_next(j) ) {
 
       covar += head_prop_->get_value(j) * (tail_prop_->get_value(j) );
       head_mean += head_prop_->get_value(j);
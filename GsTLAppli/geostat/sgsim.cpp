@@ -40,6 +40,7 @@
 #include <GsTLAppli/appli/manager_repository.h>
 #include <GsTLAppli/math/random_numbers.h>
 #include <GsTLAppli/appli/utilities.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
 
 #include <GsTL/cdf/gaussian_cdf.h>
 #include <GsTL/sampler/monte_carlo_sampler.h>
@@ -57,6 +58,47 @@
 
 #include <GsTLAppli/grid/grid_model/reduced_grid.h>
 
+
+// In sequential gaussian simulation, the marginal is a Gaussian cdf, 
+// with mean 0 and variance 1.
+typedef Gaussian_cdf_Kestimator< Grid_covariance_table,
+                                 Neighborhood,
+                                 geostat_utils::KrigingConstraints
+                                >    Kriging_cdf_estimator;
+
+
+/* Each job of the task simulates one realization. The neighborhood used
+ * is the one of the thread that runs the job.
+ */
+class Sgsim_realizations_task : public Parallel_task {
+public:
+  Sgsim_realizations_task( Sgsim* sgsim, 
+                           const std::vector<GsTLGridProperty*>& props,
+                           Parallel_progress* progress )
+    : sgsim_( sgsim ), props_( props ), progress_( progress ),
+      completed_( props.size(), 0 ) {}
+
+  virtual bool run( int nreal, int thread_id ) {
+    bool ok = 
+      sgsim_->simulate_realization( props_[nreal], nreal, 
+                                    sgsim_->thread_neighborhoods_[thread_id].raw_ptr(),
+                                    progress_ );
+    // each job writes its own element: no need to lock
+    if( ok ) completed_[nreal] = 1;
+    return ok;
+  }
+
+  bool completed( int nreal ) const { return completed_[nreal] != 0; }
+
+private:
+  Sgsim* sgsim_;
+  const std::vector<GsTLGridProperty*>& props_;
+  Parallel_progress* progress_;
+  std::vector<char> completed_;
+};
+
+
+
 int Sgsim::execute( GsTL_project* ) {
   
   // Initialize the global random number generator
@@ -81,11 +123,10 @@ int Sgsim::execute( GsTL_project* ) {
     sgrid->set_level( 1 );
   }
 
+  if( nb_threads_ != 0 )
+    return execute_parallel( progress_notifier.raw_ptr() );
+
   // set up the cdf-estimator
-  typedef Gaussian_cdf_Kestimator< Covariance<Location>,
-                                   Neighborhood,
-                                   geostat_utils::KrigingConstraints
-                                  >    Kriging_cdf_estimator;
   Kriging_cdf_estimator cdf_estimator( covar_,
 				       *Kconstraints_,
 				       *combiner_ );
@@ -127,7 +168,8 @@ int Sgsim::execute( GsTL_project* ) {
     appli_message( "Doing simulation" );
 
 	
-    // do the simulation
+    // do the simulation. Only the nodes of the path get informed from now on
+    neighborhood_->track_simulated_centers( true );
     int status = 
       sequential_simulation( simul_grid_->random_path_begin(),
 			     simul_grid_->random_path_end(),
@@ -137,6 +179,7 @@ int Sgsim::execute( GsTL_project* ) {
 			     marginal,
 			     sampler, progress_notifier.raw_ptr()
 			     );
+    neighborhood_->track_simulated_centers( false );
     if( status == -1 ) {
       clean( prop );
       return 1;
@@ -156,6 +199,94 @@ int Sgsim::execute( GsTL_project* ) {
 
 
 
+int Sgsim::execute_parallel( Progress_notifier* progress_notifier ) {
+  const int nb_threads = thread_neighborhoods_.size();
+
+  // Create all the realizations (and copy the hard data) beforehand: the
+  // grid's list of properties must not change while the threads run.
+  std::vector<GsTLGridProperty*> props;
+  for( int nreal = 0; nreal < nb_of_realizations_ ; nreal ++ ) {
+    GsTLGridProperty* prop = multireal_property_->new_realization();
+    if( property_copier_ ) {
+      property_copier_->copy( harddata_grid_, harddata_property_,
+                              simul_grid_, prop );
+    }
+    props.push_back( prop );
+  }
+  simul_grid_->select_property( props.back()->name() );
+
+  progress_notifier->message() << "simulating " << nb_of_realizations_
+                               << " realizations on " << nb_threads 
+                               << " threads" << gstlIO::end;
+
+  Parallel_progress progress( progress_notifier );
+  Sgsim_realizations_task task( this, props, &progress );
+  bool ok = utils::run_parallel( task, nb_of_realizations_, nb_threads, 
+                                 &progress );
+
+  if( !ok ) {
+    // only keep the realizations that were completed
+    for( int nreal = 0; nreal < nb_of_realizations_ ; nreal ++ ) {
+      if( !task.completed( nreal ) )
+        simul_grid_->remove_property( props[nreal]->name() );
+    }
+    clean();
+    return 1;
+  }
+
+  clean();
+  return 0;
+}
+
+
+
+bool Sgsim::simulate_realization( GsTLGridProperty* prop, int nreal,
+                                  Neighborhood* neighborhood,
+                                  Parallel_progress* progress ) {
+  Random_number_stream gen( seed_, nreal );
+
+  // the random path: shuffle the node indices (Fisher-Yates) 
+  std::vector<GsTLInt> path( simul_grid_->size() );
+  for( int i=0; i < int( path.size() ); i++ ) 
+    path[i] = i;
+  for( int i = int( path.size() ) - 1; i > 0; i-- ) 
+    std::swap( path[i], path[ gen( i+1 ) ] );
+
+  Geostat_grid::random_path_iterator 
+    begin( simul_grid_, prop, 0, path.size(), TabularMapIndex( &path ) );
+  Geostat_grid::random_path_iterator 
+    end( simul_grid_, prop, path.size(), path.size(), TabularMapIndex( &path ) );
+
+  neighborhood->select_property( prop->name() );
+
+  Gaussian_cdf marginal( 0.0, 1.0 );
+  Gaussian_cdf ccdf;
+
+  // the combiner and the constraints can hold a neighborhood (eg LVM): 
+  // each realization uses its own copy
+  geostat_utils::KrigingConstraints constraints( *Kconstraints_ );
+  geostat_utils::KrigingCombiner combiner( *combiner_ );
+  Kriging_cdf_estimator cdf_estimator( covar_, constraints, combiner );
+
+  Monte_carlo_sampler_t< Random_number_stream > sampler( gen );
+
+  neighborhood->track_simulated_centers( true );
+  int status = 
+    sequential_simulation( begin, end, *neighborhood,
+                           ccdf, cdf_estimator, marginal,
+                           sampler, progress );
+  neighborhood->track_simulated_centers( false );
+  if( status == -1 ) return false;
+
+  if( use_target_hist_ ) {
+    geostat_utils::NonParametricCdfType target_cdf( target_cdf_ );
+    cdf_transform( prop->begin(), prop->end(), marginal, target_cdf );
+  }
+  return true;
+}
+
+
+
 
 
 bool Sgsim::initialize( const Parameters_handler* parameters,
@@ -269,6 +400,9 @@ bool Sgsim::initialize( const Parameters_handler* parameters,
   
   seed_ = String_Op::to_number<int>( parameters->value( "Seed.value" ) );
 
+  nb_threads_ = 
+    utils::nb_threads_parameter( parameters->value( "Nb_Threads.value" ) );
+
 
 
 
@@ -303,46 +437,30 @@ bool Sgsim::initialize( const Parameters_handler* parameters,
                   "medium range >= minor range >= 0" );
   if( !extract_ok ) return false;
 */
-  // If the hard data are not "relocated" on the simulation grid,
-  // use a "combined neighborhood", otherwise use a single 
-  // neighborhood
-  if( !harddata_grid_ || assign_harddata ) {
-
-    neighborhood_ = SmartPtr<Neighborhood>( 
-                     simul_grid_->neighborhood( ranges, angles, &covar_ ) );
-
-  }
-  else {
-    Neighborhood* simul_neigh  = simul_grid_->neighborhood( ranges, angles, &covar_ );
-
-    simul_neigh->max_size( max_neigh );
-    harddata_grid_->select_property(harddata_property_->name());
-
-    Neighborhood* harddata_neigh;
-    if( dynamic_cast<Point_set*>(harddata_grid_) ) {
-      harddata_neigh = 
-        harddata_grid_->neighborhood( ranges, angles, &covar_, true );
-    } 
-    else {
-      harddata_neigh = 
-        harddata_grid_->neighborhood( ranges, angles, &covar_ );
+  neighborhood_ = 
+    SmartPtr<Neighborhood>( create_neighborhood( ranges, angles, max_neigh,
+                                                 assign_harddata,
+                                                 parameters, errors ) );
+
+  // the covariances between simulated nodes are read from a table. 
+  // This must be done once all the neighborhoods are created.
+  covar_.build_table( simul_grid_, ranges, angles );
+
+  // when the realizations are simulated in parallel, each thread needs 
+  // its own neighborhood
+  thread_neighborhoods_.clear();
+  if( nb_threads_ != 0 ) {
+    int nb_threads = 
+      std::min( utils::thread_count( nb_threads_ ), std::max( nb_of_realizations_, 1 ) );
+    thread_neighborhoods_.push_back( neighborhood_ );
+    for( int i = 1; i < nb_threads; i++ ) {
+      thread_neighborhoods_.push_back(
+        SmartPtr<Neighborhood>( create_neighborhood( ranges, angles, max_neigh,
+                                                     assign_harddata,
+                                                     parameters, errors ) ) );
     }
-
-
-    harddata_neigh->max_size( max_neigh );
-  //  harddata_neigh->select_property( harddata_property_->name() );
-
-    neighborhood_ =
-      SmartPtr<Neighborhood>( new Combined_neighborhood( harddata_neigh,
-							                                           simul_neigh, &covar_) );
- //     SmartPtr<Neighborhood>( new Combined_neighborhood_dedup( harddata_neigh,
-//							                                           simul_neigh, &covar_, false) );
   }
 
-  neighborhood_->max_size( max_neigh );
-  geostat_utils::set_advanced_search(neighborhood_, 
-                      "AdvancedSearch", parameters, errors);
-
 
   //-----------------
   // The kriging constraints and combiner
@@ -392,6 +510,56 @@ bool Sgsim::initialize( const Parameters_handler* parameters,
 
 
 
+Neighborhood* Sgsim::create_neighborhood( const GsTLTriplet& ranges,
+                                          const GsTLTriplet& angles,
+                                          int max_neigh, bool assign_harddata,
+                                          const Parameters_handler* parameters,
+                                          Error_messages_handler* errors ) {
+  Neighborhood* neighborhood = 0;
+
+  // If the hard data are not "relocated" on the simulation grid,
+  // use a "combined neighborhood", otherwise use a single 
+  // neighborhood
+  if( !harddata_grid_ || assign_harddata ) {
+
+    neighborhood = simul_grid_->neighborhood( ranges, angles, &covar_ );
+
+  }
+  else {
+    Neighborhood* simul_neigh  = simul_grid_->neighborhood( ranges, angles, &covar_ );
+
+    simul_neigh->max_size( max_neigh );
+    harddata_grid_->select_property(harddata_property_->name());
+
+    Neighborhood* harddata_neigh;
+    if( dynamic_cast<Point_set*>(harddata_grid_) ) {
+      harddata_neigh = 
+        harddata_grid_->neighborhood( ranges, angles, &covar_, true );
+    } 
+    else {
+      harddata_neigh = 
+        harddata_grid_->neighborhood( ranges, angles, &covar_ );
+    }
+
+
+    harddata_neigh->max_size( max_neigh );
+  //  harddata_neigh->select_property( harddata_property_->name() );
+
+    neighborhood = new Combined_neighborhood( harddata_neigh,
+							                                simul_neigh, &covar_);
+ //     SmartPtr<Neighborhood>( new Combined_neighborhood_dedup( harddata_neigh,
+//							                                           simul_neigh, &covar_, false) );
+  }
+
+  neighborhood->max_size( max_neigh );
+  geostat_utils::set_advanced_search(neighborhood, 
+                      "AdvancedSearch", parameters, errors);
+
+  return neighborhood;
+}
+
+
+
 void Sgsim::clean( GsTLGridProperty* prop ) {
   if( prop ) 
     simul_grid_->remove_property( prop->name() );
@@ -420,6 +588,7 @@ Sgsim::Sgsim() {
 
   use_target_hist_ = false;
   clear_temp_properties_ = false;
+  nb_threads_ = 0;
 }
  
 
@@ -33,6 +33,7 @@
 #include <GsTLAppli/geostat/common.h>
 #include <GsTLAppli/geostat/geostat_algo.h> 
 #include <GsTLAppli/geostat/utilities.h> 
+#include <GsTLAppli/geostat/covariance_table.h>
 #include <GsTLAppli/grid/grid_model/geostat_grid.h> 
 #include <GsTLAppli/grid/grid_model/property_copier.h> 
  
@@ -43,10 +44,13 @@
 #include <GsTL/utils/smartptr.h> 
 #include <GsTLAppli/grid/grid_model/grid_region_temp_selector.h>  
 #include <string> 
+#include <vector> 
  
 class Neighborhood; 
 class Parameters_handler; 
 class Error_messages_handler; 
+class Progress_notifier;
+class Parallel_progress;
 //class Grid_initializer; 
 
  
@@ -81,8 +85,16 @@ class GEOSTAT_DECL Sgsim : public Geostat_algo {
   
   long int seed_; 
   int nb_of_realizations_; 
- 
-  Covariance<Location> covar_; 
+
+  // If nb_threads_ is 0, the realizations are simulated one after the 
+  // other, all drawing from the global random number generator. Otherwise
+  // each realization has its own random number stream and the realizations 
+  // are simulated concurrently (a negative value means one thread per core).
+  // thread_neighborhoods_ holds one neighborhood per thread.
+  int nb_threads_;
+  std::vector< SmartPtr<Neighborhood> > thread_neighborhoods_;
+ 
+  Grid_covariance_table covar_; 
   geostat_utils::KrigingCombiner* combiner_; 
   geostat_utils::KrigingConstraints* Kconstraints_; 
  
@@ -95,7 +107,24 @@ class GEOSTAT_DECL Sgsim : public Geostat_algo {
   Temporary_gridRegion_Selector hd_grid_region_;
 
  protected: 
+  friend class Sgsim_realizations_task;
+
+  Neighborhood* create_neighborhood( const GsTLTriplet& ranges, 
+                                     const GsTLTriplet& angles,
+                                     int max_neigh, bool assign_harddata,
+                                     const Parameters_handler* parameters,
+                                     Error_messages_handler* errors );
+
+  int execute_parallel( Progress_notifier* progress_notifier );
 
+  /** Simulates realization \c nreal into \c prop, using only objects that
+  * are not shared with the other realizations, except for read-only data.
+  * The random path and the random numbers are drawn from a stream that 
+  * only depends on seed_ and \c nreal.
+  */
+  bool simulate_realization( GsTLGridProperty* prop, int nreal, 
+                             Neighborhood* neighborhood,
+                             Parallel_progress* progress );
 
   void clean( GsTLGridProperty* prop = 0 );
 }; 
@@ -138,8 +138,9 @@ int Sisim::median_ik( Progress_notifier* progress_notifier ) {
                               simul_grid_, prop );
     }
 
-    // do the simulation
+    // do the simulation. Only the nodes of the path get informed from now on
     appli_message( "Doing simulation" );
+    neighborhood_->track_simulated_centers( true );
     int status = 
       sequential_simulation( simul_grid_->random_path_begin(),
 			     simul_grid_->random_path_end(),
@@ -149,6 +150,7 @@ int Sisim::median_ik( Progress_notifier* progress_notifier ) {
 			     *marginal_,
 			     sampler, progress_notifier
 			     );
+    neighborhood_->track_simulated_centers( false );
 
     if( status == -1 ) {
       simul_grid_->remove_property( prop->name() );
@@ -576,6 +578,11 @@ bool Sisim::initialize( const Parameters_handler* parameters,
 
 
 
+  // the covariances between simulated nodes are read from tables
+  for( unsigned int i = 0; i < covar_vector_.size(); i++ )
+    covar_vector_[i].build_table( simul_grid_, ranges, angles );
+
+
   //-------------
   // Set-up the cdf estimator
 
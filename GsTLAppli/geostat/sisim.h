@@ -31,6 +31,7 @@
  
 #include <GsTLAppli/geostat/common.h>
 #include <GsTLAppli/geostat/geostat_algo.h> 
+#include <GsTLAppli/geostat/covariance_table.h>
 #include <GsTLAppli/grid/grid_model/geostat_grid.h> 
 #include <GsTLAppli/grid/grid_model/neighborhood.h> 
 #include <GsTLAppli/grid/grid_model/property_copier.h>
@@ -91,8 +92,8 @@ class GEOSTAT_DECL Sisim : public Geostat_algo {
     
   bool do_median_ik_; 
  
-  typedef std::vector< Covariance<Location> > CovarianceVector; 
-  typedef std::vector< Covariance<Location> >::const_iterator CovarianceIterator; 
+  typedef std::vector< Grid_covariance_table > CovarianceVector; 
+  typedef CovarianceVector::const_iterator CovarianceIterator; 
   CovarianceVector covar_vector_; 
  
   // For median IK   
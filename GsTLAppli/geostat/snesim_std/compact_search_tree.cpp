@@ -0,0 +1,529 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/geostat/snesim_std/compact_search_tree.h>
+
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(WIN32)
+  #ifndef NOMINMAX
+  #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+
+namespace {
+
+inline int bit_count( unsigned int w ) {
+  int n = 0;
+  for( ; w != 0; n++ ) w &= w - 1;
+  return n;
+}
+
+
+// Layout of a tree file: the header, then the arrays 
+//   large count indices  (unsigned long long x nb_large_counts)
+//   level_begin          (unsigned int x nb_levels)
+//   first_child          (unsigned int x nb_nodes)
+//   child_mask           (unsigned int x nb_nodes)
+//   large count values   (unsigned int x nb_large_counts)
+//   counts               (unsigned short x nb_nodes*nb_categories)
+// The arrays are in the byte order of the machine that wrote the file: 
+// a file written on another architecture is rejected (magic number).
+struct Tree_file_header {
+  char magic[8];
+  unsigned int byte_order;
+  unsigned int version;
+  unsigned int templ_size;
+  unsigned int nb_categories;
+  int cmin;
+  unsigned int pruned;
+  unsigned int nb_levels;
+  unsigned int nb_nodes;
+  unsigned int nb_large_counts;
+  unsigned int padding;
+};
+
+const char tree_file_magic[8] = { 'S','G','S','T','R','E','E', 0 };
+const unsigned int tree_file_byte_order = 0x01020304;
+// version 2: the memory budget includes the memory used to build the tree
+const unsigned int tree_file_version = 2;
+
+std::size_t tree_file_size( const Tree_file_header& h ) {
+  return sizeof( Tree_file_header ) 
+    + std::size_t( h.nb_large_counts ) * ( sizeof( unsigned long long ) + sizeof( unsigned int ) )
+    + std::size_t( h.nb_levels ) * sizeof( unsigned int )
+    + std::size_t( h.nb_nodes ) * 2 * sizeof( unsigned int )
+    + std::size_t( h.nb_nodes ) * h.nb_categories * sizeof( unsigned short );
+}
+
+
+// Maps a whole file in read-only mode. Returns 0 on failure.
+void* map_file( const std::string& filename, std::size_t length ) {
+#if defined(_WIN32) || defined(WIN32)
+  HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 
+                             NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+  if( file == INVALID_HANDLE_VALUE ) return 0;
+
+  HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+  CloseHandle( file );
+  if( mapping == NULL ) return 0;
+
+  void* address = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, length );
+  CloseHandle( mapping );
+  return address;
+#else
+  int fd = open( filename.c_str(), O_RDONLY );
+  if( fd < 0 ) return 0;
+
+  void* address = mmap( 0, length, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  return address == MAP_FAILED ? 0 : address;
+#endif
+}
+
+unsigned long process_id() {
+#if defined(_WIN32) || defined(WIN32)
+  return (unsigned long) GetCurrentProcessId();
+#else
+  return (unsigned long) getpid();
+#endif
+}
+
+void unmap_file( void* address, std::size_t length ) {
+#if defined(_WIN32) || defined(WIN32)
+  UnmapViewOfFile( address );
+#else
+  munmap( address, length );
+#endif
+}
+
+}
+
+
+void Compact_search_tree::Training_events::append( Training_events& other ) {
+  if( centers_.empty() ) {
+    events_.swap( other.events_ );
+    centers_.swap( other.centers_ );
+  }
+  else {
+    events_.insert( events_.end(), other.events_.begin(), other.events_.end() );
+    centers_.insert( centers_.end(), other.centers_.begin(), other.centers_.end() );
+  }
+  std::vector<unsigned char>().swap( other.events_ );
+  std::vector<unsigned char>().swap( other.centers_ );
+}
+
+
+
+Compact_search_tree::Compact_search_tree( Training_events& events, int cmin,
+                                          double memory_budget ) 
+  : templ_size_( events.templ_size_ ), 
+    nb_categories_( events.nb_categories_ ),
+    cmin_( cmin ), memory_budget_( memory_budget ), pruned_( false ),
+    nb_nodes_( 0 ), first_child_data_( 0 ), child_mask_data_( 0 ), 
+    counts_data_( 0 ), mapping_( 0 ), mapping_size_( 0 ) {
+  build( events );
+}
+
+
+Compact_search_tree::Compact_search_tree()
+  : templ_size_( 0 ), nb_categories_( 0 ), cmin_( 0 ), memory_budget_( 0 ),
+    pruned_( false ),
+    nb_nodes_( 0 ), first_child_data_( 0 ), child_mask_data_( 0 ), 
+    counts_data_( 0 ), mapping_( 0 ), mapping_size_( 0 ) {
+}
+
+
+Compact_search_tree::~Compact_search_tree() {
+  if( mapping_ ) unmap_file( mapping_, mapping_size_ );
+}
+
+
+void Compact_search_tree::build( Training_events& training_events ) {
+  const std::vector<unsigned char>& events = training_events.events_;
+  const std::vector<unsigned char>& centers = training_events.centers_;
+  const unsigned int nb_events = centers.size();
+  const unsigned int ncat = nb_categories_;
+  const double node_bytes = 
+    sizeof( unsigned int ) * 2 + sizeof( count_type ) * ncat;
+
+  // the budget also covers the memory used to build the tree: the data 
+  // events, the index of the events (current and next level) and, for 
+  // each level, the child sizes and the ranges of the events of the nodes
+  const double events_bytes = double( events.size() ) + double( centers.size() )
+    + 2.0 * sizeof( unsigned int ) * double( nb_events );
+
+  // the events of the nodes of the current level are contiguous in "index":
+  // the events of the i-th node of the level are in [range[i], range[i+1])
+  std::vector<unsigned int> index( nb_events );
+  for( unsigned int k = 0; k < nb_events; k++ ) index[k] = k;
+  std::vector<unsigned int> range( 2, 0 );
+  range[1] = nb_events;
+
+  // root node
+  std::vector<unsigned int> histogram( ncat, 0 );
+  for( unsigned int k = 0; k < nb_events; k++ ) histogram[ centers[k] ]++;
+  first_child_.push_back( 0 );
+  child_mask_.push_back( 0 );
+  counts_.resize( ncat );
+  nb_nodes_ = 1;
+  for( unsigned int c = 0; c < ncat; c++ ) set_count( 0, c, histogram[c] );
+  level_begin_.push_back( 0 );
+  level_begin_.push_back( 1 );
+
+  std::vector<unsigned int> child_sizes;
+  std::vector<unsigned int> next_index;
+  std::vector<unsigned int> next_range;
+  
+  for( int d = 0; d < templ_size_; d++ ) {
+    const unsigned int level_first = level_begin_[d];
+    const unsigned int level_nodes = level_begin_[d+1] - level_first;
+
+    // number of events of each child of each node of the level
+    child_sizes.assign( std::size_t( level_nodes ) * ncat, 0 );
+    for( unsigned int i = 0; i < level_nodes; i++ ) {
+      unsigned int* sizes = &child_sizes[ std::size_t( i ) * ncat ];
+      for( unsigned int k = range[i]; k < range[i+1]; k++ ) {
+        unsigned char cat = events[ std::size_t( index[k] ) * templ_size_ + d ];
+        if( cat != uninformed ) sizes[cat]++;
+      }
+    }
+
+    unsigned int threshold = pruned_ ? std::max( cmin_, 1 ) : 1;
+    std::size_t nb_children = 0;
+    for( std::size_t i = 0; i < child_sizes.size(); i++ )
+      if( child_sizes[i] >= threshold ) nb_children++;
+
+    const double build_bytes = memory_size() + events_bytes + 
+      sizeof( unsigned int ) * double( child_sizes.size() + range.size() );
+    const double child_bytes = node_bytes + sizeof( unsigned int );
+
+    if( memory_budget_ > 0 && 
+        build_bytes + nb_children * child_bytes > memory_budget_ ) {
+      // prune the rare branches, and truncate the tree if it is not enough
+      if( !pruned_ && cmin_ > 1 ) {
+        pruned_ = true;
+        threshold = cmin_;
+        nb_children = 0;
+        for( std::size_t i = 0; i < child_sizes.size(); i++ )
+          if( child_sizes[i] >= threshold ) nb_children++;
+      }
+      if( build_bytes + nb_children * child_bytes > memory_budget_ ) break;
+    }
+    if( nb_children == 0 ) break;
+
+    // create the children of each node, and move their events to next_index
+    const unsigned int new_first = first_child_.size();
+    first_child_.resize( new_first + nb_children, 0 );
+    child_mask_.resize( new_first + nb_children, 0 );
+    counts_.resize( std::size_t( new_first + nb_children ) * ncat, 0 );
+    nb_nodes_ = first_child_.size();
+    next_index.resize( nb_events );
+    next_range.assign( 1, 0 );
+
+    unsigned int current_child = new_first;
+    for( unsigned int i = 0; i < level_nodes; i++ ) {
+      const unsigned int node = level_first + i;
+      const unsigned int* sizes = &child_sizes[ std::size_t( i ) * ncat ];
+      first_child_[node] = current_child;
+
+      for( unsigned int c = 0; c < ncat; c++ ) {
+        if( sizes[c] < threshold ) continue;
+        child_mask_[node] |= 1u << c;
+
+        unsigned int begin = next_range.back();
+        unsigned int end = begin;
+        histogram.assign( ncat, 0 );
+        for( unsigned int k = range[i]; k < range[i+1]; k++ ) {
+          unsigned int e = index[k];
+          if( events[ std::size_t( e ) * templ_size_ + d ] != c ) continue;
+          next_index[ end++ ] = e;
+          histogram[ centers[e] ]++;
+        }
+        for( unsigned int cat = 0; cat < ncat; cat++ )
+          set_count( current_child, cat, histogram[cat] );
+
+        next_range.push_back( end );
+        current_child++;
+      }
+    }
+
+    next_index.resize( next_range.back() );
+    index.swap( next_index );
+    range.swap( next_range );
+    level_begin_.push_back( current_child );
+  }
+
+  std::vector<unsigned char>().swap( training_events.events_ );
+  std::vector<unsigned char>().swap( training_events.centers_ );
+
+  use_built_arrays();
+}
+
+
+void Compact_search_tree::use_built_arrays() {
+  nb_nodes_ = first_child_.size();
+  first_child_data_ = first_child_.empty() ? 0 : &first_child_[0];
+  child_mask_data_ = child_mask_.empty() ? 0 : &child_mask_[0];
+  counts_data_ = counts_.empty() ? 0 : &counts_[0];
+}
+
+
+void Compact_search_tree::set_count( unsigned int node, unsigned int cat,
+                                     unsigned int count ) {
+  std::size_t i = std::size_t( node )*nb_categories_ + cat;
+  if( count >= large_count ) {
+    counts_[i] = large_count;
+    large_counts_[i] = count;
+  }
+  else
+    counts_[i] = count_type( count );
+}
+
+
+unsigned int Compact_search_tree::child( unsigned int node, 
+                                         unsigned int cat ) const {
+  unsigned int mask = child_mask_data_[node];
+  return first_child_data_[node] + bit_count( mask & ( ( 1u << cat ) - 1 ) );
+}
+
+
+void Compact_search_tree::accumulate( unsigned int node, int level, 
+                                      const unsigned char* event, int depth,
+                                      unsigned int* sums ) const {
+  if( level == depth ) {
+    for( unsigned int c = 0; c < nb_categories_; c++ )
+      sums[c] += count( node, c );
+    return;
+  }
+
+  unsigned int mask = child_mask_data_[node];
+  const unsigned char cat = event[level];
+  if( cat != uninformed ) {
+    if( mask & ( 1u << cat ) ) 
+      accumulate( child( node, cat ), level+1, event, depth, sums );
+    return;
+  }
+
+  // uninformed template node: sum over all the branches
+  unsigned int child_id = first_child_data_[node];
+  for( ; mask != 0; mask &= mask - 1, child_id++ )
+    accumulate( child_id, level+1, event, depth, sums );
+}
+
+
+int Compact_search_tree::retrieve( unsigned char* event, int n, 
+                                   double* probs ) const {
+  int dropped = 0;
+  
+  // the template nodes beyond the depth of the tree can not be used
+  for( int j = depth(); j < n; j++ ) {
+    if( event[j] != uninformed ) dropped++;
+  }
+  int event_size = std::min( n, depth() );
+  
+  unsigned int sums[ max_categories ];
+  for( ;; ) {
+    while( event_size > 0 && event[ event_size-1 ] == uninformed ) 
+      event_size--;
+
+    std::fill( sums, sums + nb_categories_, 0 );
+    accumulate( 0, 0, event, event_size, sums );
+
+    unsigned int total = 0;
+    for( unsigned int c = 0; c < nb_categories_; c++ ) total += sums[c];
+
+    if( event_size == 0 || int( total ) >= cmin_ ) {
+      for( unsigned int c = 0; c < nb_categories_; c++ ) {
+        probs[c] = total == 0 ? 1.0 / double( nb_categories_ ) 
+                              : double( sums[c] ) / double( total );
+      }
+      return dropped;
+    }
+
+    // drop the farthest conditioning datum
+    event[ event_size-1 ] = uninformed;
+    dropped++;
+  }
+}
+
+
+double Compact_search_tree::memory_size() const {
+  // a map entry costs about its content plus 3 pointers and a color
+  const double map_entry = 
+    sizeof( std::size_t ) + sizeof( unsigned int ) + 4*sizeof( void* );
+  return double( nb_nodes_ ) * 2 * sizeof( unsigned int ) 
+    + double( nb_nodes_ ) * nb_categories_ * sizeof( count_type )
+    + double( large_counts_.size() ) * map_entry;
+}
+
+
+unsigned long long Compact_search_tree::hash( const void* data, 
+                                              std::size_t size,
+                                              unsigned long long h ) {
+  const unsigned char* bytes = static_cast<const unsigned char*>( data );
+  for( std::size_t i = 0; i < size; i++ ) {
+    h ^= bytes[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+
+bool Compact_search_tree::save( const std::string& filename ) const {
+  Tree_file_header header;
+  memset( &header, 0, sizeof( header ) );
+  memcpy( header.magic, tree_file_magic, sizeof( header.magic ) );
+  header.byte_order = tree_file_byte_order;
+  header.version = tree_file_version;
+  header.templ_size = templ_size_;
+  header.nb_categories = nb_categories_;
+  header.cmin = cmin_;
+  header.pruned = pruned_ ? 1 : 0;
+  header.nb_levels = level_begin_.size();
+  header.nb_nodes = nb_nodes_;
+  header.nb_large_counts = large_counts_.size();
+
+  std::vector<unsigned long long> large_ids;
+  std::vector<unsigned int> large_values;
+  for( std::map<std::size_t, unsigned int>::const_iterator it = 
+         large_counts_.begin(); it != large_counts_.end(); ++it ) {
+    large_ids.push_back( it->first );
+    large_values.push_back( it->second );
+  }
+
+  // several processes may save the same tree at the same time
+  char suffix[32];
+  sprintf( suffix, ".%lu.tmp", process_id() );
+  std::string tmp_filename = filename + suffix;
+  std::ofstream out( tmp_filename.c_str(), std::ios::out | std::ios::binary );
+  if( !out ) return false;
+
+  out.write( (const char*) &header, sizeof( header ) );
+  if( !large_ids.empty() )
+    out.write( (const char*) &large_ids[0], 
+               large_ids.size() * sizeof( unsigned long long ) );
+  out.write( (const char*) &level_begin_[0], 
+             level_begin_.size() * sizeof( unsigned int ) );
+  out.write( (const char*) first_child_data_, 
+             std::size_t( nb_nodes_ ) * sizeof( unsigned int ) );
+  out.write( (const char*) child_mask_data_, 
+             std::size_t( nb_nodes_ ) * sizeof( unsigned int ) );
+  if( !large_values.empty() )
+    out.write( (const char*) &large_values[0], 
+               large_values.size() * sizeof( unsigned int ) );
+  out.write( (const char*) counts_data_, 
+             std::size_t( nb_nodes_ ) * nb_categories_ * sizeof( count_type ) );
+  out.close();
+
+  if( !out ) {
+    remove( tmp_filename.c_str() );
+    return false;
+  }
+
+  // rename replaces the file atomically (POSIX) or fails if it exists 
+  // (Windows): if another process saved the same tree in the mean time, 
+  // its file is kept
+  if( rename( tmp_filename.c_str(), filename.c_str() ) != 0 ) {
+    remove( tmp_filename.c_str() );
+    std::ifstream existing( filename.c_str() );
+    return existing.good();
+  }
+  return true;
+}
+
+
+Compact_search_tree* Compact_search_tree::load( const std::string& filename ) {
+  Tree_file_header header;
+  std::ifstream in( filename.c_str(), std::ios::in | std::ios::binary );
+  if( !in ) return 0;
+  in.read( (char*) &header, sizeof( header ) );
+  if( !in ) return 0;
+  in.seekg( 0, std::ios::end );
+  std::streamoff file_size = in.tellg();
+  in.close();
+
+  if( memcmp( header.magic, tree_file_magic, sizeof( header.magic ) ) != 0 ||
+      header.byte_order != tree_file_byte_order ||
+      header.version != tree_file_version ||
+      header.nb_categories == 0 || header.nb_categories > max_categories ||
+      header.nb_levels < 2 || header.nb_nodes == 0 ) 
+    return 0;
+
+  // the file must be large enough: accessing a mapped page beyond the end
+  // of the file is a fatal error
+  const std::size_t length = tree_file_size( header );
+  if( file_size != static_cast<std::streamoff>( length ) ) return 0;
+
+  void* address = map_file( filename, length );
+  if( !address ) return 0;
+
+  Compact_search_tree* tree = new Compact_search_tree;
+  tree->mapping_ = address;
+  tree->mapping_size_ = length;
+  tree->templ_size_ = header.templ_size;
+  tree->nb_categories_ = header.nb_categories;
+  tree->cmin_ = header.cmin;
+  tree->pruned_ = header.pruned != 0;
+  tree->nb_nodes_ = header.nb_nodes;
+
+  const char* p = static_cast<const char*>( address ) + sizeof( header );
+  const unsigned long long* large_ids = 
+    reinterpret_cast<const unsigned long long*>( p );
+  p += std::size_t( header.nb_large_counts ) * sizeof( unsigned long long );
+
+  const unsigned int* level_begin = reinterpret_cast<const unsigned int*>( p );
+  tree->level_begin_.assign( level_begin, level_begin + header.nb_levels );
+  p += std::size_t( header.nb_levels ) * sizeof( unsigned int );
+
+  tree->first_child_data_ = reinterpret_cast<const unsigned int*>( p );
+  p += std::size_t( header.nb_nodes ) * sizeof( unsigned int );
+  tree->child_mask_data_ = reinterpret_cast<const unsigned int*>( p );
+  p += std::size_t( header.nb_nodes ) * sizeof( unsigned int );
+
+  const unsigned int* large_values = reinterpret_cast<const unsigned int*>( p );
+  for( unsigned int i = 0; i < header.nb_large_counts; i++ )
+    tree->large_counts_[ std::size_t( large_ids[i] ) ] = large_values[i];
+  p += std::size_t( header.nb_large_counts ) * sizeof( unsigned int );
+
+  tree->counts_data_ = reinterpret_cast<const count_type*>( p );
+
+  if( tree->level_begin_.back() != tree->nb_nodes_ ) {
+    delete tree;
+    return 0;
+  }
+  return tree;
+}
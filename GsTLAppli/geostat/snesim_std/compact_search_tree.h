@@ -0,0 +1,310 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "geostat" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#ifndef __GSTLAPPLI_SNESIM_STD_COMPACT_SEARCH_TREE_H__
+#define __GSTLAPPLI_SNESIM_STD_COMPACT_SEARCH_TREE_H__
+
+
+#include <GsTLAppli/geostat/common.h>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+
+
+/** Compact_search_tree is the search tree of snesim: it stores the number
+* of replicates of each data event of a template found in a training image,
+* along with the histogram of the central node category.
+* 
+* The nodes are stored level by level (breadth-first) in flat arrays: 
+* a node is an index, its children are contiguous and found from the index
+* of the first child and a bitmask of the categories that have a child. 
+* The counts are stored as unsigned shorts; the few counts that do not fit 
+* (typically the first levels of the tree) are kept in a separate map.
+* Compared to a pointer-based tree, this divides the memory by 4 to 10 and
+* a retrieval walks through contiguous memory.
+*
+* A memory budget (in bytes) can be supplied. It covers the tree and the 
+* memory used to build it: the data events of the training image (one byte
+* per template node and per event) and the index arrays (8 bytes per event).
+* When building a level would exceed the budget, the branches with less 
+* than \c cmin replicates are not created anymore (they would be dropped at
+* retrieval time anyway). If the budget is still exceeded, the tree is 
+* truncated: the template nodes beyond depth() are ignored, and counted as
+* dropped, when retrieving a ccdf.
+*
+* A tree can be saved to a binary file and loaded back: the file is 
+* memory-mapped (read-only), so that several processes using the same 
+* tree share its pages.
+*
+* The categories must be in [0, max_categories).
+*/
+class GEOSTAT_DECL Compact_search_tree {
+ public:
+  enum { max_categories = 32 };
+  enum { uninformed = 255 };
+
+  /** The data events found in (part of) a training image, one byte per 
+  * template node, and the categories of the central nodes. 
+  * Several parts of a training image can be scanned independently (by 
+  * different threads) and the results appended, in order, before the 
+  * tree is built.
+  */
+  class GEOSTAT_DECL Training_events {
+   public:
+    Training_events( int templ_size, unsigned int nb_of_categories )
+      : templ_size_( templ_size ), 
+        nb_categories_( std::min( nb_of_categories, (unsigned int) max_categories ) ) {}
+
+    template< class TiIterator, class ScanNbd >
+    void scan( TiIterator ti_begin, TiIterator ti_end, ScanNbd& nbd );
+
+    /** Moves the events of \a other at the end of this set
+    */
+    void append( Training_events& other );
+
+    unsigned int size() const { return centers_.size(); }
+
+   private:
+    friend class Compact_search_tree;
+    int templ_size_;
+    unsigned int nb_categories_;
+    std::vector<unsigned char> events_;
+    std::vector<unsigned char> centers_;
+  };
+
+ public:
+  /** Builds the tree by scanning the training image [ti_begin, ti_end) with 
+  * neighborhood \a nbd, whose geometry is the template (of size 
+  * \a templ_size). A \a memory_budget of 0 means no limit.
+  */
+  template< class TiIterator, class ScanNbd >
+  Compact_search_tree( TiIterator ti_begin, TiIterator ti_end, ScanNbd& nbd,
+                       int templ_size, unsigned int nb_of_categories, 
+                       int cmin, double memory_budget = 0 );
+
+  /** Builds the tree from data events already gathered. \a events is 
+  * emptied.
+  */
+  Compact_search_tree( Training_events& events, int cmin, 
+                       double memory_budget = 0 );
+
+  ~Compact_search_tree();
+
+  /** Loads a tree saved by save(). Returns 0 if the file does not exist
+  * or is not a valid tree file.
+  */
+  static Compact_search_tree* load( const std::string& filename );
+
+  /** Saves the tree to \a filename. The file is first written under a 
+  * temporary name then renamed, so that another process never maps a
+  * partially written file.
+  */
+  bool save( const std::string& filename ) const;
+
+  /** 64-bit FNV-1a hash of \a size bytes, starting from \a h. Used to 
+  * build the names of the cached tree files.
+  */
+  static unsigned long long hash( const void* data, std::size_t size,
+                                  unsigned long long h = 14695981039346656037ULL );
+
+  /** Computes the ccdf of \a u given its \a neighbors. The data event is 
+  * reduced (farthest conditioning data dropped first) until it has at 
+  * least \c cmin replicates. Returns the number of nodes dropped.
+  */
+  template< class Geovalue_, class Neighborhood, class NonParamCdf >
+  int operator()( const Geovalue_& u, const Neighborhood& neighbors,
+                  NonParamCdf& ccdf ) const;
+
+  /** Same as above, the data event is given as an array of \a n categories,
+  * \c uninformed for the nodes with no data. \a probs is filled with the 
+  * nb_categories() probabilities. The data event is modified.
+  */
+  int retrieve( unsigned char* event, int n, double* probs ) const;
+
+  /** Number of nodes in the tree
+  */
+  unsigned int size() const { return nb_nodes_; }
+
+  /** Number of template nodes actually used by the tree
+  */
+  int depth() const { return int( level_begin_.size() ) - 2; }
+  int template_size() const { return templ_size_; }
+  unsigned int nb_categories() const { return nb_categories_; }
+
+  /** Approximate memory used by the tree, in bytes
+  */
+  double memory_size() const;
+
+  /** True if some low-frequency branches were pruned to fit in the budget
+  */
+  bool is_pruned() const { return pruned_; }
+
+  /** True if the tree was loaded from a (memory-mapped) file
+  */
+  bool is_mapped() const { return mapping_ != 0; }
+
+
+ private:
+  typedef unsigned short count_type;
+  enum { large_count = 65535 };
+  enum { max_stack_event = 1024 };
+
+  Compact_search_tree();
+  void build( Training_events& training_events );
+  void use_built_arrays();
+  void set_count( unsigned int node, unsigned int cat, unsigned int count );
+  unsigned int count( unsigned int node, unsigned int cat ) const {
+    std::size_t i = std::size_t( node )*nb_categories_ + cat;
+    return counts_data_[i] == large_count ? large_counts_.find( i )->second 
+                                          : counts_data_[i];
+  }
+  unsigned int child( unsigned int node, unsigned int cat ) const;
+  void accumulate( unsigned int node, int level, const unsigned char* event,
+                   int depth, unsigned int* sums ) const;
+  
+  // build a tree only once
+  Compact_search_tree( const Compact_search_tree& );
+  Compact_search_tree& operator = ( const Compact_search_tree& );
+
+
+ private:
+  int templ_size_;
+  unsigned int nb_categories_;
+  int cmin_;
+  double memory_budget_;
+  bool pruned_;
+
+  // node i has its children at first_child_[i], first_child_[i]+1, ...
+  // one for each bit set in child_mask_[i]. The vectors are only used
+  // while building the tree: the tree is read through the *_data_ 
+  // pointers, which point either to the vectors or to the mapped file.
+  std::vector<unsigned int> first_child_;
+  std::vector<unsigned int> child_mask_;
+  std::vector<count_type> counts_;
+  std::map<std::size_t, unsigned int> large_counts_;
+
+  unsigned int nb_nodes_;
+  const unsigned int* first_child_data_;
+  const unsigned int* child_mask_data_;
+  const count_type* counts_data_;
+
+  void* mapping_;
+  std::size_t mapping_size_;
+
+  // index of the first node of each level (the root is level 0), plus the
+  // total number of nodes
+  std::vector<unsigned int> level_begin_;
+};
+
+
+
+//=================================================
+//   Definition of template functions
+
+template< class TiIterator, class ScanNbd >
+void Compact_search_tree::Training_events::
+scan( TiIterator ti_begin, TiIterator ti_end, ScanNbd& nbd ) {
+  for( TiIterator it = ti_begin; it != ti_end; ++it ) {
+    if( !it->is_informed() ) continue;
+    int center = int( it->property_value() );
+    if( center < 0 || center >= int( nb_categories_ ) ) continue;
+
+    nbd.find_neighbors( *it );
+    centers_.push_back( (unsigned char) center );
+    events_.insert( events_.end(), templ_size_, (unsigned char) uninformed );
+
+    unsigned char* event = &events_[ events_.size() - templ_size_ ];
+    int j = 0;
+    for( typename ScanNbd::const_iterator nb = nbd.begin(); 
+         nb != nbd.end() && j < templ_size_ ; ++nb, ++j ) {
+      if( !nb->is_informed() ) continue;
+      int cat = int( nb->property_value() );
+      if( cat >= 0 && cat < int( nb_categories_ ) ) 
+        event[j] = (unsigned char) cat;
+    }
+  }
+}
+
+
+template< class TiIterator, class ScanNbd >
+Compact_search_tree::
+Compact_search_tree( TiIterator ti_begin, TiIterator ti_end, ScanNbd& nbd,
+                     int templ_size, unsigned int nb_of_categories, 
+                     int cmin, double memory_budget ) 
+  : templ_size_( templ_size ), 
+    nb_categories_( std::min( nb_of_categories, (unsigned int) max_categories ) ),
+    cmin_( cmin ), memory_budget_( memory_budget ), pruned_( false ),
+    nb_nodes_( 0 ), first_child_data_( 0 ), child_mask_data_( 0 ), 
+    counts_data_( 0 ), mapping_( 0 ), mapping_size_( 0 ) {
+
+  // gather all the data events of the training image. The events are 
+  // released once the tree is built.
+  Training_events events( templ_size, nb_of_categories );
+  events.scan( ti_begin, ti_end, nbd );
+  build( events );
+}
+
+
+template< class Geovalue_, class Neighborhood, class NonParamCdf >
+int Compact_search_tree::operator()( const Geovalue_&, 
+                                     const Neighborhood& neighbors,
+                                     NonParamCdf& ccdf ) const {
+  // the tree is shared by the threads simulating the realizations: the
+  // data event is built on the stack unless the template is very large
+  unsigned char stack_event[ max_stack_event ];
+  std::vector<unsigned char> heap_event;
+  unsigned char* event = stack_event;
+  if( templ_size_ > max_stack_event ) {
+    heap_event.resize( templ_size_ );
+    event = &heap_event[0];
+  }
+  std::fill( event, event + templ_size_, (unsigned char) uninformed );
+
+  int j = 0;
+  for( typename Neighborhood::const_iterator nb = neighbors.begin();
+       nb != neighbors.end() && j < templ_size_ ; ++nb, ++j ) {
+    if( !nb->is_informed() ) continue;
+    int cat = int( nb->property_value() );
+    if( cat >= 0 && cat < int( nb_categories_ ) ) 
+      event[j] = (unsigned char) cat;
+  }
+
+  double probs[ max_categories ];
+  int dropped = retrieve( event, j, probs );
+
+  typename NonParamCdf::p_iterator p = ccdf.p_begin();
+  for( unsigned int c = 0; c < nb_categories_ && p != ccdf.p_end(); ++c, ++p )
+    *p = probs[c];
+
+  return dropped;
+}
+
+
+#endif
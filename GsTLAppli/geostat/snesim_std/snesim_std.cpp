@@ -41,6 +41,7 @@
 #include <GsTLAppli/utils/gstl_plugins.h>
 #include <GsTLAppli/utils/gstl_messages.h>
 #include <GsTLAppli/utils/progress_notifier.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
 #include <GsTLAppli/utils/string_manipulation.h>
 #include <GsTLAppli/utils/error_messages_handler.h>
 #include <GsTLAppli/geostat/filtersim_std/is_categorical.h>
@@ -60,6 +61,7 @@
 #include <vector>
 #include <set>
 #include <iomanip>
+#include <memory>
 
 #include "snesim_std.h"
 #include "tree_list.h"
@@ -71,8 +73,6 @@
 
 using namespace std;
 
-typedef Tree_list<std::pair<Colocated_value*, Colocated_value*> > TreeList;
-
 float Property_map::operator() ( const Geovalue& g ) const 
 {
 	int id = g.node_id();
@@ -81,6 +81,55 @@ float Property_map::operator() ( const Geovalue& g ) const
 }
 
 
+typedef Servo_system_sampler< Random_number_stream > StreamServoSystem;
+
+/* State of one of the realizations simulated concurrently: each has its own
+ * property, servo-system, random path and random number streams, so that
+ * the result does not depend on the number of threads.
+ */
+struct Snesim_realization 
+{
+    Snesim_realization( GsTLGridProperty* p, long int seed, int nreal, 
+                        const CdfType& cdf )
+        : prop( p ), sampler( 0 ), neighbors( 0 ), 
+          path_gen( seed, 2*nreal+1 ), ccdf( cdf ) {}
+    ~Snesim_realization() { delete sampler; delete neighbors; }
+
+    GsTLGridProperty* prop;
+    StreamServoSystem* sampler;
+    Window_neighborhood* neighbors;
+    Random_number_stream path_gen;
+    std::vector<int> path;
+    CdfType ccdf;
+};
+
+
+/* Each job of the task simulates one sub-grid of one realization. All the 
+ * jobs share the same (read-only) search trees.
+ */
+class Snesim_realizations_task : public Parallel_task 
+{
+public:
+    Snesim_realizations_task( Snesim_Std* snesim, 
+                              const std::vector<Snesim_realization*>& reals,
+                              TreeList& mptree, Parallel_progress* progress )
+        : snesim_( snesim ), reals_( reals ), mptree_( mptree ), 
+          progress_( progress ) {}
+
+    virtual bool run( int nreal, int ) 
+    {
+        return snesim_->simulate_realization_subgrid( *reals_[nreal], mptree_, 
+                                                      progress_ );
+    }
+
+private:
+    Snesim_Std* snesim_;
+    const std::vector<Snesim_realization*>& reals_;
+    TreeList& mptree_;
+    Parallel_progress* progress_;
+};
+
+
 //-----------------------------------------------------
 //-----------------------------------------------------
 
@@ -97,6 +146,8 @@ Snesim_Std::Snesim_Std()
 	constraint_to_target_cdf_ = 0.5;
 	seed_ = 21111975;
 	nb_multigrids_ = 3;
+	tree_memory_budget_ = 0;
+	nb_threads_ = 0;
 
   revisitNodesProp_ = 0.0;
   revisit_criterion_ = -1;
@@ -190,6 +241,21 @@ bool Snesim_Std::initialize( const Parameters_handler* parameters,
 	int input_nb_multigrids = String_Op::to_number<int>( 
 						parameters->value( "Nb_Multigrids_ADVANCED.value" ) );
 
+	// memory budget of a search tree, input in MB. Not present in the
+	// parameter files of older versions: no limit
+	tree_memory_budget_ = 1048576.0 * String_Op::to_number<double>( 
+						parameters->value( "Tree_Memory_Budget.value" ) );
+	error_mesgs->report( tree_memory_budget_ < 0, 
+			    "Tree_Memory_Budget", "The memory budget cannot be negative" );
+	error_mesgs->report( nb_facies_ > int( Compact_search_tree::max_categories ),
+			    "Nb_Facies", "The search tree can not handle that many facies" );
+
+	nb_threads_ = 
+	  utils::nb_threads_parameter( parameters->value( "Nb_Threads.value" ) );
+
+	// the search trees are saved to / loaded from this directory
+	tree_cache_dir_ = parameters->value( "Tree_Cache_Directory.value" );
+
     // no subgrid is allowed for only 1 grid simulation
     //if ( input_nb_multigrids==1 )   subgrid_choice_ = 0;
 
@@ -278,6 +344,24 @@ int Snesim_Std::execute( GsTL_project* proj )
         training_image_->cursor()->set_anistropic_expansion( expansion_factor_ );
     }
 
+    // the search trees of all the realizations are the same: if they are
+    // saved, they are only built for the first realization
+    tree_cache_prefix_ = make_tree_cache_prefix();
+
+    if( can_run_in_parallel() ) 
+    {
+        int status = execute_parallel( progress_notifier.raw_ptr() );
+        if( status != -1 ) 
+        {
+            if ( iso_expansion_==0 )   
+            {
+                simul_grid_->cursor()->set_istropic_expansion();
+                training_image_->cursor()->set_istropic_expansion();
+            }
+            return status;
+        }
+    }
+
     bool not_success;
 
     // loop on all realizations
@@ -360,6 +444,300 @@ int Snesim_Std::execute( GsTL_project* proj )
 }
 
 
+/*
+ * Builds the search trees of multiple grid ncoarse and sub-grid sg_no, 
+ * one for each rotation / affinity category. 
+ */
+TreeList* Snesim_Std::build_search_trees( int ncoarse, int sg_no, 
+                                          std::pair<Colocated_value*,Colocated_value*>* coloc_pair )
+{
+    // first initial grids do normal snesim.
+    training_image_->select_property( training_property_name_ );
+
+    // setting training image to finest grid level
+    training_image_->set_level(1);	    	    
+
+    Grid_template* mg_template = multgrid_template(window_geom_sg_[sg_no]);
+    Window_neighborhood* training_nbd =
+        training_image_->window_neighborhood(*mg_template);
+
+    cout << "template size = " << int(mg_template->size()) << endl;
+    training_nbd->select_property( training_property_name_);
+
+    // the training image is scanned by several threads, each
+    // with its own neighborhood.
+    std::vector<Window_neighborhood*> scan_nbds;
+    if( nb_threads_ != 0 && 
+        training_image_->property( training_property_name_ )->can_be_shared() ) {
+        int nb_threads = utils::thread_count( nb_threads_ );
+        for( int t = 1; t < nb_threads; t++ ) {
+            Window_neighborhood* scan_nbd = 
+                training_image_->window_neighborhood(*mg_template);
+            scan_nbd->select_property( training_property_name_ );
+            scan_nbds.push_back( scan_nbd );
+        }
+    }
+
+    TreeList* mptree = new TreeList( training_image_->begin(), training_image_->end(),
+        training_nbd,
+        mg_template->begin(), mg_template->end(),
+        coloc_pair, angles_,
+        aff_[0],aff_[1],aff_[2],
+        ncoarse, nb_facies_, 
+        mg_template->size(), cmin_,
+        expansion_factor_, tree_memory_budget_, &scan_nbds,
+        tree_cache_prefix_ );
+
+    for( unsigned int t = 0; t < scan_nbds.size(); t++ )
+        delete scan_nbds[t];
+
+    return mptree;
+}
+
+
+/*
+ * The realizations can be simulated concurrently if there are several of
+ * them and if none of the options that work on one realization at a time
+ * is used.
+ */
+bool Snesim_Std::can_run_in_parallel() const
+{
+    if( nb_threads_ == 0 || nb_reals_ < 2 ) return false;
+
+    // the vertical servo-system updates its proportions level by level, and 
+    // the intermediate / node-drop properties are written for the current
+    // realization only
+    if( use_vertical_ || is_view_intermediate_ || is_view_node_drop_ ) 
+    {
+        GsTLlog << "Snesim: the vertical proportions and the debugging properties "
+                << "require to simulate the realizations one at a time" << gstlIO::end;
+        return false;
+    }
+
+    bool shared = true;
+    if( use_soft_cube_ ) 
+    {
+        for( unsigned int i = 0; i < probfield_properties_.size(); i++ )
+            shared = shared && probfield_properties_[i].property()->can_be_shared();
+    }
+    if( local_rot_ == 1 ) shared = shared && rot_property_->can_be_shared();
+    if( local_aff_ == 1 ) shared = shared && aff_property_->can_be_shared();
+
+    if( !shared ) 
+    {
+        GsTLlog << "Snesim: some of the properties are swapped to disk, "
+                << "the realizations are simulated one at a time" << gstlIO::end;
+    }
+    return shared;
+}
+
+
+/*
+ * Simulates all the realizations concurrently. The multiple grid level is
+ * a state of the simulation grid: the realizations go through the coarse 
+ * grids and sub-grids together, and the search trees of each step are 
+ * built once and shared by all the realizations.
+ * Returns -1 if the realizations can not be shared by several threads: 
+ * they must then be simulated one at a time.
+ */
+int Snesim_Std::execute_parallel( Progress_notifier* progress_notifier )
+{
+    // Create all the realizations beforehand: the grid's list of properties
+    // must not change while the threads run.
+    std::vector<Snesim_realization*> reals;
+    bool shared = true;
+    for( int nreal = 0; nreal < nb_reals_; nreal++ ) 
+    {
+        GsTLGridProperty* prop = multireal_property_->new_categorical_realization();
+        reals.push_back( new Snesim_realization( prop, seed_, nreal, ccdf_ ) );
+        shared = shared && prop->can_be_shared();
+    }
+
+    if( !shared ) 
+    {
+        GsTLlog << "Snesim: some of the realizations are swapped to disk, "
+                << "they are simulated one at a time" << gstlIO::end;
+        for( int nreal = 0; nreal < nb_reals_; nreal++ ) 
+        {
+            simul_grid_->remove_property( reals[nreal]->prop->name() );
+            delete reals[nreal];
+        }
+        return -1;
+    }
+
+    for( int nreal = 0; nreal < nb_reals_; nreal++ ) 
+    {
+        Snesim_realization* real = reals[nreal];
+        simul_grid_->select_property( real->prop->name() );
+        simul_grid_->set_level(1);	
+
+        // the servo-system accounts for the hard data
+        if( property_copier_ ) 
+            property_copier_->copy( harddata_grid_, harddata_property_, simul_grid_, real->prop );
+
+        real->sampler = new StreamServoSystem( marginal_, double(constraint_to_target_cdf_),
+            simul_grid_->begin(), simul_grid_->end(),
+            Random_number_stream( seed_, 2*nreal ) );
+
+        if( property_copier_ ) 
+            property_copier_->undo_copy();
+
+        if ( pre_simulated_property_ != NULL )
+            copy_pre_simulation_data();
+    }
+
+    const int nb_threads = 
+        std::min( utils::thread_count( nb_threads_ ), nb_reals_ );
+    progress_notifier->message() << "simulating " << nb_reals_
+                                 << " realizations on " << nb_threads 
+                                 << " threads" << gstlIO::end;
+    appli_message( "simulating " << nb_reals_ << " realizations on " 
+                   << nb_threads << " threads" );
+
+    Parallel_progress progress( progress_notifier );
+    bool ok = true;
+
+    // loop on all coarse grids
+    for( int ncoarse = nb_multigrids_ ; ok && ncoarse >=1 ; ncoarse-- ) 
+    {
+        appli_message("working on coarse grid " << ncoarse );
+        simul_grid_->set_level( ncoarse );
+
+        for( int nreal = 0; nreal < nb_reals_; nreal++ ) 
+        {
+            simul_grid_->select_property( reals[nreal]->prop->name() );
+            if( property_copier_ ) 
+                property_copier_->copy( harddata_grid_, harddata_property_, 
+                                        simul_grid_, reals[nreal]->prop );
+        }
+
+        // the sub-grids are the same for all the realizations, only the 
+        // order of their nodes differs
+        init_random_path(nb_multigrids_ - ncoarse);
+
+        for( int sg_no = 0; ok && sg_no <= NUM_SG; sg_no++ )
+        {
+            if( !get_simulation_choice(sg_no, ncoarse) ) continue;
+            if ( grid_paths_[sg_no].size()==0 )    continue;
+
+            appli_message("working on subgrid number: " << sg_no);
+
+            Colocated_value* coloc_rot = NULL;
+            if(local_rot_ ==1)  
+                coloc_rot = new Colocated_value( rot_property_ );
+
+            Colocated_value* coloc_aff = NULL;
+            if(local_aff_ ==1)
+                coloc_aff = new Colocated_value( aff_property_ );				
+
+            // rotation + affinity colocated function pair    
+            std::pair<Colocated_value*,Colocated_value*> coloc_pair(coloc_rot,coloc_aff);
+
+            std::auto_ptr<TreeList> mptree( 
+                build_search_trees( ncoarse, sg_no, &coloc_pair ) );
+
+            simul_grid_->set_level( ncoarse );
+
+            for( int nreal = 0; nreal < nb_reals_; nreal++ ) 
+            {
+                Snesim_realization* real = reals[nreal];
+
+                // the random path: shuffle the nodes of the sub-grid (Fisher-Yates) 
+                real->path = grid_paths_[sg_no];
+                for( int i = int( real->path.size() ) - 1; i > 0; i-- ) 
+                    std::swap( real->path[i], real->path[ real->path_gen( i+1 ) ] );
+
+                simul_grid_->select_property( real->prop->name() );
+                delete real->neighbors;
+                real->neighbors = simul_grid_->window_neighborhood( *window_geom_sg_[sg_no] );
+                real->neighbors->select_property( real->prop->name() );
+            }
+
+            Snesim_realizations_task task( this, reals, *mptree, &progress );
+            ok = utils::run_parallel( task, nb_reals_, nb_threads, &progress );
+
+            delete coloc_rot;
+            delete coloc_aff;
+        }
+    }
+
+    for( int nreal = 0; nreal < nb_reals_; nreal++ ) 
+    {
+        // the execution was aborted: none of the realizations is complete
+        if( !ok ) 
+        {
+            appli_warning( "deleting property " << reals[nreal]->prop->name() );
+            simul_grid_->remove_property( reals[nreal]->prop->name() );
+        }
+        delete reals[nreal];
+    }
+
+    appli_message("finished simulating all realizations " << std::endl );
+    return ok ? 0 : 1;
+}
+
+
+/*
+ * Simulates the current sub-grid of one of the realizations simulated
+ * concurrently, using its own random path and random number streams.
+ */
+bool Snesim_Std::simulate_realization_subgrid( Snesim_realization& real, 
+                                               TreeList& mptree,
+                                               Parallel_progress* progress )
+{
+    const int path_size = int( real.path.size() );
+    RGrid::random_path_iterator  
+        path_begin( simul_grid_, real.prop, 0, path_size, TabularMapIndex(&real.path) );
+    RGrid::random_path_iterator  
+        path_end( simul_grid_, real.prop, path_size, path_size, TabularMapIndex(&real.path) );
+
+    NodeDropped dropped_nodes( real.path, revisit_criterion_ );
+    vector<int> grid_path_new;
+
+    typedef Tau_updating<CdfType, Property_map> TauUpdater;
+    TauUpdater cdf_updater( probfield_properties_.begin(),
+        probfield_properties_.end(), marginal_, tau1_, tau2_ );
+    Updater_sampler<TauUpdater,StreamServoSystem> updater_sampler( cdf_updater, *real.sampler );
+
+    int status;
+    if( use_soft_cube_ )
+        status = sequential_simulation( path_begin, path_end,
+            *real.neighbors, real.ccdf, mptree, marginal_, 
+            updater_sampler, progress, dropped_nodes );	
+    else
+        status = sequential_simulation( path_begin, path_end,
+            *real.neighbors, real.ccdf, mptree, marginal_, 
+            *real.sampler, progress, dropped_nodes );	
+    if( status == -1 ) return false;
+
+    for (int iter=0; iter<revisit_iter_nb_; iter++)
+    {
+        dropped_nodes.GetRevisitNodes( grid_path_new );
+        if ( grid_path_new.size()==0 ) continue;
+
+        real.sampler->removeSimulatedNode( simul_grid_, real.prop, grid_path_new );
+        dropped_nodes.ResetPath( grid_path_new );
+
+        const int new_size = int( grid_path_new.size() );
+        RGrid::random_path_iterator  
+            path_begin2( simul_grid_, real.prop, 0, new_size, TabularMapIndex(&grid_path_new) );
+        RGrid::random_path_iterator  
+            path_end2( simul_grid_, real.prop, new_size, new_size, TabularMapIndex(&grid_path_new) );
+
+        if( use_soft_cube_ )
+            status = sequential_simulation( path_begin2, path_end2,
+                *real.neighbors, real.ccdf, mptree, marginal_, 
+                updater_sampler, progress, dropped_nodes );	
+        else
+            status = sequential_simulation( path_begin2, path_end2,
+                *real.neighbors, real.ccdf, mptree, marginal_, 
+                *real.sampler, progress, dropped_nodes );	
+        if( status == -1 ) return false;
+    }
+    return true;
+}
+
+
 void Snesim_Std::clean( GsTLGridProperty* prop ) 
 {
 	if( prop ) 
@@ -1586,6 +1964,41 @@ bool Snesim_Std::get_training_image( const Parameters_handler* parameters,
 		return false;
 }
 
+/*
+ * Returns the prefix of the names of the search tree files, in directory
+ * tree_cache_dir_. The prefix is a hash of the training image (the values
+ * of the nodes in the training region, and the dimensions of the grid) and 
+ * of the number of multiple grids: the trees of two runs are shared if
+ * they use the same training image, the other parameters of the trees 
+ * are accounted for by Tree_list.
+ */
+std::string Snesim_Std::make_tree_cache_prefix()
+{
+    if ( tree_cache_dir_.empty() )  return "";
+
+    training_image_->select_property( training_property_name_ );
+    training_image_->set_level(1);
+
+    int dims[4] = { training_image_->nx(), training_image_->ny(), 
+                    training_image_->nz(), nb_multigrids_ };
+    unsigned long long key = Compact_search_tree::hash( dims, sizeof(dims) );
+
+    for ( RGrid::iterator it = training_image_->begin(); it != training_image_->end(); ++it )
+    {
+        int id = it->node_id();
+        float value = it->is_informed() ? it->property_value() 
+                                        : GsTLGridProperty::no_data_value;
+        key = Compact_search_tree::hash( &id, sizeof(int), key );
+        key = Compact_search_tree::hash( &value, sizeof(float), key );
+    }
+
+    char key_str[32];
+    sprintf( key_str, "%08x%08x", 
+             (unsigned int)(key >> 32), (unsigned int)(key & 0xffffffff) );
+    return tree_cache_dir_ + "/snesim_" + key_str;
+}
+
+
 bool Snesim_Std::get_marginal_cdf( const Parameters_handler* parameters,
                                   Error_messages_handler* error_mesgs )
 {
@@ -2102,30 +2515,10 @@ bool Snesim_Std::simulate_one_realization( SmartPtr<Progress_notifier>& progress
                 // rotation + affinity colocated function pair    
                 std::pair<Colocated_value*,Colocated_value*> coloc_pair(coloc_rot,coloc_aff);
 
-                // first initial grids do normal snesim.
-                training_image_->select_property( training_property_name_ );
-
-                // setting training image to finest grid level
-                training_image_->set_level(1);	    	    
-
-                Grid_template* mg_template = multgrid_template(window_geom_sg_[sg_no]);
-                Window_neighborhood* training_nbd =
-                    //SmartPtr<Neighborhood> training_nbd =
-                    training_image_->window_neighborhood(*mg_template);
-
-                cout << "template size = " << int(mg_template->size()) << endl;
-                training_nbd->select_property( training_property_name_);
-
                 progress_notifier->notify();
-                //typedef Tree_list<std::pair<Colocated_value*, Colocated_value*> > TreeList;
-                TreeList mptree( training_image_->begin(), training_image_->end(),
-                    training_nbd,
-                    mg_template->begin(), mg_template->end(),
-                    &coloc_pair, angles_,
-                    aff_[0],aff_[1],aff_[2],
-                    ncoarse, nb_facies_, 
-                    mg_template->size(), cmin_,
-                    expansion_factor_ );
+                std::auto_ptr<TreeList> mptree_holder( 
+                    build_search_trees( ncoarse, sg_no, &coloc_pair ) );
+                TreeList& mptree = *mptree_holder;
 
                 //if ( iso_expansion_==0 )  
                 //    mptree.set_anisotropic_expansion_factor( expansion_factor_[ncoarse-1] );
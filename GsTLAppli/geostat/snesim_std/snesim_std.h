@@ -47,6 +47,7 @@
 #include <string>
 #include <GsTLAppli/grid/grid_model/grid_region_temp_selector.h> 
 #include "layer_servo_system_sampler.h"
+#include "tree_list.h"
 
 using namespace std;
 
@@ -58,6 +59,8 @@ class RGrid;
 class Geostat_grid;
 class Colocated_neighborhood;
 class ComputeLayerIndex;
+class Parallel_progress;
+struct Snesim_realization;
 
 typedef Categ_non_param_cdf<int> CdfType;
 typedef Servo_system_sampler< Random_number_generator > ServoSystem;
@@ -72,7 +75,7 @@ public:
 public:
 	Property_map( const GsTLGridProperty* prop ) : prop_(prop) {}
 	value_type operator() ( const key_type& g ) const;
-	const GsTLGridProperty* property() { return prop_; }
+	const GsTLGridProperty* property() const { return prop_; }
 	
 private:
 	const GsTLGridProperty* prop_;
@@ -139,12 +142,17 @@ private:
 };
 
 
+typedef Tree_list<std::pair<Colocated_value*, Colocated_value*> > TreeList;
+
+
 //=================================
 /** Snesim specialized for RGrid's.
 */
 
 class GEOSTAT_DECL Snesim_Std : public Geostat_algo 
 {
+    friend class Snesim_realizations_task;
+
 public:
 	static Named_interface* create_new_interface( std::string& );
 	
@@ -159,6 +167,12 @@ public:
 private:
     // for execute() function;
     bool simulate_one_realization( SmartPtr<Progress_notifier>& progress_notifier, GsTLGridProperty* prop, int nreal );
+    int execute_parallel( Progress_notifier* progress_notifier );
+    bool can_run_in_parallel() const;
+    bool simulate_realization_subgrid( Snesim_realization& real, TreeList& mptree,
+                                       Parallel_progress* progress );
+    TreeList* build_search_trees( int ncoarse, int sg_no, 
+                                  std::pair<Colocated_value*,Colocated_value*>* coloc_pair );
     bool get_simulation_choice(int sg_no, int ncoarse);
 	void init_random_path(int level);
     void init_random_path_normal(int level);
@@ -198,6 +212,7 @@ private:
 	void check_vertical_prop( const Parameters_handler* parameters, Error_messages_handler* errors );
     void check_prob_consistency( const Parameters_handler* parameters, Error_messages_handler* error_mesgs );
 	void print_parameters();
+	std::string make_tree_cache_prefix();
 	
 private:
    // general parameters
@@ -207,6 +222,10 @@ private:
 	int max_prevcond_;      // # of conditioning data
 	int cmin_;
 	int nb_multigrids_;
+	double tree_memory_budget_;    // max memory to build a search tree, in bytes (0: no limit)
+	int nb_threads_;               // threads scanning the training image (0: off)
+	std::string tree_cache_dir_;   // directory of the saved search trees (empty: off)
+	std::string tree_cache_prefix_;
 
     // on simulation grid
     std::string simul_grid_name_;
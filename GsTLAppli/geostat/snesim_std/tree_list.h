@@ -33,25 +33,74 @@
 #define __GSTLAPPLI_Snesim_Std_TREE_LIST_H__
 
 #include <GsTLAppli/geostat/common.h>
+#include <GsTLAppli/geostat/snesim_std/compact_search_tree.h>
 #include <GsTL/cdf/categ_non_param_cdf.h>
-#include <GsTL/cdf_estimator/search_tree.h>
-#include <GsTL/cdf_estimator/standard_allocator.h>
 
 #include <GsTLAppli/geostat/geostat_algo.h>
 #include <GsTLAppli/utils/gstl_types.h>
+#include <GsTLAppli/utils/clock.h>
+#include <GsTLAppli/utils/parallel_tasks.h>
 
 #include <vector>
 #include <string>
+#include <stdio.h>
+
+
+/** Ti_scan_task gathers the data events of a training image, split in 
+* slabs: job i scans the nodes [bounds[i], bounds[i+1]) with the 
+* neighborhood of the thread running it. The events of the slabs are 
+* appended in order, so the tree is the same whatever the number of threads.
+*/
+template< class TiIterator, class ScanNbd >
+class Ti_scan_task : public Parallel_task {
+ public:
+  Ti_scan_task( const std::vector<TiIterator>& bounds, 
+                const std::vector<ScanNbd*>& nbds,
+                int templ_size, unsigned int nb_of_categories )
+    : bounds_( bounds ), nbds_( nbds ),
+      slabs_( bounds.size() - 1, 
+              Compact_search_tree::Training_events( templ_size, nb_of_categories ) ) {}
+
+  int jobs_count() const { return int( slabs_.size() ); }
+
+  virtual bool run( int index, int thread_id ) {
+    slabs_[index].scan( bounds_[index], bounds_[index+1], *nbds_[thread_id] );
+    return true;
+  }
+
+  /** Moves the events of all the slabs into \a events
+  */
+  void merge( Compact_search_tree::Training_events& events ) {
+    for( unsigned int i = 0; i < slabs_.size(); i++ )
+      events.append( slabs_[i] );
+  }
+
+ private:
+  const std::vector<TiIterator>& bounds_;
+  const std::vector<ScanNbd*>& nbds_;
+  std::vector<Compact_search_tree::Training_events> slabs_;
+};
+
 
 
 //=================================
 /** Specialization for RGrid's.
+* One search tree is built for each rotation / affinity category.
+* \c memory_budget is the maximum memory, in bytes, used to build each 
+* search tree, including the data events of the training image (0 means no
+* limit). See Compact_search_tree.
+* If \c thread_nbds is not empty, the training image is scanned by 
+* 1 + thread_nbds->size() threads: \c nbd and the neighborhoods of 
+* \c thread_nbds must be distinct objects, working on the same training
+* image.
+* If \c cache_prefix is not empty, the trees are saved to (and if possible
+* loaded from) files named \c cache_prefix_<key>.tree, where the key is a 
+* hash of the template geometry (after rotation, affinity and multigrid
+* expansion) and of the tree parameters. \c cache_prefix must identify the
+* training image.
 */
 
-template< 
-class UnaryFunction, 
-class T=int, 
-class allocator=pool_allocator<int>  >
+template< class UnaryFunction >
 class GEOSTAT_DECL Tree_list 
 {
 	//  typedef typename UnaryFunction::argument_type location;
@@ -72,7 +121,10 @@ class GEOSTAT_DECL Tree_list
 		 unsigned int nb_of_categories, 
 		 int templ_size,
 		 int cmin,
-         std::vector< std::vector<int> >& expansion_factor ) 
+         std::vector< std::vector<int> >& expansion_factor,
+		 double memory_budget = 0,
+		 const std::vector<ScanNbd*>* thread_nbds = 0,
+		 const std::string& cache_prefix = "" ) 
 	 {
 		 st_loc_ = st_loc;
 		 num_rot_ = int(angles.size());
@@ -84,6 +136,26 @@ class GEOSTAT_DECL Tree_list
              set_anisotropic_expansion_factor( expansion_factor[ncoarse-1] );
          else
              set_isotropic_expansion_factor( ncoarse );
+
+		 // neighborhoods used to scan the training image, one per thread
+		 std::vector<ScanNbd*> nbds( 1, nbd );
+		 if( thread_nbds )
+			 nbds.insert( nbds.end(), thread_nbds->begin(), thread_nbds->end() );
+
+		 // split the training image in slabs, a few per thread so that 
+		 // the threads finish at about the same time
+		 std::vector<TiIterator> bounds;
+		 if( nbds.size() > 1 ) {
+			 int ti_size = 0;
+			 for( TiIterator it = ti_begin; it != ti_end; ++it ) ti_size++;
+			 int nb_slabs = std::min( 4 * int( nbds.size() ), std::max( ti_size, 1 ) );
+			 int slab_size = ( ti_size + nb_slabs - 1 ) / nb_slabs;
+			 int count = 0;
+			 for( TiIterator it = ti_begin; it != ti_end; ++it, ++count ) {
+				 if( count % slab_size == 0 ) bounds.push_back( it );
+			 }
+			 bounds.push_back( ti_end );
+		 }
 		 
 		 for(int ir =0;ir<num_rot_;ir++)
 		 {
@@ -91,17 +163,60 @@ class GEOSTAT_DECL Tree_list
 			 {
 				 // creating search nbd for the current multiple grid and rotation category
 				 multgrid_template(ncoarse,geom_begin,geom_end,angles[ir],affx[ia],affy[ia],affz[ia]);
-				 nbd->set_geometry(geom_begin,geom_end);
+				 for( unsigned int t = 0; t < nbds.size(); t++ )
+					 nbds[t]->set_geometry(geom_begin,geom_end);
 				 
+				 Qt_clock clock;
+				 clock.start();
+				 Compact_search_tree* new_mptree = 0;
+				 std::string cache_filename;
+				 if( !cache_prefix.empty() ) {
+					 cache_filename = tree_cache_filename( cache_prefix, geom_begin, geom_end,
+						 nb_of_categories, cmin, memory_budget );
+					 new_mptree = Compact_search_tree::load( cache_filename );
+				 }
+				 if( new_mptree ) {
+					 GsTLcout << "Search tree size = " << new_mptree->size() << "   ";
+					 GsTLlog << "multigrid " << ncoarse << ": search tree of " 
+						 << new_mptree->size() << " nodes loaded from " << cache_filename
+						 << " in " << clock.elapsed() / 1000.0 << " s" << gstlIO::end;
+					 mptree.push_back( new_mptree );
+					 continue;
+				 }
+
 				 appli_message("building search tree..."  );
 				 
 				 // creating a vector of search tree pointers corresponding to different rotation angles
-				 search_tree<T,allocator>* new_mptree = 
-					 new search_tree<T,allocator>( ti_begin,ti_end,*nbd,
-					 templ_size,
-					 nb_of_categories, cmin );
+				 if( nbds.size() > 1 ) {
+					 Ti_scan_task<TiIterator, ScanNbd> task( bounds, nbds, 
+						 templ_size, nb_of_categories );
+					 utils::run_parallel( task, task.jobs_count(), int( nbds.size() ) );
+					 Compact_search_tree::Training_events events( templ_size, nb_of_categories );
+					 task.merge( events );
+					 new_mptree = new Compact_search_tree( events, cmin, memory_budget );
+				 }
+				 else
+					 new_mptree = new Compact_search_tree( ti_begin,ti_end,*nbd,
+						 templ_size,
+						 nb_of_categories, cmin, memory_budget );
 				 GsTLcout << "Search tree size = " << new_mptree->size() << "   ";
+				 GsTLlog << "multigrid " << ncoarse << ": search tree of " 
+					 << new_mptree->size() << " nodes, "
+					 << new_mptree->memory_size() / 1048576.0 << " MB, built in "
+					 << clock.elapsed() / 1000.0 << " s";
+				 if( nbds.size() > 1 )
+					 GsTLlog << " on " << nbds.size() << " threads";
+				 if( new_mptree->is_pruned() )
+					 GsTLlog << " (rare patterns pruned)";
+				 if( new_mptree->depth() < templ_size )
+					 GsTLlog << " (truncated to " << new_mptree->depth() 
+					         << " template nodes)";
+				 GsTLlog << gstlIO::end;
 				 mptree.push_back( new_mptree );
+
+				 if( !cache_filename.empty() && !new_mptree->save( cache_filename ) )
+					 GsTLlog << "could not save the search tree to " << cache_filename 
+					         << gstlIO::end;
 			 }
 		 }
          GsTLcout << gstlIO::end;
@@ -220,6 +335,30 @@ class GEOSTAT_DECL Tree_list
 		 }
 	 }
 	 
+	 template<class GeomIterator>
+		 std::string tree_cache_filename( const std::string& prefix,
+		 GeomIterator gmit_begin, GeomIterator gmit_end,
+		 unsigned int nb_of_categories, int cmin, double memory_budget )
+	 {
+		 std::vector<int> key_data;
+		 for(GeomIterator iter = gmit_begin; iter!=gmit_end; iter++)
+		 {
+			 key_data.push_back( (*iter).x() );
+			 key_data.push_back( (*iter).y() );
+			 key_data.push_back( (*iter).z() );
+		 }
+		 key_data.push_back( int(nb_of_categories) );
+		 key_data.push_back( cmin );
+		 unsigned long long key = Compact_search_tree::hash( &key_data[0], 
+			 key_data.size() * sizeof(int) );
+		 key = Compact_search_tree::hash( &memory_budget, sizeof(double), key );
+
+		 char key_str[32];
+		 sprintf( key_str, "_%08x%08x.tree", 
+			 (unsigned int)(key >> 32), (unsigned int)(key & 0xffffffff) );
+		 return prefix + key_str;
+	 }
+
 	 int Nint(double x)
 	 {
 		 return x>=0 ? static_cast<int> (x + 0.5) : static_cast<int> (x - 0.5) ;
@@ -229,7 +368,7 @@ class GEOSTAT_DECL Tree_list
 	 int num_rot_;
 	 int num_aff_;
 	 std::vector< int> geometry_[3];
-	 std::vector< search_tree<T,allocator>* > mptree;
+	 std::vector< Compact_search_tree* > mptree;
      SearchTreeLocator* st_loc_;
 
      // added for anisotropic expansion
@@ -12,6 +12,7 @@ HEADERS += common.h \
            maskedgridcursor.h \
            library_grid_init.h \
            mgrid_neighborhood.h \
+           grid_model/bit_flags.h \
            grid_model/cartesian_grid.h \
            grid_model/combined_neighborhood.h \
            grid_model/cross_variog_computer.h \
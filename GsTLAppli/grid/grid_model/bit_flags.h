@@ -0,0 +1,223 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "grid" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the
+** license defined by the Stanford Center for Reservoir Forecasting and
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#ifndef __GSTLAPPLI_GRID_BIT_FLAGS_H__
+#define __GSTLAPPLI_GRID_BIT_FLAGS_H__
+
+
+#include <GsTLAppli/utils/gstl_types.h>
+
+#include <vector>
+#include <algorithm>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+
+/** Bit_flags is a fixed-size array of boolean flags packed 64 per word.
+ * It is used to store the hard-data flags of a property (1 bit per node
+ * instead of 1 byte) and as a mask of the informed nodes of a property.
+ * All the bulk operations (counting, searching the next set flag,
+ * and/or-ing two masks) work a full word at a time.
+ */
+class Bit_flags {
+ public:
+  typedef unsigned long long word_type;
+  enum { bits_per_word = 64 };
+
+ public:
+  Bit_flags() : size_( 0 ) {}
+  explicit Bit_flags( GsTLInt size, bool value = false ) { resize( size, value ); }
+
+  /** Resizes the array to \a size flags, all set to \a value.
+  */
+  void resize( GsTLInt size, bool value = false ) {
+    size_ = size;
+    words_.assign( word_count( size ), value ? ~word_type(0) : word_type(0) );
+    clear_padding();
+  }
+
+  GsTLInt size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  bool test( GsTLInt id ) const {
+    if( id < 0 || id >= size_ ) return false;
+    return ( words_[ id / bits_per_word ] >> ( id % bits_per_word ) ) & 1;
+  }
+
+  void set( GsTLInt id, bool flag = true ) {
+    word_type bit = word_type(1) << ( id % bits_per_word );
+    if( flag )
+      words_[ id / bits_per_word ] |= bit;
+    else
+      words_[ id / bits_per_word ] &= ~bit;
+  }
+
+  void reset( GsTLInt id ) { set( id, false ); }
+
+  /** Returns the number of flags set to true.
+  */
+  GsTLInt count() const {
+    GsTLInt n = 0;
+    for( unsigned int w = 0; w < words_.size(); w++ )
+      n += popcount( words_[w] );
+    return n;
+  }
+
+  /** Returns the first index strictly greater than \a id whose flag is set.
+  * Use \c find_next(-1) to get the first set flag. If there is no such
+  * index, size() is returned.
+  */
+  GsTLInt find_next( GsTLInt id ) const {
+    GsTLInt start = id + 1;
+    if( start < 0 ) start = 0;
+    if( start >= size_ ) return size_;
+
+    GsTLInt w = start / bits_per_word;
+    word_type word = words_[w] & ( ~word_type(0) << ( start % bits_per_word ) );
+    const GsTLInt nwords = GsTLInt( words_.size() );
+    while( word == 0 ) {
+      if( ++w == nwords ) return size_;
+      word = words_[w];
+    }
+    return w * bits_per_word + first_set( word );
+  }
+
+  GsTLInt find_first() const { return find_next( -1 ); }
+
+  /** Bitwise and / or with another array of the same size.
+  */
+  Bit_flags& operator &= ( const Bit_flags& rhs ) {
+    const unsigned int n = std::min( words_.size(), rhs.words_.size() );
+    for( unsigned int w = 0; w < n; w++ )
+      words_[w] &= rhs.words_[w];
+    for( unsigned int w = n; w < words_.size(); w++ )
+      words_[w] = 0;
+    return *this;
+  }
+
+  Bit_flags& operator |= ( const Bit_flags& rhs ) {
+    const unsigned int n = std::min( words_.size(), rhs.words_.size() );
+    for( unsigned int w = 0; w < n; w++ )
+      words_[w] |= rhs.words_[w];
+    clear_padding();
+    return *this;
+  }
+
+  /** Sets the flags [ first, first+n ) from a plain array of booleans
+  */
+  void assign( const bool* flags, GsTLInt n, GsTLInt first = 0 ) {
+    for( GsTLInt i = 0; i < n; i++ )
+      set( first + i, flags[i] );
+  }
+
+  /** Copies the flags [ first, first+n ) into a plain array of booleans
+  */
+  void copy_to( bool* flags, GsTLInt n, GsTLInt first = 0 ) const {
+    for( GsTLInt i = 0; i < n; i++ )
+      flags[i] = test( first + i );
+  }
+
+  /** Sets flag i to true iff values[i] != \a no_data_value, i=0..size()-1.
+  * The mask is built 64 values at a time so that the comparison loop
+  * can be vectorized by the compiler.
+  */
+  void assign_informed( const float* values, float no_data_value ) {
+    const GsTLInt full = size_ / bits_per_word;
+    for( GsTLInt w = 0; w < full; w++ ) {
+      const float* v = values + w * bits_per_word;
+      word_type word = 0;
+      for( int b = 0; b < bits_per_word; b++ )
+        word |= word_type( v[b] != no_data_value ) << b;
+      words_[w] = word;
+    }
+    for( GsTLInt i = full * bits_per_word; i < size_; i++ )
+      set( i, values[i] != no_data_value );
+  }
+
+  const word_type* words() const { return words_.empty() ? 0 : &words_[0]; }
+  word_type* words() { return words_.empty() ? 0 : &words_[0]; }
+  unsigned int nb_words() const { return words_.size(); }
+
+  static GsTLInt word_count( GsTLInt size ) {
+    return ( size + bits_per_word - 1 ) / bits_per_word;
+  }
+
+  static inline int popcount( word_type w );
+  static inline int first_set( word_type w );
+
+
+ private:
+  // the bits beyond size_ in the last word are kept to 0 so that count()
+  // and find_next() never see them
+  void clear_padding() {
+    int used = size_ % bits_per_word;
+    if( used != 0 && !words_.empty() )
+      words_.back() &= ( word_type(1) << used ) - 1;
+  }
+
+ private:
+  std::vector<word_type> words_;
+  GsTLInt size_;
+};
+
+
+
+//=================================================
+//   Definition of inline functions
+
+inline int Bit_flags::popcount( word_type w ) {
+#if defined(__GNUC__)
+  return __builtin_popcountll( w );
+#else
+  // __popcnt64 would require a cpu with the popcnt instruction
+  w = w - ( ( w >> 1 ) & 0x5555555555555555ULL );
+  w = ( w & 0x3333333333333333ULL ) + ( ( w >> 2 ) & 0x3333333333333333ULL );
+  w = ( w + ( w >> 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+  return int( ( w * 0x0101010101010101ULL ) >> 56 );
+#endif
+}
+
+// w must not be 0
+inline int Bit_flags::first_set( word_type w ) {
+#if defined(__GNUC__)
+  return __builtin_ctzll( w );
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64( &index, w );
+  return int( index );
+#else
+  int n = 0;
+  while( !( ( w >> n ) & 1 ) ) n++;
+  return n;
+#endif
+}
+
+
+#endif
@@ -34,48 +34,25 @@
 #include <algorithm>
 
 
-// Compares 2 geovalues g1, g2:
-// g1 < g2 if the covariance between g1 and the center is higher.
-// The "center" is a given reference point
-class Geovalue_covariance_comparator {
-public:
-  typedef Geovalue::location_type location_type;
-
-  Geovalue_covariance_comparator( const location_type& center, 
-    const Covariance<location_type>& cov ) 
-    : center_( center ), cov_( cov ) {}
-
-  // g1 < g2 if the covariance between g1 and the center is higher
-  bool operator() ( const Geovalue& g1, const Geovalue& g2 ) const {
-    return cov_( g1.location(), center_ ) > cov_(g2.location(), center_ );
+// Orders the candidate neighbors by increasing key
+struct Candidate_key_less {
+  template< class Candidate >
+  bool operator() ( const Candidate& c1, const Candidate& c2 ) const {
+    return c1.key < c2.key;
   }
-
-private:
-  location_type center_;
-  const Covariance<location_type>& cov_; 
 };
 
-
-// Compares 2 geovalues g1, g2:
-// g1 < g2 if the euclidean distance between g1 and the center is smaller.
-// The "center" is a given reference point
-class Geovalue_comparator {
-public:
-  typedef Geovalue::location_type location_type;
-
-  Geovalue_comparator( const location_type& center ) 
-    : center_( center ) {}
-
-  // g1 < g2 if the covariance between g1 and the center is higher
-  bool operator() ( const Geovalue& g1, const Geovalue& g2 ) const  {
-    return square_euclidean_distance( g1.location(), center_ ) < 
-           square_euclidean_distance(g2.location(), center_ );
+// Orders the candidate neighbors by increasing key, then by position in 
+// their neighborhood
+struct Candidate_key_position_less {
+  template< class Candidate >
+  bool operator() ( const Candidate& c1, const Candidate& c2 ) const {
+    if( c1.key != c2.key ) return c1.key < c2.key;
+    return c1.geovalue < c2.geovalue;
   }
-
-private:
-  location_type center_;
 };
 
+
 // Compares the location of geovalues g1, with center:
 // g1.location == center return true
 // the "center" is a given reference point
@@ -152,6 +129,11 @@ void Combined_neighborhood::includes_center( bool on ) {
   second_->includes_center( on );
 }
 
+void Combined_neighborhood::track_simulated_centers( bool on ) {
+  first_->track_simulated_centers( on );
+  second_->track_simulated_centers( on );
+}
+
 
 void Combined_neighborhood::find_neighbors( const Geovalue& center ) {
   neighbors_.clear();
@@ -173,37 +155,67 @@ void Combined_neighborhood::find_neighbors( const Geovalue& center ) {
   // ask both neighborhoods to search neighbors
   first_->find_neighbors( center );
   second_->find_neighbors( center );
-  std::sort(second_->begin(), second_->end(),Geovalue_covariance_comparator(center.location(), *cov_));
-  
 
-  std::vector<Geovalue> neighbors_temp;
-  neighbors_temp.resize( first_->size() + second_->size() );
-  neighbors_.reserve( first_->size() + second_->size() );
   // select those that are closest to "center" from both neighborhoods
-  if( cov_ )
-    std::merge( first_->begin(), first_->end(), 
-                second_->begin(), second_->end(), 
-                neighbors_temp.begin(), 
-                Geovalue_covariance_comparator(center.location(), *cov_)  );
-  else
-    std::merge( first_->begin(), first_->end(), 
-                second_->begin(), second_->end(), 
-                neighbors_temp.begin(), Geovalue_comparator(center.location() )  );
-
-  Neighborhood::iterator it_unique = 
-    std::unique(neighbors_temp.begin(), neighbors_temp.end(),Geovalue_location_comparator() );
- // neighbors_temp.erase( it_unique, neighbors_temp.end() );
-
-  Neighborhood::iterator it_neigh = neighbors_temp.begin();
-  for( ; it_neigh != it_unique; ++it_neigh ) {
-    if(neigh_filter_->is_admissible(*it_neigh, center)) {
-      neighbors_.push_back( *it_neigh );
+  merge_candidates( first_->begin(), first_->end(), 
+                    second_->begin(), second_->end(), center.location(), true );
+
+  // Colocated neighbors have the same key, hence they are next to each 
+  // other: only the first one is kept. A node found by both neighborhoods
+  // is recognized by its grid and node id, the neighbors of different 
+  // nodes are compared by location.
+  Geovalue_location_comparator same_location;
+  const Geovalue* last = 0;
+  std::vector<Candidate>::const_iterator it = candidates_.begin();
+  for( ; it != candidates_.end() && neighbors_.size() < max_size_; ++it ) {
+    const Geovalue* neighbor = it->geovalue;
+    if( last ) {
+      bool same_node = last->grid() == neighbor->grid() && 
+                       last->node_id() == neighbor->node_id();
+      if( same_node || same_location( *last, *neighbor ) ) continue;
     }
+    last = neighbor;
+
+    if( neigh_filter_->is_admissible( *neighbor, center ) ) 
+      neighbors_.push_back( *neighbor );
   }
+}
 
 
-  if( neighbors_.size() > max_size_ )
-    neighbors_.erase( neighbors_.begin() + max_size_, neighbors_.end() );
+inline double Combined_neighborhood::key( const Geovalue& neighbor, 
+                                          const location_type& center ) const {
+  if( cov_ ) 
+    return -(*cov_)( neighbor.location(), center );
+  return square_euclidean_distance( neighbor.location(), center );
+}
+
+
+void Combined_neighborhood::
+merge_candidates( const_iterator begin1, const_iterator end1,
+                  const_iterator begin2, const_iterator end2,
+                  const location_type& center, bool sort_second ) {
+  first_candidates_.resize( end1 - begin1 );
+  for( int i = 0; begin1 != end1; ++begin1, ++i ) {
+    first_candidates_[i].key = key( *begin1, center );
+    first_candidates_[i].geovalue = &( *begin1 );
+  }
+
+  second_candidates_.resize( end2 - begin2 );
+  for( int i = 0; begin2 != end2; ++begin2, ++i ) {
+    second_candidates_[i].key = key( *begin2, center );
+    second_candidates_[i].geovalue = &( *begin2 );
+  }
+
+  // the address of the neighbors breaks the ties: the sort does not need
+  // to be stable (std::stable_sort would allocate a buffer)
+  if( sort_second )
+    std::sort( second_candidates_.begin(), second_candidates_.end(), 
+               Candidate_key_position_less() );
+
+  candidates_.resize( first_candidates_.size() + second_candidates_.size() );
+  std::merge( first_candidates_.begin(), first_candidates_.end(),
+              second_candidates_.begin(), second_candidates_.end(),
+              candidates_.begin(), Candidate_key_less() );
 }
 
 
@@ -276,23 +288,13 @@ void Combined_neighborhood_dedup::find_neighbors( const Geovalue& center ){
     }
   }
 
-  //neighbors_.resize( first_->size() + second_->size() );
-  neighbors_.resize( std::distance(first_->begin(),end_1st) 
-                      + std::distance(second_->begin(),end_2nd) );
   // select those that are closest to "center" from both neighborhoods
-  if( cov_ )
-    std::merge( first_->begin(), end_1st, 
-                second_->begin(), end_2nd, 
-                neighbors_.begin(), 
-                Geovalue_covariance_comparator(center.location(), *cov_)  );
-  else
-    std::merge( first_->begin(), end_1st, 
-                second_->begin(), end_2nd, 
-                neighbors_.begin(), Geovalue_comparator(center.location() )  );
-
-
-  if( neighbors_.size() > max_size_ )
-    neighbors_.erase( neighbors_.begin() + max_size_, neighbors_.end() );
+  merge_candidates( first_->begin(), end_1st, second_->begin(), end_2nd, 
+                    center.location(), false );
+
+  int size = std::min( int( candidates_.size() ), max_size_ );
+  for( int i = 0; i < size; i++ )
+    neighbors_.push_back( *candidates_[i].geovalue );
 }
 
 
@@ -35,6 +35,8 @@
 #include <GsTLAppli/grid/grid_model/geostat_grid.h>
 
 #include <GsTL/geometry/covariance.h>
+
+#include <vector>
  
 /** It is sometimes necessary to retrieve the neighbors of a given geovalue 
  * from several grids: in sequential gaussian simulation, the hard data can be 
@@ -66,6 +68,7 @@ class GRID_DECL Combined_neighborhood : public Neighborhood {
   virtual const GsTLGridProperty* selected_property() const;
   
   virtual void includes_center( bool on );
+  virtual void track_simulated_centers( bool on );
 
   virtual void find_neighbors( const Geovalue& center ); 
   virtual void max_size( int s ); 
@@ -86,12 +89,41 @@ class GRID_DECL Combined_neighborhood : public Neighborhood {
   }
   
   protected: 
+  virtual void set_center( const Geovalue& center ) { center_ = center; }
+
+  /** A neighbor found by one of the two neighborhoods, with the key it is
+   * sorted by: the opposite of its covariance with the center, or its 
+   * square distance to the center if there is no covariance.
+   */
+  struct Candidate {
+    double key;
+    const Geovalue* geovalue;
+  };
+
+  /** Computes the key of each neighbor of [begin1,end1) and [begin2,end2)
+   * once, and merges the two ranges into candidates_ by increasing key. 
+   * The first range must already be sorted; the second one is sorted if 
+   * \c sort_second is true.
+   */
+  void merge_candidates( const_iterator begin1, const_iterator end1,
+                         const_iterator begin2, const_iterator end2,
+                         const location_type& center, bool sort_second );
+
+  double key( const Geovalue& neighbor, 
+              const location_type& center ) const;
+
+ protected: 
   SmartPtr<Neighborhood> first_; 
   SmartPtr<Neighborhood> second_;
   int max_size_; 
   Geovalue center_; 
 
   const Covariance<location_type>* cov_; 
+
+  // scratch buffers, kept from one search to the next to avoid allocations
+  std::vector<Candidate> first_candidates_;
+  std::vector<Candidate> second_candidates_;
+  std::vector<Candidate> candidates_;
 }; 
 
 class GRID_DECL Combined_neighborhood_dedup : public Combined_neighborhood { 
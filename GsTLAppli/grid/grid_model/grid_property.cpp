@@ -32,8 +32,23 @@
 
 #include <algorithm>
 #include <stdio.h>
+#include <string.h>
 #include <QDomElement>
 
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+#if defined(_WIN32) || defined(WIN32)
+  #ifndef NOMINMAX
+  #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+#endif
+
 const float GsTLGridProperty::no_data_value = -9966699;
 
 
@@ -41,13 +56,21 @@ const float GsTLGridProperty::no_data_value = -9966699;
 GsTLGridProperty::GsTLGridProperty( GsTLInt size, const std::string& name,
 				    property_type default_value )
   : name_( name ), region_(NULL) {
+#ifdef SGEMS_ACCESSOR_LARGE_FILE
   accessor_ = new MemoryAccessor( size, default_value );
+#else
+  accessor_ = new PackedMemoryAccessor( size, default_value );
+#endif
 }
 
 GsTLGridProperty::GsTLGridProperty( GsTLInt size, const std::string& name,
 			const std::string& in_filename, property_type default_value)
 : name_( name ), region_(NULL) {
+#ifdef SGEMS_ACCESSOR_LARGE_FILE
 	accessor_ = new MemoryAccessor( size, default_value );
+#else
+	accessor_ = new PackedMemoryAccessor( size, default_value );
+#endif
 	std::ifstream file (in_filename.c_str(), std::ios::in|std::ios::binary);
 	file.read ((char*)accessor_->data(), size*sizeof(float));
 	//accessor_ = new DiskAccessor( size, name, in_filename );
@@ -63,13 +86,41 @@ GsTLGridProperty::~GsTLGridProperty() {
 
 void GsTLGridProperty::swap_to_disk() const {
   // If the property is already on disk, don't do anything.
-  // Otherwise, create a DiskAccessor and delete the old Accessor.
+  // Otherwise, create a MmapAccessor (or a DiskAccessor if the cache file 
+  // can not be mapped) and delete the old Accessor.
 
   if( dynamic_cast<DiskAccessor*>( accessor_ ) ) return;
+
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+  if( dynamic_cast<MmapAccessor*>( accessor_ ) ) return;
+
+  Bit_flags harddata;
+  harddata_mask( harddata );
+  MmapAccessor* mapped = new MmapAccessor( accessor_->size(), name_,
+                                           accessor_->data(), harddata );
+  if( mapped->data() ) {
+    delete accessor_;
+    accessor_ = mapped;
+    return;
+  }
+  delete mapped;
+#endif
+
+  // The disk accessor stores the flags as an array of bools: unpack them
+  // if they are bit-packed
+  const bool* flags = accessor_->flags(0);
+  bool* unpacked_flags = 0;
+  const Bit_flags* packed_flags = accessor_->packed_flags(0);
+  if( !flags && packed_flags ) {
+    unpacked_flags = new bool[ accessor_->size() ];
+    packed_flags->copy_to( unpacked_flags, accessor_->size() );
+    flags = unpacked_flags;
+  }
   
   DiskAccessor* new_accessor = new DiskAccessor( accessor_->size(), name_,
 						 accessor_->data(),
-						 accessor_->flags(0) );
+						 flags );
+  delete [] unpacked_flags;
   
   delete accessor_;
   accessor_ = new_accessor;
@@ -77,17 +128,126 @@ void GsTLGridProperty::swap_to_disk() const {
 
 
 void GsTLGridProperty::swap_to_memory() const {
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+  MmapAccessor* mapped = dynamic_cast<MmapAccessor*>( accessor_ );
+  if( mapped ) {
+    PackedMemoryAccessor* new_accessor = 
+      new PackedMemoryAccessor( mapped->size(), mapped->data(), 
+                                *mapped->packed_flags(0) );
+    delete accessor_;
+    accessor_ = new_accessor;
+    return;
+  }
+#endif
+
   DiskAccessor* current = dynamic_cast<DiskAccessor*>( accessor_ );
   if( !current ) return;
     
+#ifdef SGEMS_ACCESSOR_LARGE_FILE
   MemoryAccessor* new_accessor = new MemoryAccessor( accessor_->size(),
 						     current->stream() );
+#else
+  PackedMemoryAccessor* new_accessor = 
+    new PackedMemoryAccessor( accessor_->size(), current->stream() );
+#endif
   delete accessor_;
   accessor_ = new_accessor;
 }
 
 bool GsTLGridProperty::is_in_memory() const{
-	return dynamic_cast<MemoryAccessor*>( accessor_ );
+	return !dynamic_cast<DiskAccessor*>( accessor_ ) && !is_mapped();
+}
+
+bool GsTLGridProperty::is_mapped() const {
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+  return dynamic_cast<MmapAccessor*>( accessor_ ) != 0;
+#else
+  return false;
+#endif
+}
+
+bool GsTLGridProperty::can_be_shared() const {
+  return is_in_memory() || is_mapped();
+}
+
+
+GsTLInt GsTLGridProperty::informed_count() const {
+  const GsTLInt size = accessor_->size();
+  GsTLInt count = 0;
+
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+  const float* values = accessor_->data();
+  if( values ) {
+    // branch-free so that the compiler can vectorize the loop
+    for( GsTLInt i = 0; i < size; i++ )
+      count += ( values[i] != no_data_value );
+    return count;
+  }
+#endif
+
+  for( GsTLInt i = 0; i < size; i++ ) {
+    if( accessor_->get_property_value( i ) != no_data_value ) count++;
+  }
+  return count;
+}
+
+
+void GsTLGridProperty::informed_mask( Bit_flags& mask ) const {
+  const GsTLInt size = accessor_->size();
+  mask.resize( size );
+
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+  const float* values = accessor_->data();
+  if( values ) {
+    mask.assign_informed( values, no_data_value );
+    return;
+  }
+#endif
+
+  for( GsTLInt i = 0; i < size; i++ ) {
+    if( accessor_->get_property_value( i ) != no_data_value ) mask.set( i );
+  }
+}
+
+
+GsTLInt GsTLGridProperty::harddata_count() const {
+  const Bit_flags* packed_flags = accessor_->packed_flags(0);
+  if( packed_flags ) return packed_flags->count();
+
+  const GsTLInt size = accessor_->size();
+  GsTLInt count = 0;
+  const bool* flags = accessor_->flags(0);
+  if( flags ) {
+    for( GsTLInt i = 0; i < size; i++ )
+      count += flags[i];
+    return count;
+  }
+
+  for( GsTLInt i = 0; i < size; i++ ) {
+    if( accessor_->get_flag( 0, i ) ) count++;
+  }
+  return count;
+}
+
+
+void GsTLGridProperty::harddata_mask( Bit_flags& mask ) const {
+  const Bit_flags* packed_flags = accessor_->packed_flags(0);
+  if( packed_flags ) {
+    mask = *packed_flags;
+    return;
+  }
+
+  const GsTLInt size = accessor_->size();
+  mask.resize( size );
+  const bool* flags = accessor_->flags(0);
+  if( flags ) {
+    mask.assign( flags, size );
+    return;
+  }
+
+  for( GsTLInt i = 0; i < size; i++ ) {
+    if( accessor_->get_flag( 0, i ) ) mask.set( i );
+  }
 }
 
 
@@ -308,6 +468,219 @@ std::vector<float*> MemoryAccessor::new_data_structure(int size){
   return values_;
 }
 #endif
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+//===============================================
+PackedMemoryAccessor::PackedMemoryAccessor( GsTLInt size, float default_value ) {
+  values_ = new(std::nothrow) float[size];
+  if( values_ == NULL ) {
+    size_ = 0;
+    return;
+  }
+
+  size_ = size;
+  std::fill( values_, values_ + size, default_value );
+  flags_.resize( size, false );
+}
+
+PackedMemoryAccessor::PackedMemoryAccessor( GsTLInt size, std::fstream& stream ) {
+  values_ = new(std::nothrow) float[size];
+  if( values_ == NULL ) {
+    size_ = 0;
+    return;
+  }
+
+  size_ = size;
+  flags_.resize( size, false );
+
+  if( !stream.is_open() ) {
+    GsTLlog << "Error: Stream not open when trying to swap property to memory!!"
+            << gstlIO::end;
+  }
+  stream.seekg(0);
+
+  long int remaining = size*sizeof( float );
+  stream.read( (char*) values_, remaining );
+
+  // read the flags, stored as an array of bools, one block at a time
+  const GsTLInt block_size = 65536;
+  bool* buffer = new bool[ std::min( size, block_size ) ];
+  for( GsTLInt first = 0; first < size; first += block_size ) {
+    GsTLInt n = std::min( block_size, size - first );
+    stream.read( (char*) buffer, n*sizeof( bool ) );
+    flags_.assign( buffer, n, first );
+  }
+  delete [] buffer;
+}
+
+PackedMemoryAccessor::PackedMemoryAccessor( GsTLInt size, const float* values,
+                                            const Bit_flags& flags ) 
+  : flags_( flags ) {
+  values_ = new(std::nothrow) float[size];
+  if( values_ == NULL ) {
+    size_ = 0;
+    return;
+  }
+
+  size_ = size;
+  std::copy( values, values + size, values_ );
+}
+
+PackedMemoryAccessor::~PackedMemoryAccessor() {
+  delete [] values_;
+}
+
+float PackedMemoryAccessor::get_property_value( GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  return values_[id];
+}
+
+void PackedMemoryAccessor::set_property_value( float val, GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  values_[id] = val;
+}
+
+// The current implementation only supports one set of flags
+bool PackedMemoryAccessor::get_flag( int, GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  return flags_.test( id );
+}
+
+// The current implementation only supports one set of flags
+void PackedMemoryAccessor::set_flag( bool flag, int, GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  flags_.set( id, flag );
+}
+#endif
+
+
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+//===============================================
+MmapAccessor::MmapAccessor( GsTLInt size, const std::string& prop_name,
+                            const float* prop, const Bit_flags& flags ) 
+  : values_( 0 ), size_( 0 ) {
+
+  filename_ = DiskAccessor::cache_filename( prop_name );
+  if( flags.size() == size ) 
+    flags_ = flags;
+  else
+    flags_.resize( size );
+
+  // Write the initial values to the cache file, then map it
+  std::ofstream out( filename_.c_str(), std::ios::out | std::ios::binary );
+  if( !out ) {
+    GsTLcerr << "Can't write temporary file. Check that the directory is writable\n" 
+             << "and that there is enough disk space left" << gstlIO::end;
+    return;
+  }
+
+  if( prop ) {
+    out.write( (const char*) prop, 
+               static_cast<std::streamsize>( size ) * sizeof( float ) );
+  }
+  else {
+    const GsTLInt block_size = 65536;
+    std::vector<float> block( std::min( size, block_size ), 
+                              GsTLGridProperty::no_data_value );
+    for( GsTLInt first = 0; first < size; first += block_size ) {
+      GsTLInt n = std::min( block_size, size - first );
+      out.write( (const char*) &block[0], n*sizeof( float ) );
+    }
+  }
+  out.close();
+  if( !out ) {
+    GsTLcerr << "Can't write temporary file. Check that the directory is writable\n" 
+             << "and that there is enough disk space left" << gstlIO::end;
+    remove( filename_.c_str() );
+    return;
+  }
+
+  size_ = size;
+  if( !map_file() ) {
+    size_ = 0;
+    remove( filename_.c_str() );
+  }
+}
+
+
+MmapAccessor::~MmapAccessor() {
+  unmap_file();
+  remove( filename_.c_str() );
+}
+
+
+bool MmapAccessor::map_file() {
+  if( size_ <= 0 ) return false;
+  size_t length = static_cast<size_t>( size_ ) * sizeof( float );
+
+#if defined(_WIN32) || defined(WIN32)
+  HANDLE file = CreateFileA( filename_.c_str(), GENERIC_READ | GENERIC_WRITE, 
+                             FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+  if( file == INVALID_HANDLE_VALUE ) return false;
+
+  HANDLE mapping = 
+    CreateFileMappingA( file, NULL, PAGE_READWRITE, 0, 0, NULL );
+  // the view keeps a reference to the mapping and the file: the handles
+  // can be closed right away
+  CloseHandle( file );
+  if( mapping == NULL ) return false;
+
+  void* address = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, length );
+  CloseHandle( mapping );
+  if( address == NULL ) return false;
+#else
+  int fd = open( filename_.c_str(), O_RDWR );
+  if( fd < 0 ) return false;
+
+  void* address = mmap( 0, length, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0 );
+  // the mapping keeps a reference to the file: the descriptor can be 
+  // closed right away
+  close( fd );
+  if( address == MAP_FAILED ) return false;
+#endif
+
+  values_ = static_cast<float*>( address );
+  return true;
+}
+
+
+void MmapAccessor::unmap_file() {
+  if( !values_ ) return;
+
+#if defined(_WIN32) || defined(WIN32)
+  UnmapViewOfFile( values_ );
+#else
+  munmap( values_, static_cast<size_t>( size_ ) * sizeof( float ) );
+#endif
+  values_ = 0;
+}
+
+
+float MmapAccessor::get_property_value( GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  return values_[id];
+}
+
+void MmapAccessor::set_property_value( float val, GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  values_[id] = val;
+}
+
+// The current implementation only supports one set of flags
+bool MmapAccessor::get_flag( int, GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  return flags_.test( id );
+}
+
+// The current implementation only supports one set of flags
+void MmapAccessor::set_flag( bool flag, int, GsTLInt id ) {
+  appli_assert( id >= 0 && id < size_ );
+  flags_.set( id, flag );
+}
+#endif
+
+
 //===============================================
 DiskAccessor::DiskAccessor( GsTLInt size, const std::string& filename, 
 			    const float* prop, const bool* flags ) 
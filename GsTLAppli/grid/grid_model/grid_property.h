@@ -36,6 +36,7 @@
 #include <GsTLAppli/utils/gstl_messages.h> 
 //#include <GsTLAppli/grid/grid_model/grid_property_set.h> 
 #include <GsTLAppli/grid/grid_model/grid_region.h> 
+#include <GsTLAppli/grid/grid_model/bit_flags.h>
  
 #include <string> 
 #include <fstream> 
@@ -99,8 +100,9 @@ class GRID_DECL GsTLGridProperty {
  
   /** Get direct access to the data array. This function is to be used
   * for speed optimization only. If the property is currently stored on the
-  * disk rather than in RAM (see functions \c swap_to_disk() and 
-  * \c swap_to_memory() ), the function returns a null pointer.
+  * disk in a file that could not be mapped in memory (see functions 
+  * \c swap_to_disk() and \c swap_to_memory() ), the function returns a 
+  * null pointer.
   */
 #ifdef SGEMS_ACCESSOR_LARGE_FILE
 
@@ -113,16 +115,35 @@ class GRID_DECL GsTLGridProperty {
   inline property_type* data(); 
   inline const property_type* data() const; 
 #endif
+  /** Returns the number of informed values in the property array.
+  */
+  GsTLInt informed_count() const;
+
+  /** Fills \a mask with one bit per node, set if the node is informed.
+  * Masks of different properties can then be combined with the bitwise
+  * operators of Bit_flags.
+  */
+  void informed_mask( Bit_flags& mask ) const;
+
+  /** Returns the number of hard-data in the property array.
+  */
+  GsTLInt harddata_count() const;
+
+  /** Fills \a mask with one bit per node, set if the node is a hard-datum.
+  */
+  void harddata_mask( Bit_flags& mask ) const;
+
   /** Returns the name of the property
   */
   inline std::string name() const { return name_; } 
   inline void rename( const std::string& new_name ) { name_ = new_name; } 
 
   /** Sends the property to the disk: instead of keeping the property values 
-  * in RAM, they are stored on the disk. This function is useful to save RAM.
-  * Accessing the property values from the disk is slower than from RAM, hence
-  * the property should be sent to RAM (see \c swap_to_memory() ) if performance  
-  * is an issue
+  * in RAM, they are stored in a file mapped in memory, and the operating 
+  * system only keeps in RAM the parts of the file that are being used. 
+  * This function is useful to save RAM. Accessing the property values from 
+  * the disk can be slower than from RAM, hence the property should be sent 
+  * to RAM (see \c swap_to_memory() ) if performance is an issue
   */
   void swap_to_disk() const; 
 
@@ -135,6 +156,17 @@ class GRID_DECL GsTLGridProperty {
   */
   bool is_in_memory() const;
 
+  /** Return true if the property was swapped to a file mapped in memory
+  * (see \c swap_to_disk() ): data() then points to the mapped values.
+  */
+  bool is_mapped() const;
+
+  /** Returns false if the property is read and written through a single 
+  * file stream (it was swapped to a file that could not be mapped in 
+  * memory): its values can then not be accessed by several threads.
+  */
+  bool can_be_shared() const;
+
   class iterator; 
   class const_iterator;
   iterator begin( bool skip = true ) { return iterator( this, 0, skip ); } 
@@ -272,6 +304,11 @@ class GRID_DECL PropertyAccessor {
 #endif
   virtual bool* flags( int flag_id ) = 0; 
   virtual const bool* flags( int flag_id ) const = 0; 
+
+  /** Returns the flags as a bit array if the accessor stores them packed,
+  * a null pointer otherwise (flags() is then the way to go).
+  */
+  virtual const Bit_flags* packed_flags( int flag_id ) const { return 0; }
    
   virtual GsTLInt size() const = 0; 
 }; 
@@ -331,6 +368,43 @@ class GRID_DECL MemoryAccessor : public PropertyAccessor {
 }; 
  
  
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+/** Same as MemoryAccessor, except that the flags are packed 1 bit per node
+ * (see Bit_flags): a property only costs 1/8 byte per node on top of its 
+ * values. Since the flags are not stored as an array of bools, flags() 
+ * returns a null pointer: use packed_flags() instead.
+ * Warning: this implementation currently only supports 1 set of flags. 
+ */ 
+class GRID_DECL PackedMemoryAccessor : public PropertyAccessor { 
+ public: 
+  PackedMemoryAccessor( GsTLInt size, float default_value ); 
+  PackedMemoryAccessor( GsTLInt size, std::fstream& stream ); 
+  PackedMemoryAccessor( GsTLInt size, const float* values, 
+                        const Bit_flags& flags ); 
+  virtual ~PackedMemoryAccessor(); 
+ 
+  virtual float get_property_value( GsTLInt id ) ; 
+  virtual void set_property_value( float val, GsTLInt id ); 
+  virtual bool get_flag( int flag_id, GsTLInt id ) ; 
+  virtual void set_flag( bool flag, int flag_id, GsTLInt id ); 
+ 
+  virtual float* data() { return values_; }
+  virtual const float* data() const { return values_; }
+
+  virtual bool* flags( int flag_id ) { return 0; } 
+  virtual const bool* flags( int flag_id ) const { return 0; } 
+  virtual const Bit_flags* packed_flags( int flag_id ) const { return &flags_; }
+ 
+  virtual GsTLInt size() const { return size_; } 
+ 
+ protected: 
+  float* values_; 
+  Bit_flags flags_; 
+  GsTLInt size_; 
+}; 
+#endif
+ 
+ 
 /** Warning: this implementation currently only supports 1 set of flags. 
  * The data are stored in the following format: 
  *  - all the property values 
@@ -383,6 +457,10 @@ const std::vector< float*> data() const {
   // This function is dangerous because the stream is then shared with whoever 
   // requested it. 
   std::fstream& stream(); 
+
+  /** Returns the name of the cache file for property prop_name.  
+   */ 
+  static std::string cache_filename( const std::string& prop_name ); 
  
 
  protected: 
@@ -403,10 +481,6 @@ const std::vector< float*> data() const {
    */ 
   virtual int delete_cache_file(); 
  
-  /** Returns the name of the cache file for property prop_name.  
-   */ 
-  static std::string cache_filename( const std::string& prop_name ); 
- 
  protected: 
   std::fstream cache_stream_; 
   std::string cache_filename_; 
@@ -424,6 +498,63 @@ const std::vector< float*> data() const {
  
  
  
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+/** MmapAccessor keeps the property values in a file mapped in memory. The
+ * operating system pages the values in and out of RAM as needed, and 
+ * data() returns a pointer to the mapped values, hence Geovalue and the 
+ * other functions that need direct access to the data array keep working.
+ * The file only contains the property values, in the same format as the
+ * property files written by the sgems folder filter. The flags are kept in
+ * memory, bit-packed.
+ * A new cache file is created and initialized with \a prop. Changes to 
+ * the values are written to that file, which is deleted when the accessor 
+ * is destroyed. Only that private cache file is ever mapped: the project 
+ * files are read in memory, since a file changed or truncated by another
+ * process would crash the mapping.
+ * If the file could not be mapped, data() returns a null pointer and size()
+ * returns 0.
+ * Warning: this implementation currently only supports 1 set of flags. 
+ */
+class GRID_DECL MmapAccessor : public PropertyAccessor { 
+ public: 
+  /** Creates a cache file for property \a prop_name
+  */
+  MmapAccessor( GsTLInt size, const std::string& prop_name,
+                const float* prop, const Bit_flags& flags );
+  virtual ~MmapAccessor(); 
+
+  virtual float get_property_value( GsTLInt id ) ; 
+  virtual void set_property_value( float val, GsTLInt id ); 
+  virtual bool get_flag( int flag_id, GsTLInt id ) ; 
+  virtual void set_flag( bool flag, int flag_id, GsTLInt id ); 
+
+  virtual float* data() { return values_; }
+  virtual const float* data() const { return values_; }
+
+  virtual bool* flags( int flag_id ) { return 0; } 
+  virtual const bool* flags( int flag_id ) const { return 0; } 
+  virtual const Bit_flags* packed_flags( int flag_id ) const { return &flags_; }
+
+  virtual GsTLInt size() const { return size_; } 
+
+  /** Returns the name of the mapped file
+  */
+  const std::string& filename() const { return filename_; }
+
+ protected:
+  bool map_file();
+  void unmap_file();
+
+ protected:
+  float* values_; 
+  Bit_flags flags_; 
+  GsTLInt size_; 
+  std::string filename_;
+}; 
+#endif
+ 
+ 
+ 
 //--------------------------- 
 class GRID_DECL PropertyValueProxy { 
   friend class GsTLGridProperty::iterator; 
@@ -12,6 +12,7 @@
 #include <iostream>
 
 #include <GsTLAppli/grid/grid_model/grid_property.h>
+#include <GsTLAppli/grid/grid_model/bit_flags.h>
 
 // utility
 
@@ -841,3 +842,86 @@ void kdtree2_node::process_terminal_node_fixedball(searchrecord& sr) {
 }
 
 
+
+//
+//        best-first search
+//
+
+// orders the queue entries so that std::push_heap/pop_heap keep the 
+// closest entry first
+struct queue_entry_farther {
+  template< class Entry >
+  bool operator()( const Entry& e1, const Entry& e2 ) const {
+    return e1.dis > e2.dis;
+  }
+};
+
+
+void kdtree2::nearest_first(const vector<GsTLCoord>& qv, GsTLCoord r2,
+                            kdtree2_visitor& visitor, const Bit_flags* informed) {
+  queue_.clear();
+  if (root == NULL) return;
+
+  queue_entry_farther farther;
+  queue_entry e;
+  e.dis = 0.0;
+  e.node = root;
+  e.idx = -1;
+  queue_.push_back(e);
+
+  while (!queue_.empty()) {
+    pop_heap(queue_.begin(), queue_.end(), farther);
+    queue_entry top = queue_.back();
+    queue_.pop_back();
+
+    // a point: all the points and boxes left in the queue are farther
+    if (top.node == NULL) {
+      kdtree2_result result;
+      result.dis = top.dis;
+      result.idx = top.idx;
+      if (!visitor.visit(result)) return;
+      continue;
+    }
+
+    kdtree2_node* node = top.node;
+    if (node->left == NULL && node->right == NULL) {
+      // terminal node: queue its informed points inside the ball
+      for (int i = node->l; i <= node->u; i++) {
+        int indexofi = ind[i];
+        int node_id = (*node_id_)[indexofi];
+        if (informed ? !informed->test(node_id) : !prop_->is_informed(node_id)) 
+          continue;
+
+        const int row = rearrange ? i : indexofi;
+        GsTLCoord dis = 0.0;
+        for (int k = 0; k < dim && dis <= r2; k++) 
+          dis += squared((*data)[row][k] - qv[k]);
+        if (dis > r2) continue;
+
+        e.dis = dis;
+        e.node = NULL;
+        e.idx = indexofi;
+        queue_.push_back(e);
+        push_heap(queue_.begin(), queue_.end(), farther);
+      }
+      continue;
+    }
+
+    kdtree2_node* children[2] = { node->left, node->right };
+    for (int c = 0; c < 2; c++) {
+      kdtree2_node* child = children[c];
+      if (child == NULL) continue;
+
+      GsTLCoord dis = 0.0;
+      for (int k = 0; k < dim && dis <= r2; k++) 
+        dis += squared(dis_from_bnd(qv[k], child->box[k].lower, child->box[k].upper));
+      if (dis > r2) continue;
+
+      e.dis = dis;
+      e.node = child;
+      e.idx = -1;
+      queue_.push_back(e);
+      push_heap(queue_.begin(), queue_.end(), farther);
+    }
+  }
+}
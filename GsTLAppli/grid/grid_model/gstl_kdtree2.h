@@ -44,6 +44,7 @@ class searchrecord;
 
 // A Boucher
 class GsTLGridProperty; 
+class Bit_flags;
 
 //
 // struct KDTREE2_RESULT
@@ -83,6 +84,21 @@ public:
 };
 
 
+//
+// class KDTREE2_VISITOR
+//
+// Receives the points found by kdtree2::nearest_first, closest first.
+//
+
+class kdtree2_visitor {
+public:
+  virtual ~kdtree2_visitor() {}
+
+  // returns false to stop the search
+  virtual bool visit( const kdtree2_result& point ) = 0;
+};
+
+
 //
 // class KDTREE2
 //
@@ -158,6 +174,15 @@ public:
   int r_count_around_point(int idxin, int correltime, GsTLCoord r2);
   // like r_count, c
 
+  void nearest_first(const vector<GsTLCoord>& qv, GsTLCoord r2,
+                     kdtree2_visitor& visitor, const Bit_flags* informed = 0);
+  // best-first search: pass the points within square distance r2 of 'qv'
+  // to 'visitor' by increasing distance, until the visitor stops the
+  // search. Only the nodes and points closer than the farthest point
+  // passed to the visitor are explored.
+  // If 'informed' is not null, it is used instead of the property to 
+  // skip the points that are not informed: bit i is the flag of node_id[i]
+
   void set_property(const GsTLGridProperty* prop);
 
   friend class kdtree2_node;
@@ -189,6 +214,16 @@ private:
   const GsTLGridProperty* prop_;
   const std::vector<int>* node_id_;
 
+  // priority queue of nearest_first: the nodes by distance to their
+  // bounding box, and the points (node == NULL) by distance. It is kept 
+  // from one search to the next.
+  struct queue_entry {
+    GsTLCoord dis;
+    kdtree2_node* node;
+    int idx;
+  };
+  vector<queue_entry> queue_;
+
 
 private:
   void set_data(kdtree2_array& din,  const GsTLGridProperty*& prop,
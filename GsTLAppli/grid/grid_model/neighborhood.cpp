@@ -36,8 +36,69 @@
 #include <GsTLAppli/grid/grid_model/neighborhood.h>
 #include <GsTLAppli/grid/grid_model/geostat_grid.h>
 
+#include <GsTL/geometry/geometry_algorithms.h>
+
 #include <algorithm>
 #include <iterator>
+#include <cmath>
+
+
+
+void Neighbor_batch::clear() {
+  offsets.clear();
+  offsets.push_back( 0 );
+  node_ids.clear();
+  sources.clear();
+  grids.clear();
+  properties.clear();
+  valid.clear();
+  distances.clear();
+}
+
+
+void Neighborhood::find_neighbors_batch( Geostat_grid* grid, GsTLGridProperty* prop,
+                                         const GsTLInt* node_ids, int count,
+                                         Neighbor_batch& batch, 
+                                         bool with_distances ) {
+  batch.clear();
+  batch.offsets.reserve( count+1 );
+
+  for( int i = 0; i < count; i++ ) {
+    Geovalue center( grid, prop, node_ids[i] );
+    find_neighbors( center );
+    append_neighbors( center, batch, with_distances );
+    batch.valid.push_back( is_valid() );
+  }
+}
+
+
+void Neighborhood::set_batch_neighbors( const Geovalue& center, 
+                                        const Neighbor_batch& batch, int i ) {
+  set_center( center );
+  neighbors_.clear();
+  for( int j = batch.offsets[i]; j < batch.offsets[i+1]; j++ ) {
+    const int source = batch.sources[j];
+    // the batch only keeps const pointers, but a Geovalue needs non-const
+    // ones: the neighbors found by a search are only read
+    neighbors_.push_back( 
+      Geovalue( const_cast<Geostat_grid*>( batch.grids[source] ),
+                const_cast<GsTLGridProperty*>( batch.properties[source] ),
+                batch.node_ids[j] ) );
+  }
+}
+
+
+void Neighborhood::append_neighbors( const Geovalue& center, 
+                                     Neighbor_batch& batch,
+                                     bool with_distances ) const {
+  batch.offsets.push_back( batch.offsets.back() );
+  for( const_iterator it = neighbors_.begin(); it != neighbors_.end(); ++it ) {
+    batch.push_back( it->grid(), it->property_array(), it->node_id() );
+    if( with_distances ) 
+      batch.distances.push_back( 
+        std::sqrt( square_euclidean_distance( it->location(), center.location() ) ) );
+  }
+}
 
 
 
@@ -95,18 +156,18 @@ set_neighbors( const_iterator begin, const_iterator end ) {
 //======================================
 
 Grid_template::Grid_template() 
-  : max_size_( 0 ) {
+  : max_size_( 0 ), revision_( 0 ) {
   scale_ = 1;
 }
 
 Grid_template::Grid_template( iterator begin, iterator end ) 
-  : templ_(begin, end) {  
+  : templ_(begin, end), revision_( 0 ) {  
   max_size_ = int( templ_.size() );
 }
 
 Grid_template::Grid_template( const Grid_template& rhs ) 
   : templ_( rhs.templ_ ), original_( rhs.original_ ), 
-    max_size_( rhs.max_size_ ) {
+    max_size_( rhs.max_size_ ), revision_( rhs.revision_ ) {
 }
 
 Grid_template& Grid_template::operator = ( const Grid_template& rhs ) {
@@ -114,6 +175,7 @@ Grid_template& Grid_template::operator = ( const Grid_template& rhs ) {
     templ_ = rhs.templ_;
     original_ = rhs.original_;
     max_size_ = rhs.max_size_;
+    revision_ = std::max( revision_, rhs.revision_ ) + 1;
   }
   return *this;
 }
@@ -122,6 +184,7 @@ void Grid_template::init( iterator begin, iterator end ) {
   templ_.clear();
   std::copy( begin, end, std::back_inserter( templ_ ) );
   max_size_ = int( templ_.size() );
+  revision_++;
 
   if( !original_.empty() ) {
     original_.clear();
@@ -153,6 +216,7 @@ void Grid_template::add_vector( const Euclidean_vector& vec, int pos ) {
   }
 
   max_size_++;
+  revision_++;
 }
 
 
@@ -162,6 +226,7 @@ void Grid_template::remove_vector( int pos ) {
   templ_.erase( templ_.begin() + pos );  
   if( !original_.empty() )
     original_.erase( original_.begin() + pos );
+  revision_++;
 }
 
 
@@ -177,6 +242,7 @@ Grid_template::iterator Grid_template::end() {
 void Grid_template::scale( int s ) {
   undo_scaling();
   scale_ = s;
+  revision_++;
   if( s == 1 ) return;
 
   if( original_.empty() ) {
@@ -194,11 +260,13 @@ void Grid_template::scale( int s ) {
 void Grid_template::undo_scaling() {
   if( !original_.empty() && scale_ != 1 )
     std::copy( original_.begin(), original_.end(), templ_.begin() );
+  revision_++;
 }
 
 
 void Grid_template::set_geometry( const std::vector<Euclidean_vector>& templ ) { 
   templ_ = templ; 
   original_ = templ;
+  revision_++;
 } 
 
@@ -44,6 +44,42 @@ class GsTLGridProperty;
  
  
  
+/** Neighbor_batch holds the neighbors of a block of centers, as found by
+ * Neighborhood::find_neighbors_batch(...), in compressed rows: the 
+ * neighbors of center i are entries offsets[i] to offsets[i+1]-1 of the 
+ * other arrays. Neighbor j is node node_ids[j] of grid grids[ sources[j] ],
+ * on property properties[ sources[j] ].
+ */
+struct GRID_DECL Neighbor_batch {
+  std::vector<int> offsets;
+  std::vector<GsTLInt> node_ids;
+  std::vector<unsigned char> sources;
+  std::vector<const Geostat_grid*> grids;
+  std::vector<const GsTLGridProperty*> properties;
+
+  /** valid[i] is what Neighborhood::is_valid() returned after the search
+  * of center i.
+  */
+  std::vector<bool> valid;
+
+  /** Euclidean distance between each neighbor and its center. Only filled
+  * if requested.
+  */
+  std::vector<float> distances;
+
+  void clear();
+  int centers_count() const { return offsets.empty() ? 0 : int( offsets.size() ) - 1; }
+  int size( int center ) const { return offsets[center+1] - offsets[center]; }
+
+  /** Appends neighbor \c node_id of \c grid, on property \c prop, to the
+  * last center.
+  */
+  inline void push_back( const Geostat_grid* grid, const GsTLGridProperty* prop,
+                         GsTLInt node_id );
+};
+
+
+
 /** Neighborhood is the base class for all neighborhood types. 
  */ 
 class GRID_DECL Neighborhood : public SmartPtr_interface<Neighborhood> { 
@@ -96,6 +132,14 @@ class GRID_DECL Neighborhood : public SmartPtr_interface<Neighborhood> {
 
   virtual bool is_valid() { return neigh_filter_->is_neighborhood_valid();}
 
+  /** Tells the neighborhood whether the only nodes of its property that get
+  * informed are the centers of its searches, each one after its search and
+  * before the next search (as along the path of a sequential simulation).
+  * A neighborhood can then index the informed nodes and keep that index up
+  * to date. Turning it on again starts a new index.
+  */
+  virtual void track_simulated_centers( bool on ) {}
+
   /** Set the neighbors to geovalues in range [begin,end). Geovalues of range
   * [begin,end) that are not compatible with the neighborhood are ignored 
   * (a geovalue g is deemed compatible with a neighborhood N if there exists 
@@ -105,11 +149,62 @@ class GRID_DECL Neighborhood : public SmartPtr_interface<Neighborhood> {
   */
   virtual void set_neighbors( const_iterator begin, const_iterator end ) = 0;
 
+  /** Finds the neighbors of nodes \c node_ids[0] to \c node_ids[count-1] 
+  * of \c grid (\c prop is the property of the centers), and stores them
+  * in \c batch, which is cleared first. The centers can belong to another
+  * grid than the neighborhood; they are then located by their coordinates.
+  * If \c with_distances is true, the distances between the neighbors and 
+  * their center are also computed.
+  * The neighbors currently held by the neighborhood are not preserved. As
+  * for find_neighbors, concurrent searches need one neighborhood per thread.
+  */
+  virtual void find_neighbors_batch( Geostat_grid* grid, GsTLGridProperty* prop,
+                                     const GsTLInt* node_ids, int count,
+                                     Neighbor_batch& batch, 
+                                     bool with_distances = false );
+
+  /** Sets the neighbors to those of the \c i-th center of \c batch, 
+  * \c center, so that the neighborhood can be used as if find_neighbors
+  * had just been called on \c center (is_valid() excepted: see 
+  * Neighbor_batch::valid).
+  */
+  void set_batch_neighbors( const Geovalue& center, 
+                            const Neighbor_batch& batch, int i );
+
+ protected: 
+  /** Called by set_batch_neighbors: a neighborhood that keeps its center
+  * must update it.
+  */
+  virtual void set_center( const Geovalue& ) {}
+
+  /** Appends the current neighbors, those of \c center, to \c batch
+  */
+  void append_neighbors( const Geovalue& center, Neighbor_batch& batch, 
+                         bool with_distances ) const;
+
  protected: 
   std::vector<Geovalue> neighbors_; 
   bool includes_center_;
   Search_filter *neigh_filter_;
 }; 
+
+
+
+inline void Neighbor_batch::push_back( const Geostat_grid* grid, 
+                                       const GsTLGridProperty* prop,
+                                       GsTLInt node_id ) {
+  unsigned int source = 0;
+  while( source < grids.size() && 
+         ( grids[source] != grid || properties[source] != prop ) ) source++;
+  if( source == grids.size() ) {
+    grids.push_back( grid );
+    properties.push_back( prop );
+  }
+
+  node_ids.push_back( node_id );
+  sources.push_back( static_cast<unsigned char>( source ) );
+  offsets.back()++;
+}
  
  
  
@@ -172,6 +267,10 @@ class GsTL_neighborhood {
   void search_neighborhood_filter(Search_filter *filter) { 
     neighborhood_->search_neighborhood_filter(filter);
   }
+
+  void track_simulated_centers( bool on ) {
+    neighborhood_->track_simulated_centers( on );
+  }
    
  private: 
   NeighborhoodPtr neighborhood_; 
@@ -264,7 +363,7 @@ class GRID_DECL Grid_template {
 
   void remove_vector( int pos );
 
-  void clear() { templ_.clear(); }
+  void clear() { templ_.clear(); revision_++; }
 
   GsTLInt size() { return templ_.size() ; }  
   void max_size( int s ) { max_size_ = s; } 
@@ -286,11 +385,19 @@ class GRID_DECL Grid_template {
   */
   void undo_scaling();
 
+  /** The revision number changes each time the template vectors are 
+  * changed through the member functions of Grid_template (not when they
+  * are modified through an iterator). It can be used to know if data
+  * computed from the template are still valid.
+  */
+  int revision() const { return revision_; }
+
  private: 
   std::vector<Euclidean_vector> templ_; 
   std::vector<Euclidean_vector> original_; 
   int max_size_; 
   int scale_;
+  int revision_;
 }; 
  
  
@@ -63,6 +63,54 @@ private:
 
 
 
+#ifdef USE_KDTREE2
+/* Neighbor_collector receives the points found by the kd-tree, closest 
+ * first, and adds the admissible ones to the neighbors until there are 
+ * max_neighbors of them. The kd-tree works in the anisotropic space, the
+ * filter is given the displacement in the original space, read from the 
+ * point locations.
+ */
+class Neighbor_collector : public kdtree2_visitor {
+public:
+  Neighbor_collector( std::vector<Geovalue>& neighbors, 
+                      Point_set* pset, GsTLGridProperty* property,
+                      const std::vector<int>& node_ids, 
+                      const Geovalue& center, Search_filter* filter,
+                      int max_neighbors )
+    : neighbors_( neighbors ), pset_( pset ), property_( property ),
+      locations_( pset_->point_locations() ),
+      node_ids_( node_ids ), center_( center ), 
+      center_location_( center.location() ), filter_( filter ),
+      max_neighbors_( max_neighbors ) {}
+
+  virtual bool visit( const kdtree2_result& point ) {
+    if( int( neighbors_.size() ) >= max_neighbors_ ) return false;
+
+    const int node_id = node_ids_[ point.idx ];
+    Geovalue gval( pset_, property_, node_id );
+    const GsTLPoint& loc = locations_[ node_id ];
+    gval.set_cached_location( loc );
+    if( !filter_ || filter_->is_admissible_at( gval, center_, loc - center_location_ ) ) 
+      neighbors_.push_back( gval );
+
+    return int( neighbors_.size() ) < max_neighbors_;
+  }
+
+private:
+  std::vector<Geovalue>& neighbors_;
+  Point_set* pset_;
+  GsTLGridProperty* property_;
+  const std::vector<GsTLPoint>& locations_;
+  const std::vector<int>& node_ids_;
+  const Geovalue& center_;
+  GsTLPoint center_location_;
+  Search_filter* filter_;
+  int max_neighbors_;
+};
+#endif
+
+
+
 #ifdef USE_ANN_KDTREE
 /* This function selects those points of the point set that are informed
 * (for the current property). The locations are stored in locs_, and the
@@ -191,6 +239,9 @@ Point_set_neighborhood::Point_set_neighborhood( double x,double y,double z,
   kdtree_->sort_results = true;
   //kdtree_->set_informatation_property(property_, &idx_);
 
+  if( only_harddata_ && property_ ) property_->informed_mask( informed_ );
+  query_.resize( 3 );
+
 
 #endif
 
@@ -285,6 +336,8 @@ select_property( const std::string& prop_name ) {
     kdtree_->sort_results = true;
   }
 
+  if( only_harddata_ && property_ ) property_->informed_mask( informed_ );
+
 
 #endif
 
@@ -379,51 +432,27 @@ void Point_set_neighborhood::find_neighbors(const Geovalue& center) {
 
 
 #ifdef USE_KDTREE2
+  // Single best-first search in the anisotropy-transformed space: the 
+  // points are visited by increasing distance, the uninformed ones are
+  // skipped by the tree, and the search stops as soon as max_neighbors_ 
+  // admissible neighbors are found. 
   location_type loc = (*coord_transform_)(center.location());
-  double a2 = a_*a_;
-  std::vector<GsTLCoord> center_node;
-  center_node.push_back(loc[0]);
-  center_node.push_back(loc[1]);
-  center_node.push_back(loc[2]);
-
-  kdtree2_result_vector nearest;
-
-  if(use_n_closest_) {
- 
-    kdtree_->n_nearest(center_node, max_neighbors_, nearest);
-
-    for (unsigned int i=0; i<nearest.size(); i++) {
-      if(nearest[i].dis < a2 ) 
-         neighbors_.push_back( Geovalue( pset_, property_, idx_[nearest[i].idx] ) );
-    }
-  }
-  else {
-
-    kdtree_->r_nearest(center_node, a2, nearest);
-    int n_neigh = 0;
-    for (unsigned int i=0; i<nearest.size()&& n_neigh < max_neighbors_; i++) {
-      int node_id = idx_[nearest[i].idx];
-  //    if(property_->is_informed(id) ) {
-        Geovalue gval( pset_, property_, node_id );
-        if(neigh_filter_->is_admissible(gval, center)) {
-          neighbors_.push_back( gval );
-          n_neigh++;
-        }
-   //     neighbors_.push_back( Geovalue( pset_, property_, node_id ) );
-   //     n_neigh++;
-    //  }
-    }
-  }
-
-  std::sort(neighbors_.begin(), neighbors_.end(),
-          Covariance_distance_( center.location(), *cov_ ) );
-/*  
-  if( neigh_filter_->is_neighborhood_valid() ) 
+  query_[0] = loc[0];
+  query_[1] = loc[1];
+  query_[2] = loc[2];
+
+  // the default filter accepts all the neighbors
+  Neighbor_collector collector( neighbors_, pset_, property_, idx_, center, 
+                                use_n_closest_ ? 0 : neigh_filter_, 
+                                max_neighbors_ );
+  kdtree_->nearest_first( query_, a_*a_, collector, 
+                          only_harddata_ ? &informed_ : 0 );
+
+  // the neighbors are sorted by anisotropic distance, the covariance can 
+  // have a different anisotropy
+  if( cov_ )
     std::sort(neighbors_.begin(), neighbors_.end(),
-          Covariance_distance_( center.location(), *cov_ ) );
-  else
-    neighbors_.clear();
-*/
+            Covariance_distance_( center.location(), *cov_ ) );
 #endif
 
 }
@@ -37,6 +37,7 @@
 #include <GsTLAppli/grid/grid_model/superblock.h> 
 #include <GsTLAppli/math/gstlvector.h> 
 #include <GsTLAppli/grid/grid_model/gstl_kdtree2.h>
+#include <GsTLAppli/grid/grid_model/bit_flags.h>
 
 #include <GsTL/geometry/geometry_algorithms.h> 
 #include <GsTL/geometry/covariance.h> 
@@ -91,6 +92,9 @@ public:
   virtual void set_neighbors( const_iterator begin, const_iterator end );
 
 
+protected: 
+  virtual void set_center( const Geovalue& center ) { center_ = center; }
+
 protected: 
   Point_set* pset_;   
   GsTLGridProperty* property_; 
@@ -148,6 +152,13 @@ protected:
 
   bool use_n_closest_;
 
+  // If the property only contains hard data, its values do not change 
+  // during the searches: the informed flags are then read once.
+  Bit_flags informed_;
+
+  // the transformed location of the center, kept to avoid allocations
+  std::vector<GsTLCoord> query_;
+
 #endif
 
 };     
@@ -40,6 +40,181 @@
 #include <algorithm>
 #include <cmath>
 
+
+// Returns the array of values of property \c prop, or 0 if the values
+// are not available as a single array (the property was swapped to disk).
+static inline const float* values_array( const GsTLGridProperty* prop ) {
+#ifndef SGEMS_ACCESSOR_LARGE_FILE
+  return prop->data();
+#else
+  return 0;
+#endif
+}
+
+static inline bool node_is_informed( const float* values, 
+                                     const GsTLGridProperty* prop,
+                                     GsTLInt node_id ) {
+  if( values ) return values[ node_id ] != GsTLGridProperty::no_data_value;
+  return prop->is_informed( node_id );
+}
+
+
+
+//=====================================
+//    Template offsets
+//=====================================
+
+Template_offsets::Template_offsets()
+  : revision_( -1 ) {
+  for( int d = 0; d < 3; d++ ) {
+    min_[d] = max_[d] = 0;
+    dims_[d] = spacing_[d] = 0;
+  }
+}
+
+
+void Template_offsets::init( const Grid_template& templ, 
+                             const SGrid_cursor& cursor ) {
+  revision_ = templ.revision();
+  dims_[0] = cursor.max_iter( SGrid_cursor::X );
+  dims_[1] = cursor.max_iter( SGrid_cursor::Y );
+  dims_[2] = cursor.max_iter( SGrid_cursor::Z );
+  spacing_[0] = cursor.multigrid_spacing_x();
+  spacing_[1] = cursor.multigrid_spacing_y();
+  spacing_[2] = cursor.multigrid_spacing_z();
+
+  offsets_.clear();
+  for( int d = 0; d < 3; d++ ) 
+    min_[d] = max_[d] = 0;
+
+  // the node-id increments for one step in each direction. If the grid
+  // has a single node in a direction, no interior node can have a 
+  // neighbor in that direction, and the increment is never used.
+  GsTLInt steps[3];
+  const GsTLInt origin_id = cursor.node_id( 0,0,0 );
+  steps[0] = dims_[0] > 1 ? cursor.node_id( 1,0,0 ) - origin_id : 0;
+  steps[1] = dims_[1] > 1 ? cursor.node_id( 0,1,0 ) - origin_id : 0;
+  steps[2] = dims_[2] > 1 ? cursor.node_id( 0,0,1 ) - origin_id : 0;
+
+  offsets_.reserve( templ.end() - templ.begin() );
+  for( Grid_template::const_iterator it = templ.begin(); it != templ.end(); ++it ) {
+    const Grid_template::Euclidean_vector& vec = *it;
+    for( int d = 0; d < 3; d++ ) {
+      min_[d] = std::min( min_[d], GsTLInt( vec[d] ) );
+      max_[d] = std::max( max_[d], GsTLInt( vec[d] ) );
+    }
+    offsets_.push_back( vec[0]*steps[0] + vec[1]*steps[1] + vec[2]*steps[2] );
+  }
+}
+
+
+bool Template_offsets::is_up_to_date( const Grid_template& templ, 
+                                      const SGrid_cursor& cursor ) const {
+  return revision_ == templ.revision() &&
+         int( offsets_.size() ) == int( templ.end() - templ.begin() ) &&
+         spacing_[0] == cursor.multigrid_spacing_x() &&
+         spacing_[1] == cursor.multigrid_spacing_y() &&
+         spacing_[2] == cursor.multigrid_spacing_z() &&
+         dims_[0] == cursor.max_iter( SGrid_cursor::X ) &&
+         dims_[1] == cursor.max_iter( SGrid_cursor::Y ) &&
+         dims_[2] == cursor.max_iter( SGrid_cursor::Z );
+}
+
+
+
+//=====================================
+//    Informed blocks
+//=====================================
+
+Informed_blocks::Informed_blocks()
+  : property_( 0 ) {
+  for( int d = 0; d < 3; d++ ) 
+    dims_[d] = nblocks_[d] = 0;
+}
+
+
+void Informed_blocks::init( const GsTLGridProperty* prop, 
+                            const SGrid_cursor& cursor,
+                            GsTLInt nx, GsTLInt ny, GsTLInt nz ) {
+  property_ = prop;
+  cursor_ = cursor;
+  dims_[0] = nx;
+  dims_[1] = ny;
+  dims_[2] = nz;
+  for( int d = 0; d < 3; d++ ) 
+    nblocks_[d] = ( dims_[d] + block_size - 1 ) / block_size;
+
+  blocks_.clear();
+  blocks_.resize( nblocks_[0]*nblocks_[1]*nblocks_[2] );
+
+  prop->informed_mask( indexed_ );
+  for( GsTLInt id = indexed_.find_first(); id < indexed_.size(); 
+       id = indexed_.find_next( id ) ) {
+    int i,j,k;
+    cursor_.fine_coords( id, i, j, k );
+    blocks_[ block_id( i/block_size, j/block_size, k/block_size ) ].push_back( id );
+  }
+}
+
+
+void Informed_blocks::clear() {
+  property_ = 0;
+  std::vector< std::vector<GsTLInt> >().swap( blocks_ );
+  indexed_.resize( 0 );
+}
+
+
+void Informed_blocks::update( GsTLInt node_id ) {
+  if( indexed_.test( node_id ) || !property_->is_informed( node_id ) ) return;
+
+  indexed_.set( node_id );
+  int i,j,k;
+  cursor_.fine_coords( node_id, i, j, k );
+  blocks_[ block_id( i/block_size, j/block_size, k/block_size ) ].push_back( node_id );
+}
+
+
+bool Informed_blocks::block_range( const GsTLInt lo[3], const GsTLInt hi[3],
+                                   GsTLInt first[3], GsTLInt last[3] ) const {
+  for( int d = 0; d < 3; d++ ) {
+    if( hi[d] < 0 || lo[d] >= dims_[d] ) return false;
+    first[d] = std::max( lo[d], GsTLInt(0) ) / block_size;
+    last[d] = std::min( hi[d], dims_[d]-1 ) / block_size;
+  }
+  return true;
+}
+
+
+GsTLInt Informed_blocks::count( const GsTLInt lo[3], const GsTLInt hi[3],
+                                GsTLInt limit ) const {
+  GsTLInt first[3], last[3];
+  if( !block_range( lo, hi, first, last ) ) return 0;
+
+  GsTLInt n = 0;
+  for( GsTLInt bk = first[2]; bk <= last[2]; bk++ ) 
+    for( GsTLInt bj = first[1]; bj <= last[1]; bj++ ) 
+      for( GsTLInt bi = first[0]; bi <= last[0]; bi++ ) {
+        n += blocks_[ block_id( bi, bj, bk ) ].size();
+        if( n > limit ) return n;
+      }
+  return n;
+}
+
+
+void Informed_blocks::nodes( const GsTLInt lo[3], const GsTLInt hi[3],
+                             std::vector<GsTLInt>& ids ) const {
+  GsTLInt first[3], last[3];
+  if( !block_range( lo, hi, first, last ) ) return;
+
+  for( GsTLInt bk = first[2]; bk <= last[2]; bk++ ) 
+    for( GsTLInt bj = first[1]; bj <= last[1]; bj++ ) 
+      for( GsTLInt bi = first[0]; bi <= last[0]; bi++ ) {
+        const std::vector<GsTLInt>& block = blocks_[ block_id( bi, bj, bk ) ];
+        ids.insert( ids.end(), block.begin(), block.end() );
+      }
+}
+
+
 //=====================================
 //    Window Neighborhood
 //=====================================
@@ -132,6 +307,27 @@ void Rgrid_window_neighborhood::find_neighbors( const Geovalue& center ) {
 
   if( geom_.size() == 0 ) return;
 
+  if( !offsets_.is_up_to_date( geom_, cursor_ ) )
+    offsets_.init( geom_, cursor_ );
+
+  if( offsets_.is_up_to_date( geom_, cursor ) && 
+      offsets_.is_interior( center_location ) ) {
+    // The whole window is inside the grid: the node-ids of the window nodes
+    // are obtained by adding the template offsets to the center's node-id
+    const GsTLInt center_id = cursor_.node_id( i,j,k );
+    const float* values = values_array( property_ );
+
+    // trailing un-informed nodes are discarded, the first node is kept
+    int n = geom_.end() - geom_.begin();
+    while( n > 1 && 
+           !node_is_informed( values, property_, center_id + offsets_[n-1] ) )
+      n--;
+
+    for( int m = 0; m < n; m++ ) 
+      neighbors_.push_back( Geovalue( grid_, property_, center_id + offsets_[m] ) );
+    return;
+  }
+
   Grid_template::iterator begin = geom_.begin();
   Grid_template::iterator bound = geom_.end()-1;
   /* nico: old code, remove if new works properly
@@ -189,6 +385,18 @@ void Rgrid_window_neighborhood::find_all_neighbors( const Geovalue& center ) {
 
   if( geom_.size() == 0 ) return;
 
+  if( !offsets_.is_up_to_date( geom_, cursor_ ) )
+    offsets_.init( geom_, cursor_ );
+
+  if( offsets_.is_up_to_date( geom_, cursor ) && 
+      offsets_.is_interior( center_location ) ) {
+    const GsTLInt center_id = cursor_.node_id( i,j,k );
+    const int n = geom_.end() - geom_.begin();
+    for( int m = 0; m < n; m++ ) 
+      neighbors_.push_back( Geovalue( grid_, property_, center_id + offsets_[m] ) );
+    return;
+  }
+
   Grid_template::iterator begin = geom_.begin();
   Grid_template::iterator bound = geom_.end()-1;
 
@@ -251,7 +459,11 @@ Rgrid_ellips_neighborhood( RGrid* grid,
   : Neighborhood(),
     grid_( grid ),
     property_( property ),
-    max_neighbors_( max_neighbors ) {
+    max_neighbors_( max_neighbors ),
+    octant_filter_( 0 ),
+    track_centers_( false ),
+    last_center_( -1 ),
+    ranks_revision_( -1 ) {
   
   appli_assert( grid_ );
 
@@ -297,9 +509,153 @@ select_property( const std::string& prop_name ) {
   return ( property_ != 0 );
 }
 
+void Rgrid_ellips_neighborhood::
+search_neighborhood_filter( Search_filter* filter ) {
+  Neighborhood::search_neighborhood_filter( filter );
+  octant_filter_ = 0;
+  if( neigh_filter_ && neigh_filter_->class_name() == "Octant_search_filter" )
+    octant_filter_ = static_cast<Octant_search_filter*>( neigh_filter_ );
+  template_octants_.clear();
+}
+
+void Rgrid_ellips_neighborhood::update_offsets() {
+  if( offsets_.is_up_to_date( geom_, cursor_ ) ) return;
+  offsets_.init( geom_, cursor_ );
+  template_octants_.clear();
+}
+
+void Rgrid_ellips_neighborhood::track_simulated_centers( bool on ) {
+  track_centers_ = on;
+  informed_blocks_.clear();
+  last_center_ = -1;
+}
 
-/* This function could be optimized by directly using the property values 
- * array, hence bypassing the virtual function calls in GsTLGridProperty.
+/* The index is built at the first search, once the nodes known before the
+ * simulation (eg hard data) are informed. Then the previous center is 
+ * added to the index: it has been simulated since it was searched.
+ */
+void Rgrid_ellips_neighborhood::update_informed_blocks( const Geovalue& center ) {
+  if( informed_blocks_.property() != property_ ) 
+    informed_blocks_.init( property_, cursor_, 
+                           grid_->nx(), grid_->ny(), grid_->nz() );
+  else if( last_center_ >= 0 )
+    informed_blocks_.update( last_center_ );
+
+  last_center_ = ( center.grid() == grid_ ) ? center.node_id() : -1;
+}
+
+void Rgrid_ellips_neighborhood::init_template_ranks() {
+  const Grid_template& templ = geom_;
+  ranks_revision_ = templ.revision();
+
+  GsTLInt max[3];
+  for( int d = 0; d < 3; d++ ) 
+    ranks_min_[d] = max[d] = 0;
+  for( Grid_template::const_iterator it = templ.begin(); it != templ.end(); ++it ) 
+    for( int d = 0; d < 3; d++ ) {
+      ranks_min_[d] = std::min( ranks_min_[d], GsTLInt( (*it)[d] ) );
+      max[d] = std::max( max[d], GsTLInt( (*it)[d] ) );
+    }
+  for( int d = 0; d < 3; d++ ) 
+    ranks_dims_[d] = max[d] - ranks_min_[d] + 1;
+
+  template_ranks_.assign( ranks_dims_[0]*ranks_dims_[1]*ranks_dims_[2], -1 );
+  int rank = 0;
+  for( Grid_template::const_iterator it = templ.begin(); it != templ.end(); 
+       ++it, ++rank ) {
+    GsTLInt cell = ( (*it)[0] - ranks_min_[0] ) + 
+      ranks_dims_[0]*( ( (*it)[1] - ranks_min_[1] ) + 
+                       ranks_dims_[1]*( (*it)[2] - ranks_min_[2] ) );
+    if( template_ranks_[cell] < 0 ) template_ranks_[cell] = rank;
+  }
+}
+
+/* Scanning the template until max_neighbors_ nodes are found costs about 
+ * n*max_neighbors_/c node checks if c of the n template nodes are informed,
+ * while sorting the c indexed candidates costs about c. The indexed nodes 
+ * are used if c*c < n*max_neighbors_. The neighbors are the same in both
+ * cases: the informed nodes of the template, in the template order.
+ */
+bool Rgrid_ellips_neighborhood::
+find_sparse_neighbors( const Geovalue& center, const GsTLGridNode& loc,
+                       int already_found, int n ) {
+  if( ranks_revision_ != geom_.revision() || template_ranks_.empty() ) 
+    init_template_ranks();
+
+  // the template's bounding box around the center, in the finest grid
+  const GsTLInt spacing[3] = { cursor_.multigrid_spacing_x(), 
+                               cursor_.multigrid_spacing_y(), 
+                               cursor_.multigrid_spacing_z() };
+  GsTLInt origin[3], lo[3], hi[3];
+  for( int d = 0; d < 3; d++ ) {
+    origin[d] = loc[d] * spacing[d];
+    lo[d] = origin[d] + ranks_min_[d] * spacing[d];
+    hi[d] = origin[d] + ( ranks_min_[d] + ranks_dims_[d] - 1 ) * spacing[d];
+  }
+
+  const double limit = std::sqrt( double( n ) * double( max_neighbors_ ) );
+  if( informed_blocks_.count( lo, hi, GsTLInt( limit ) ) >= limit ) 
+    return false;
+
+  sparse_ids_.clear();
+  informed_blocks_.nodes( lo, hi, sparse_ids_ );
+
+  sparse_candidates_.clear();
+  const float* values = values_array( property_ );
+  for( unsigned int c = 0; c < sparse_ids_.size(); c++ ) {
+    int ijk[3];
+    informed_blocks_.coords( sparse_ids_[c], ijk[0], ijk[1], ijk[2] );
+
+    // the template vector from the center to the node, if there is one
+    GsTLInt cell = 0;
+    GsTLInt stride = 1;
+    bool in_template = true;
+    for( int d = 0; d < 3 && in_template; d++ ) {
+      GsTLInt delta = ijk[d] - origin[d];
+      if( delta % spacing[d] != 0 ) { in_template = false; break; }
+      GsTLInt v = delta / spacing[d] - ranks_min_[d];
+      if( v < 0 || v >= ranks_dims_[d] ) { in_template = false; break; }
+      cell += v * stride;
+      stride *= ranks_dims_[d];
+    }
+    if( !in_template ) continue;
+
+    const int rank = template_ranks_[cell];
+    if( rank < 0 || rank >= n ) continue;
+    if( !node_is_informed( values, property_, sparse_ids_[c] ) ) continue;
+    sparse_candidates_.push_back( std::make_pair( rank, sparse_ids_[c] ) );
+  }
+
+  std::sort( sparse_candidates_.begin(), sparse_candidates_.end() );
+  for( unsigned int c = 0; 
+       c < sparse_candidates_.size() && already_found < max_neighbors_; c++ ) {
+    Geovalue gval( grid_, property_, sparse_candidates_[c].second );
+    if(neigh_filter_->is_admissible(gval, center)) {
+      neighbors_.push_back( gval );
+      already_found++;
+    }
+  }
+  return true;
+}
+
+/* The displacement from a node to its translate by a template vector is
+ * the same for all the nodes (the grid geometry is affine in i,j,k), hence
+ * it is computed at the first interior node searched.
+ */
+void Rgrid_ellips_neighborhood::
+compute_template_octants( GsTLInt center_id, int n ) {
+  template_octants_.resize( n );
+  const GsTLPoint origin = grid_->location( center_id );
+  for( int m = 0; m < n; m++ ) 
+    template_octants_[m] = 
+      octant_filter_->octant( grid_->location( center_id + offsets_[m] ) - origin );
+}
+
+
+/* If the whole ellipsoid is inside the grid, the neighbors are found by
+ * adding the template offsets to the center's node-id, and reading the 
+ * property values array directly. Otherwise each node of the ellipsoid is
+ * checked. 
  */
 void Rgrid_ellips_neighborhood::find_neighbors( const Geovalue& center ) {
   neighbors_.clear();
@@ -307,6 +663,8 @@ void Rgrid_ellips_neighborhood::find_neighbors( const Geovalue& center ) {
   if( !property_ ) return;
 
   center_ = center;
+  if( track_centers_ ) 
+    update_informed_blocks( center );
 //  center_.set_property_array( property_ );
 
   // "already_found" is the number of neighbors already found
@@ -348,6 +706,46 @@ void Rgrid_ellips_neighborhood::find_neighbors( const Geovalue& center ) {
   Grid_template::const_iterator it = geom_.begin();
   Grid_template::const_iterator end = geom_.end();
 
+  update_offsets();
+
+  if( track_centers_ && 
+      find_sparse_neighbors( center, loc, already_found, end - it ) ) 
+    return;
+
+  if( offsets_.is_interior( loc ) ) {
+    // interior node: all the nodes of the ellipsoid are inside the grid
+    const GsTLInt center_id = cursor_.node_id( loc[0], loc[1], loc[2] );
+    const float* values = values_array( property_ );
+    const int n = end - it;
+
+    if( octant_filter_ && center.grid() == grid_ ) {
+      if( int( template_octants_.size() ) < n ) 
+        compute_template_octants( center_id, n );
+      for( int m = 0; m < n && already_found < max_neighbors_; m++ ) {
+        GsTLInt id = center_id + offsets_[m];
+        if( !node_is_informed( values, property_, id ) ) continue;
+
+        if( octant_filter_->admit_octant( template_octants_[m] ) ) {
+          neighbors_.push_back( Geovalue( grid_, property_, id ) );
+          already_found++;
+        }
+      }
+      return;
+    }
+
+    for( int m = 0; m < n && already_found < max_neighbors_; m++ ) {
+      GsTLInt id = center_id + offsets_[m];
+      if( !node_is_informed( values, property_, id ) ) continue;
+
+      Geovalue gval( grid_, property_, id );
+      if(neigh_filter_->is_admissible(gval, center)) {
+        neighbors_.push_back( gval );
+        already_found++;
+      }
+    }
+    return;
+  }
+
   while( it != end && already_found < max_neighbors_ ) {
     GsTLGridNode node = loc + (*it);
     GsTLInt node_id = cursor_.node_id( node[0], node[1], node[2] );
@@ -433,6 +831,66 @@ void Rgrid_ellips_neighborhood::find_neighbors( const Geovalue& center ) {
 */
 
 
+void Rgrid_ellips_neighborhood::
+find_neighbors_batch( Geostat_grid* grid, GsTLGridProperty* prop,
+                      const GsTLInt* node_ids, int count,
+                      Neighbor_batch& batch, bool with_distances ) {
+  // a search filter needs to check each neighbor as a geovalue, and the
+  // simulated centers must be indexed one at a time by find_neighbors
+  if( grid != grid_ || !property_ || track_centers_ ||
+      neigh_filter_->class_name() != "Search_filter" ) {
+    Neighborhood::find_neighbors_batch( grid, prop, node_ids, count, 
+                                        batch, with_distances );
+    return;
+  }
+
+  batch.clear();
+  batch.offsets.reserve( count+1 );
+
+  update_offsets();
+  const float* values = values_array( property_ );
+  const int n = geom_.end() - geom_.begin();
+
+  for( int i = 0; i < count; i++ ) {
+    const GsTLInt center_id = node_ids[i];
+    GsTLGridNode loc;
+    cursor_.coords( center_id, loc[0], loc[1], loc[2] ); 
+
+    if( !offsets_.is_interior( loc ) ) {
+      Geovalue center( grid, prop, center_id );
+      find_neighbors( center );
+      append_neighbors( center, batch, with_distances );
+      batch.valid.push_back( is_valid() );
+      continue;
+    }
+
+    // same search as the interior case of find_neighbors
+    batch.offsets.push_back( batch.offsets.back() );
+    batch.valid.push_back( true );
+    const int first = batch.node_ids.size();
+    int already_found = 0;
+    if( includes_center_ && node_is_informed( values, property_, center_id ) ) {
+      batch.push_back( grid_, property_, center_id );
+      already_found++;
+    }
+    for( int m = 0; m < n && already_found < max_neighbors_; m++ ) {
+      GsTLInt id = center_id + offsets_[m];
+      if( !node_is_informed( values, property_, id ) ) continue;
+
+      batch.push_back( grid_, property_, id );
+      already_found++;
+    }
+
+    if( with_distances ) {
+      GsTLPoint center_loc = grid_->location( center_id );
+      for( unsigned int j = first; j < batch.node_ids.size(); j++ ) 
+        batch.distances.push_back( std::sqrt( 
+          square_euclidean_distance( grid_->location( batch.node_ids[j] ), center_loc ) ) );
+    }
+  }
+}
+
+
 void Rgrid_ellips_neighborhood::
 set_neighbors( const_iterator begin, const_iterator end ) {
   neighbors_.clear();
@@ -510,6 +968,21 @@ void Rgrid_ellips_neighborhood_hd::find_neighbors( const Geovalue& center ) {
   Grid_template::const_iterator it = geom_.begin();
   Grid_template::const_iterator end = geom_.end();
 
+  update_offsets();
+
+  if( offsets_.is_interior( loc ) ) {
+    const GsTLInt center_id = cursor_.node_id( loc[0], loc[1], loc[2] );
+    const int n = end - it;
+    for( int m = 0; m < n && already_found < max_neighbors_; m++ ) {
+      GsTLInt id = center_id + offsets_[m];
+      if( property_->is_harddata( id ) ) {
+        neighbors_.push_back( Geovalue( grid_, property_, id ) );
+        already_found++;
+      }
+    }
+    return;
+  }
+
   while( it != end && already_found < max_neighbors_ ) {
     GsTLGridNode node = loc + (*it);
     GsTLInt node_id = cursor_.node_id( node[0], node[1], node[2] );
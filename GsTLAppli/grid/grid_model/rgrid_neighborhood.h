@@ -34,6 +34,7 @@
 #include <GsTLAppli/math/gstlpoint.h> 
 #include <GsTLAppli/grid/grid_model/neighborhood.h> 
 #include <GsTLAppli/grid/grid_model/sgrid_cursor.h> 
+#include <GsTLAppli/grid/grid_model/bit_flags.h> 
 //#include <GsTLAppli/grid/maskgridcursor.h> 
  
 #include <GsTL/geometry/geometry_algorithms.h> 
@@ -47,6 +48,136 @@ class GsTLGridProperty;
  
 
 
+//===================================== 
+//    Template offsets
+//===================================== 
+
+/** Template_offsets stores, for each vector of a Grid_template, the 
+* difference between the node-id of a node and the node-id of the node
+* translated by that vector. With the linear node layout, that difference
+* does not depend on the node, as long as the translated template is 
+* entirely inside the grid (the node is then an "interior" node): the 
+* neighbors of an interior node can be found without computing and 
+* checking the coordinates of each of them.
+* The offsets are computed for a given multigrid level and node layout of
+* the grid cursor.
+*/
+class GRID_DECL Template_offsets { 
+ public: 
+  Template_offsets(); 
+
+  /** Computes the offsets of the vectors of \c templ (all of them, 
+  * whatever the max size of \c templ) in the grid of \c cursor.
+  */
+  void init( const Grid_template& templ, const SGrid_cursor& cursor ); 
+
+  /** Returns true if the offsets were computed from the current version 
+  * of \c templ, for the current multigrid level of \c cursor.
+  */
+  bool is_up_to_date( const Grid_template& templ, 
+                      const SGrid_cursor& cursor ) const; 
+
+  /** Returns true if node \c loc (i,j,k coordinates in the current 
+  * multigrid) and all its translates by the template vectors are inside 
+  * the grid. 
+  */
+  bool is_interior( const GsTLGridNode& loc ) const { 
+    return loc[0] + min_[0] >= 0 && loc[0] + max_[0] < dims_[0] && 
+           loc[1] + min_[1] >= 0 && loc[1] + max_[1] < dims_[1] && 
+           loc[2] + min_[2] >= 0 && loc[2] + max_[2] < dims_[2]; 
+  } 
+
+  /** The offset of the n-th vector of the template 
+  */
+  GsTLInt operator[]( int n ) const { return offsets_[n]; } 
+
+ private: 
+  std::vector<GsTLInt> offsets_; 
+
+  // bounding box of the template. It always includes (0,0,0), so that
+  // an interior node is inside the grid.
+  GsTLInt min_[3], max_[3]; 
+
+  // the grid cursor state the offsets were computed for
+  GsTLInt dims_[3]; 
+  GsTLInt spacing_[3]; 
+  int revision_; 
+}; 
+
+
+
+//===================================== 
+//    Informed blocks
+//===================================== 
+
+/** Informed_blocks is a coarse index of the informed nodes of a property 
+* of a regular grid: the grid is divided into blocks of block_size^3 nodes
+* and each block keeps the list of its informed nodes. A search in a nearly
+* empty grid can then visit only the informed nodes of the non-empty blocks
+* that overlap the search ellipsoid, instead of every node of the ellipsoid.
+* The index is not notified when a node gets informed: update() must be 
+* called for each such node.
+* All the i,j,k coordinates are coordinates in the finest grid.
+*/
+class GRID_DECL Informed_blocks { 
+ public: 
+  enum { block_size = 8 };
+
+  Informed_blocks(); 
+
+  /** Indexes the informed nodes of \c prop. The grid has \c nx*ny*nz 
+  * nodes, laid out as defined by \c cursor.
+  */
+  void init( const GsTLGridProperty* prop, const SGrid_cursor& cursor,
+             GsTLInt nx, GsTLInt ny, GsTLInt nz ); 
+  void clear(); 
+
+  /** The property indexed, 0 if the index is not initialized
+  */
+  const GsTLGridProperty* property() const { return property_; }
+
+  /** Adds node \c node_id to the index if it is informed and not already 
+  * indexed.
+  */
+  void update( GsTLInt node_id ); 
+
+  /** Returns the number of nodes indexed in the blocks that overlap box
+  * [lo,hi] (bounds included). The count stops as soon as it exceeds 
+  * \c limit.
+  */
+  GsTLInt count( const GsTLInt lo[3], const GsTLInt hi[3], GsTLInt limit ) const; 
+
+  /** Appends to \c ids the nodes indexed in the blocks that overlap box
+  * [lo,hi]. Some of these nodes can be outside the box.
+  */
+  void nodes( const GsTLInt lo[3], const GsTLInt hi[3], 
+              std::vector<GsTLInt>& ids ) const; 
+
+  void coords( GsTLInt node_id, int& i, int& j, int& k ) const {
+    cursor_.fine_coords( node_id, i, j, k );
+  }
+
+ private: 
+  // range of blocks [first,last] overlapping box [lo,hi]. Returns false 
+  // if the box is outside the grid.
+  bool block_range( const GsTLInt lo[3], const GsTLInt hi[3], 
+                    GsTLInt first[3], GsTLInt last[3] ) const; 
+  GsTLInt block_id( GsTLInt bi, GsTLInt bj, GsTLInt bk ) const {
+    return bi + nblocks_[0]*( bj + nblocks_[1]*bk );
+  }
+
+ private: 
+  const GsTLGridProperty* property_; 
+  SGrid_cursor cursor_; 
+  GsTLInt dims_[3]; 
+  GsTLInt nblocks_[3]; 
+  std::vector< std::vector<GsTLInt> > blocks_; 
+  Bit_flags indexed_; 
+}; 
+
+ 
+
+
 //===================================== 
 //    Window Neighborhood 
 //===================================== 
@@ -89,12 +220,16 @@ public:
  
   virtual void set_neighbors( const_iterator begin, const_iterator end );
 
+ protected: 
+  virtual void set_center( const Geovalue& center ) { center_ = center; size_ = -1; }
+
  protected: 
   RGrid* grid_; 
   GsTLGridProperty* property_; 
 //  Grid_template geom_; 
   Geovalue center_; 
   SGrid_cursor cursor_; 
+  Template_offsets offsets_;
 
   mutable int size_;
 }; 
@@ -136,6 +271,44 @@ public:
  
   virtual void set_neighbors( const_iterator begin, const_iterator end );
 
+  /** The neighbors of the interior nodes of the grid are written straight
+  * to \c batch, without creating geovalues, unless a search filter is set
+  * or the simulated centers are tracked.
+  */
+  virtual void find_neighbors_batch( Geostat_grid* grid, GsTLGridProperty* prop,
+                                     const GsTLInt* node_ids, int count,
+                                     Neighbor_batch& batch, 
+                                     bool with_distances = false );
+
+  /** With an octant filter, the octant of each template vector is computed
+  * once and the neighbors of the interior nodes are binned without 
+  * computing their displacement from the center.
+  */
+  virtual void search_neighborhood_filter( Search_filter* filter );
+  Search_filter* search_neighborhood_filter() { return neigh_filter_; }
+
+  /** While the centers are tracked, the informed nodes are indexed by 
+  * blocks (see Informed_blocks). A search that finds few indexed nodes 
+  * around its center only checks those nodes, instead of scanning the 
+  * whole ellipsoid.
+  */
+  virtual void track_simulated_centers( bool on );
+
+
+ protected: 
+  void update_offsets();
+  void compute_template_octants( GsTLInt center_id, int n );
+
+  void update_informed_blocks( const Geovalue& center );
+  void init_template_ranks();
+
+  /** Finds the neighbors among the indexed nodes around \c loc, if there
+  * are few enough of them. Returns false if the template must be scanned.
+  */
+  bool find_sparse_neighbors( const Geovalue& center, const GsTLGridNode& loc,
+                              int already_found, int n );
+
+  virtual void set_center( const Geovalue& center ) { center_ = center; }
 
  protected: 
   RGrid* grid_; 
@@ -144,7 +317,29 @@ public:
   Grid_template geom_; 
   int max_neighbors_; 
   Geovalue center_; 
- 
+  Template_offsets offsets_;
+
+  // set if the search filter is an Octant_search_filter. 
+  // template_octants_[m] is the octant of the m-th template vector, it is 
+  // emptied whenever the offsets or the filter change.
+  Octant_search_filter* octant_filter_;
+  std::vector<int> template_octants_;
+
+  // the index of the informed nodes and the last center searched, which is
+  // indexed at the next search, once it has been simulated
+  bool track_centers_;
+  Informed_blocks informed_blocks_;
+  GsTLInt last_center_;
+
+  // template_ranks_ gives the rank in the template of each vector of the
+  // template's bounding box, or -1 if the vector is not in the template.
+  std::vector<int> template_ranks_;
+  GsTLInt ranks_min_[3], ranks_dims_[3];
+  int ranks_revision_;
+
+  // scratch buffers of the sparse search
+  std::vector<GsTLInt> sparse_ids_;
+  std::vector< std::pair<int,GsTLInt> > sparse_candidates_;
 }; 
  
 
@@ -166,6 +361,14 @@ public:
   ~Rgrid_ellips_neighborhood_hd() {}; 
  
   virtual void find_neighbors( const Geovalue& center ); 
+
+  virtual void find_neighbors_batch( Geostat_grid* grid, GsTLGridProperty* prop,
+                                     const GsTLInt* node_ids, int count,
+                                     Neighbor_batch& batch, 
+                                     bool with_distances = false ) {
+    Neighborhood::find_neighbors_batch( grid, prop, node_ids, count, 
+                                        batch, with_distances );
+  }
 }; 
  
  
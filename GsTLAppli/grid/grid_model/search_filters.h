@@ -63,9 +63,19 @@ public :
 
 class Search_filter {
 public:
+    typedef Geovalue::location_type::difference_type Vector3D;
+
     Search_filter(){}
     virtual ~Search_filter(){}
     virtual bool is_admissible( const Geovalue& neigh, const Geovalue& center){return true;}
+
+    /** Same as is_admissible( neigh, center ), for a search that already 
+    * knows the displacement \c delta from the center to the neighbor.
+    */
+    virtual bool is_admissible_at( const Geovalue& neigh, const Geovalue& center,
+                                   const Vector3D& delta ) {
+      return is_admissible( neigh, center );
+    }
     virtual bool is_neighborhood_valid() {return true;}
     virtual void clear(){}
     virtual std::string class_name(){return "Search_filter";} 
@@ -103,6 +113,7 @@ class Octant_search_filter : public Search_filter{
       min_octant_ = o.min_octant_;
       min_per_octant_ = o.min_per_octant_;
       max_per_octant_ = o.max_per_octant_;
+      octant_registrar_ = o.octant_registrar_;
     }
 
     ~Octant_search_filter(){delete coord_transform_;}
@@ -116,13 +127,27 @@ class Octant_search_filter : public Search_filter{
     virtual std::string class_name(){return "Octant_search_filter";} 
 
     virtual bool is_admissible( const Geovalue& gval, const Geovalue& center) {
-      Vector3D delta_d = gval.location() - center.location();
+      return admit_octant( octant( gval.location() - center.location() ) );
+    }
+
+    virtual bool is_admissible_at( const Geovalue& gval, const Geovalue& center,
+                                   const Vector3D& delta ) {
+      return admit_octant( octant( delta ) );
+    }
+
+    /** Returns the octant, in [0,8), of displacement \c delta_d. Searches 
+    * whose displacements do not change from one center to the next (the 
+    * template of a regular grid) can compute the octants once.
+    */
+    int octant( Vector3D delta_d ) const {
       if(coord_transform_) delta_d  = (*coord_transform_)(delta_d);
-      
-      octant_id octant(delta_d[0] >= 0.,delta_d[1] >= 0.,delta_d[2] >= 0.);
+      return int(delta_d[0] >= 0.) + int(delta_d[1] >= 0.)*2 + int(delta_d[2] >= 0.)*4;
+    }
 
-      //Find the index in the array
-      int id = int(octant[0]) + int(octant[1])*2 +int(octant[2])*4;
+    /** Counts a neighbor in octant \c id. Returns false if that octant 
+    * already has its maximum number of neighbors.
+    */
+    bool admit_octant( int id ) {
       if(octant_registrar_[id] >= max_per_octant_) return false;
       octant_registrar_[id]++;
 
@@ -338,13 +338,24 @@ public:
 			GsTLInt j = (inxy - index%max_iter_[0])/max_iter_[0]; 
 			GsTLInt i = inxy%max_iter_[0]; 
 			
-			return i*one_step_[0] + j*one_step_[1] + k*one_step_[2]; 
-		} 
-	} 
-	
-	
-	
-	
+			return i*one_step_[0] + j*one_step_[1] + k*one_step_[2];
+		}
+	}
+
+	/** Computes the coordinates (i,j,k) in the finest grid of node
+	* \c node_id, whatever the current multigrid level.
+	*/
+	void fine_coords( GsTLInt node_id, int& i, int& j, int& k ) const
+	{
+		GsTLInt inxy = node_id % max_nxy_;
+		k = (node_id - inxy)/max_nxy_;
+		j = (inxy - node_id%max_dim_[0])/max_dim_[0];
+		i = inxy%max_dim_[0];
+	}
+
+
+
+
 	/** The location in the current 
 	* multigrid coordinate system of node-id "node_id" is computed and 
 	* output to x,y,z. 
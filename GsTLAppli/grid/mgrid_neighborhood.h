@@ -44,6 +44,16 @@ public:
 		const Covariance<GsTLPoint>* cov = 0 ); 
 	~MgridNeighborhood() {}
 	 virtual void find_neighbors( const Geovalue& center ); 
+
+	 // the fast path of Rgrid_ellips_neighborhood works on the linear node-ids
+	 // of the full grid, not on the ids of the active cells
+	 virtual void find_neighbors_batch( Geostat_grid* grid, GsTLGridProperty* prop,
+	                                    const GsTLInt* node_ids, int count,
+	                                    Neighbor_batch& batch, 
+	                                    bool with_distances = false ) {
+	   Neighborhood::find_neighbors_batch( grid, prop, node_ids, count, 
+	                                       batch, with_distances );
+	 }
 protected:
 	 MaskedGridCursor * _mcursor;
 
@@ -74,6 +84,16 @@ public:
 		const Covariance<GsTLPoint>* cov = 0 ); 
 	~MgridNeighborhood_hd() {}
 	virtual void find_neighbors( const Geovalue& center ); 
+
+	 // the fast path of Rgrid_ellips_neighborhood works on the linear node-ids
+	 // of the full grid, not on the ids of the active cells
+	 virtual void find_neighbors_batch( Geostat_grid* grid, GsTLGridProperty* prop,
+	                                    const GsTLInt* node_ids, int count,
+	                                    Neighbor_batch& batch, 
+	                                    bool with_distances = false ) {
+	   Neighborhood::find_neighbors_batch( grid, prop, node_ids, count, 
+	                                       batch, with_distances );
+	 }
 protected:
 	MaskedGridCursor * _mcursor;
 };
@@ -22,7 +22,8 @@ HEADERS += angle_convention.h \
            Linear_interpolator_1d.h \
            qpplot.h \
            random_numbers.h \
-           scatterplot.h
+           scatterplot.h \
+           symmetric_solver.h
 SOURCES += box.cpp \
            correlation_measure.cpp \
            correlation_measure_computer.cpp \
@@ -33,7 +34,8 @@ SOURCES += box.cpp \
            Linear_interpolator_1d.cpp \
            qpplot.cpp \
            random_numbers.cpp \
-           scatterplot.cpp
+           scatterplot.cpp \
+           symmetric_solver.cpp
 
 TARGET=GsTLAppli_math
 
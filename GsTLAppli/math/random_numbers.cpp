@@ -55,5 +55,30 @@ STL_generator::operator()( argument_type N ) {
   calls_++;
   double p = Global_random_number_generator::instance()->operator()(); 
   return static_cast<argument_type>( p * double(N) ); 
-} 
- 
+}
+
+
+
+//=======================================
+
+Random_number_stream::Random_number_stream( long int s ) {
+  seed( s );
+}
+
+
+Random_number_stream::Random_number_stream( long int s, long int stream_index ) {
+  // mix the seed and the index (splitmix64 finalizer) so that close seeds
+  // or close indices start far apart in the sequence
+  unsigned long long z = 
+    ( unsigned long long )( s ) * 0x9E3779B97F4A7C15ULL + 
+    ( unsigned long long )( stream_index + 1 ) * 0xBF58476D1CE4E5B9ULL;
+  z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+  z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+  z = z ^ ( z >> 31 );
+  state_ = z & 0xFFFFFFFFFFFFULL;
+}
+
+
+void Random_number_stream::seed( long int s ) {
+  state_ = ( ( ( unsigned long long )( s ) & 0xFFFFFFFFULL ) << 16 ) | 0x330EULL;
+}
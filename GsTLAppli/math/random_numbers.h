@@ -104,4 +104,56 @@ STL_generator::operator()( argument_type N ) {
 } 
 */
 
+/** Random_number_stream is a random number generator that owns its state,
+ * unlike Random_number_generator which draws from the global generator. 
+ * Several streams can therefore be used concurrently, eg one per 
+ * realization when realizations are simulated in parallel.
+ * The numbers are generated with the drand48 linear congruential scheme.
+ * A stream is identified by a seed and an index: streams built from the
+ * same seed and different indices give unrelated sequences, and a given 
+ * (seed, index) always gives the same sequence.
+ *
+ * Random_number_stream is a model of the GsTL RandomNumberGenerator concept,
+ * and operator()(N) makes it usable with std::random_shuffle.
+ */
+class MATH_DECL Random_number_stream {
+ public:
+  typedef double return_type;
+  typedef int argument_type;
+
+ public:
+  explicit Random_number_stream( long int seed = 211175 );
+  Random_number_stream( long int seed, long int stream_index );
+
+  /** Re-initializes the stream the same way srand48 does
+  */
+  void seed( long int s );
+
+  /** Returns a number uniformly distributed in [0,1)
+  */
+  inline return_type operator()();
+
+  /** Returns an integer uniformly distributed in [0,N)
+  */
+  inline argument_type operator()( argument_type N );
+
+ private:
+  // only the 48 low bits are used
+  unsigned long long state_;
+};
+
+
+inline Random_number_stream::return_type 
+Random_number_stream::operator()() {
+  state_ = ( 0x5DEECE66DULL * state_ + 0xBULL ) & 0xFFFFFFFFFFFFULL;
+  return double( state_ ) / 281474976710656.0;   // 2^48
+}
+
+inline Random_number_stream::argument_type 
+Random_number_stream::operator()( argument_type N ) {
+  argument_type n = static_cast<argument_type>( this->operator()() * double(N) );
+  return n < N ? n : N-1;
+}
+
+
 #endif 
@@ -0,0 +1,180 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "math" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/math/symmetric_solver.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+bool Symmetric_system_solver::factorize( const double* A, int n, 
+                                         bool try_cholesky ) {
+  n_ = n;
+  method_ = NOT_FACTORIZED;
+  if( n <= 0 ) return false;
+
+  factors_.assign( A, A + n*n );
+
+  // A positive definite matrix has a positive diagonal: saddle-point 
+  // systems go to the LU decomposition right away
+  bool positive_diagonal = try_cholesky;
+  for( int i = 0; i < n && positive_diagonal; i++ ) 
+    positive_diagonal = A[ i*n + i ] > 0;
+
+  if( positive_diagonal ) {
+    if( cholesky() ) {
+      method_ = CHOLESKY;
+      return true;
+    }
+    factors_.assign( A, A + n*n );
+  }
+
+  if( lu() ) {
+    method_ = LU;
+    return true;
+  }
+  return false;
+}
+
+
+// Computes the lower triangular L such that A = L.Lt, row by row. The 
+// inner products run over contiguous parts of two rows of L. The systems
+// are small enough for the whole matrix to stay in the L1 cache, so the
+// factorization is not split into blocks.
+bool Symmetric_system_solver::cholesky() {
+  const int n = n_;
+  double* L = &factors_[0];
+
+  double max_diagonal = 0;
+  for( int i = 0; i < n; i++ )
+    max_diagonal = std::max( max_diagonal, L[ i*n + i ] );
+  const double epsilon = 1e-12 * max_diagonal;
+
+  for( int i = 0; i < n; i++ ) {
+    double* row_i = L + i*n;
+    for( int j = 0; j < i; j++ ) {
+      const double* row_j = L + j*n;
+      double sum = row_i[j];
+      for( int k = 0; k < j; k++ )
+        sum -= row_i[k] * row_j[k];
+      row_i[j] = sum / row_j[j];
+    }
+
+    double sum = row_i[i];
+    for( int k = 0; k < i; k++ )
+      sum -= row_i[k] * row_i[k];
+    if( sum <= epsilon ) return false;
+    row_i[i] = std::sqrt( sum );
+  }
+
+  return true;
+}
+
+
+// P.A = L.U, L has a unit diagonal. Rows are swapped as a whole, so the
+// pivots are applied to the right hand side in order.
+bool Symmetric_system_solver::lu() {
+  const int n = n_;
+  double* lu = &factors_[0];
+  pivots_.resize( n );
+
+  double max_abs = 0;
+  for( int i = 0; i < n*n; i++ )
+    max_abs = std::max( max_abs, std::fabs( lu[i] ) );
+  const double epsilon = 1e-12 * max_abs;
+
+  for( int k = 0; k < n; k++ ) {
+    int pivot = k;
+    for( int i = k+1; i < n; i++ ) {
+      if( std::fabs( lu[ i*n + k ] ) > std::fabs( lu[ pivot*n + k ] ) )
+        pivot = i;
+    }
+    if( std::fabs( lu[ pivot*n + k ] ) <= epsilon ) return false;
+
+    pivots_[k] = pivot;
+    if( pivot != k ) 
+      std::swap_ranges( lu + k*n, lu + (k+1)*n, lu + pivot*n );
+
+    const double* row_k = lu + k*n;
+    const double inv_pivot = 1.0 / row_k[k];
+    for( int i = k+1; i < n; i++ ) {
+      double* row_i = lu + i*n;
+      double factor = row_i[k] * inv_pivot;
+      row_i[k] = factor;
+      if( factor == 0 ) continue;
+      for( int j = k+1; j < n; j++ )
+        row_i[j] -= factor * row_k[j];
+    }
+  }
+
+  return true;
+}
+
+
+void Symmetric_system_solver::solve( double* b ) const {
+  const int n = n_;
+  const double* f = &factors_[0];
+
+  if( method_ == CHOLESKY ) {
+    // L.y = b ...
+    for( int i = 0; i < n; i++ ) {
+      const double* row = f + i*n;
+      double sum = b[i];
+      for( int k = 0; k < i; k++ )
+        sum -= row[k] * b[k];
+      b[i] = sum / row[i];
+    }
+    // ... then Lt.x = y, reading L row by row
+    for( int i = n-1; i >= 0; i-- ) {
+      const double* row = f + i*n;
+      b[i] /= row[i];
+      const double x = b[i];
+      for( int k = 0; k < i; k++ )
+        b[k] -= row[k] * x;
+    }
+    return;
+  }
+
+  for( int k = 0; k < n; k++ ) {
+    if( pivots_[k] != k ) std::swap( b[k], b[ pivots_[k] ] );
+  }
+  for( int i = 1; i < n; i++ ) {
+    const double* row = f + i*n;
+    double sum = b[i];
+    for( int k = 0; k < i; k++ )
+      sum -= row[k] * b[k];
+    b[i] = sum;
+  }
+  for( int i = n-1; i >= 0; i-- ) {
+    const double* row = f + i*n;
+    double sum = b[i];
+    for( int k = i+1; k < n; k++ )
+      sum -= row[k] * b[k];
+    b[i] = sum / row[i];
+  }
+}
@@ -0,0 +1,83 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "math" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#ifndef __GSTLAPPLI_MATH_SYMMETRIC_SOLVER_H__
+#define __GSTLAPPLI_MATH_SYMMETRIC_SOLVER_H__
+
+
+#include <GsTLAppli/math/common.h>
+
+#include <vector>
+
+
+/** Symmetric_system_solver solves the small dense symmetric systems of 
+* kriging (a few tens of unknowns). The matrix is factorized once, then 
+* any number of right hand sides can be solved.
+* Simple kriging systems are positive definite and are factorized with
+* a Cholesky decomposition. The systems of ordinary kriging and kriging 
+* with a trend (saddle-point systems, with zeros on the diagonal) and the 
+* matrices found not to be positive definite during the Cholesky 
+* decomposition are factorized by LU decomposition with partial pivoting.
+*
+* The matrices are stored row by row: A(i,j) = A[ i*n + j ].
+*/
+class MATH_DECL Symmetric_system_solver {
+ public:
+  enum Method { NOT_FACTORIZED, CHOLESKY, LU };
+
+ public:
+  Symmetric_system_solver() : n_( 0 ), method_( NOT_FACTORIZED ) {}
+
+  /** Factorizes the \a n by \a n symmetric matrix \a A. If \a try_cholesky
+  * is false, the LU decomposition is used whatever the matrix.
+  * @return false if the matrix is singular.
+  */
+  bool factorize( const double* A, int n, bool try_cholesky = true );
+
+  /** Solves A.x = b. \a b is overwritten by the solution x.
+  * factorize() must have succeeded.
+  */
+  void solve( double* b ) const;
+
+  Method method() const { return method_; }
+  int size() const { return n_; }
+
+ private:
+  bool cholesky();
+  bool lu();
+
+ private:
+  int n_;
+  Method method_;
+  std::vector<double> factors_;
+  std::vector<int> pivots_;
+};
+
+
+
+#endif
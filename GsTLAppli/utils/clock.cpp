@@ -117,3 +117,38 @@ int Qt_clock::elapsed() {
   int ms = timer_->elapsed();
   return ms;
 } 
+
+
+
+//========================================
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+// current time, in milliseconds
+static double precise_time() {
+#ifdef WIN32
+  LARGE_INTEGER frequency, count;
+  QueryPerformanceFrequency( &frequency );
+  QueryPerformanceCounter( &count );
+  return 1000.0 * double( count.QuadPart ) / double( frequency.QuadPart );
+#else
+  timeval tv;
+  gettimeofday( &tv, 0 );
+  return 1000.0 * double( tv.tv_sec ) + double( tv.tv_usec ) / 1000.0;
+#endif
+}
+
+Precise_clock::Precise_clock() {
+  start();
+}
+
+void Precise_clock::start() {
+  start_ = precise_time();
+}
+
+double Precise_clock::elapsed() const {
+  return precise_time() - start_;
+}
@@ -154,6 +154,29 @@ public:
 private:
   QTime* timer_;
 };
+
+
+
+//=========================
+
+/** Precise_clock measures short durations (down to the microsecond), 
+* such as a single call to a small function. Qt_clock only counts whole 
+* milliseconds.
+*/
+class UTILS_DECL Precise_clock {
+public:
+  Precise_clock() ;
+
+  void start();
+
+  /** Returns the time elapsed since the last call to start(), in 
+  * milliseconds.
+  */
+  double elapsed() const;
+
+private:
+  double start_;
+};
  
  
 #endif 
@@ -0,0 +1,184 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "utils" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#include <GsTLAppli/utils/parallel_tasks.h>
+#include <GsTLAppli/utils/progress_notifier.h>
+#include <GsTLAppli/utils/string_manipulation.h>
+
+#include <QThread>
+#include <QAtomicInt>
+
+#include <vector>
+#include <algorithm>
+
+
+Parallel_progress::Parallel_progress( Progress_notifier* notifier )
+  : notifier_( notifier ), direct_( false ) {
+  pending_ = new QAtomicInt( 0 );
+  cancelled_ = new QAtomicInt( 0 );
+}
+
+Parallel_progress::~Parallel_progress() {
+  delete pending_;
+  delete cancelled_;
+}
+
+bool Parallel_progress::notify() {
+  if( direct_ ) {
+    if( notifier_ && !notifier_->notify() ) cancel();
+    return !is_cancelled();
+  }
+
+  pending_->ref();
+  return !is_cancelled();
+}
+
+bool Parallel_progress::forward() {
+  int steps = pending_->fetchAndStoreOrdered( 0 );
+  if( notifier_ ) {
+    for( int i = 0; i < steps; i++ ) {
+      if( !notifier_->notify() ) {
+        cancel();
+        break;
+      }
+    }
+  }
+  return !is_cancelled();
+}
+
+void Parallel_progress::cancel() {
+  cancelled_->fetchAndStoreOrdered( 1 );
+}
+
+bool Parallel_progress::is_cancelled() const {
+  return cancelled_->fetchAndAddOrdered( 0 ) != 0;
+}
+
+
+
+//=======================================
+namespace {
+
+// The jobs are handed out one at a time from a shared counter, so that 
+// a slow job does not hold back the jobs queued behind it.
+class Job_queue {
+public:
+  Job_queue( Parallel_task& task, int jobs_count, Parallel_progress* progress )
+    : task_( task ), jobs_count_( jobs_count ), progress_( progress ),
+      next_( 0 ), failed_( 0 ) {}
+
+  void run_jobs( int thread_id ) {
+    while( !failed() && !( progress_ && progress_->is_cancelled() ) ) {
+      int index = next_.fetchAndAddOrdered( 1 );
+      if( index >= jobs_count_ ) return;
+
+      if( !task_.run( index, thread_id ) ) {
+        failed_.fetchAndStoreOrdered( 1 );
+        if( progress_ ) progress_->cancel();
+      }
+    }
+  }
+
+  bool failed() const { return failed_.fetchAndAddOrdered( 0 ) != 0; }
+
+private:
+  Parallel_task& task_;
+  const int jobs_count_;
+  Parallel_progress* progress_;
+  mutable QAtomicInt next_;
+  mutable QAtomicInt failed_;
+};
+
+
+class Worker_thread : public QThread {
+public:
+  Worker_thread( Job_queue& queue, int thread_id ) 
+    : queue_( queue ), thread_id_( thread_id ) {}
+
+protected:
+  virtual void run() { queue_.run_jobs( thread_id_ ); }
+
+private:
+  Job_queue& queue_;
+  int thread_id_;
+};
+
+}
+
+
+
+namespace utils {
+
+int thread_count( int requested ) {
+  if( requested > 0 ) return requested;
+  return std::max( QThread::idealThreadCount(), 1 );
+}
+
+
+int nb_threads_parameter( const std::string& value ) {
+  if( value.empty() ) return 0;
+  return String_Op::to_number<int>( value );
+}
+
+
+bool run_parallel( Parallel_task& task, int jobs_count, int nb_threads,
+                   Parallel_progress* progress ) {
+  if( jobs_count <= 0 ) return true;
+  nb_threads = std::min( thread_count( nb_threads ), jobs_count );
+
+  Job_queue queue( task, jobs_count, progress );
+
+  if( nb_threads == 1 ) {
+    if( progress ) progress->forward_immediately( true );
+    queue.run_jobs( 0 );
+    if( progress ) progress->forward_immediately( false );
+  }
+  else {
+    std::vector<Worker_thread*> threads;
+    for( int i = 0; i < nb_threads; i++ ) {
+      threads.push_back( new Worker_thread( queue, i ) );
+      threads.back()->start();
+    }
+
+    // forward the progress while waiting for the workers
+    for( int i = 0; i < nb_threads; i++ ) {
+      while( !threads[i]->wait( 100 ) ) {
+        if( progress ) progress->forward();
+      }
+    }
+    if( progress ) progress->forward();
+
+    for( int i = 0; i < nb_threads; i++ )
+      delete threads[i];
+  }
+
+  if( queue.failed() ) return false;
+  return !( progress && progress->is_cancelled() );
+}
+
+}
@@ -0,0 +1,132 @@
+/**********************************************************************
+** Author: Nicolas Remy
+** Copyright (C) 2002-2004 The Board of Trustees of the Leland Stanford Junior
+**   University
+** All rights reserved.
+**
+** This file is part of the "utils" module of the Geostatistical Earth
+** Modeling Software (GEMS)
+**
+** This file may be distributed and/or modified under the terms of the 
+** license defined by the Stanford Center for Reservoir Forecasting and 
+** appearing in the file LICENSE.XFREE included in the packaging of this file.
+**
+** This file may be distributed and/or modified under the terms of the
+** GNU General Public License version 2 as published by the Free Software
+** Foundation and appearing in the file LICENSE.GPL included in the
+** packaging of this file.
+**
+** This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+** WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+**
+** See http://www.gnu.org/copyleft/gpl.html for GPL licensing information.
+**
+** Contact the Stanford Center for Reservoir Forecasting, Stanford University
+** if any conditions of this licensing are not clear to you.
+**
+**********************************************************************/
+
+#ifndef __GSTLAPPLI_UTILS_PARALLEL_TASKS_H__
+#define __GSTLAPPLI_UTILS_PARALLEL_TASKS_H__
+
+#include <GsTLAppli/utils/common.h>
+
+#include <string>
+
+class Progress_notifier;
+class QAtomicInt;
+
+
+/** Parallel_progress lets several threads report their progress to a 
+* single Progress_notifier. Progress notifiers are not thread-safe (they 
+* usually drive a dialog box): the worker threads only count the steps they
+* complete by calling notify(), and the thread that owns the notifier 
+* forwards those steps to the notifier by calling forward().
+* If the notifier interrupts the task, notify() returns false in every 
+* thread.
+* Parallel_progress can be passed to the GsTL algorithms in place of a 
+* Progress_notifier.
+*/
+class UTILS_DECL Parallel_progress {
+public:
+  Parallel_progress( Progress_notifier* notifier );
+  ~Parallel_progress();
+
+  /** Signals that a step has been completed. Can be called from any thread.
+  * @return false if the task was interrupted.
+  */
+  bool notify();
+
+  /** Passes the steps completed since the last call to the notifier.
+  * Must only be called by the thread that owns the notifier.
+  * @return false if the task was interrupted.
+  */
+  bool forward();
+
+  void cancel();
+  bool is_cancelled() const;
+
+  /** If \c on is true, notify() forwards the steps at once. This is only 
+  * possible if all the steps are completed by the thread that owns the
+  * notifier.
+  */
+  void forward_immediately( bool on ) { direct_ = on; }
+
+private:
+  Progress_notifier* notifier_;
+  QAtomicInt* pending_;
+  QAtomicInt* cancelled_;
+  bool direct_;
+
+  Parallel_progress( const Parallel_progress& );
+  Parallel_progress& operator=( const Parallel_progress& );
+};
+
+
+
+/** A Parallel_task is a set of jobs, identified by an index in 
+* [0, jobs count), that can be run concurrently and in any order.
+*/
+class UTILS_DECL Parallel_task {
+public:
+  virtual ~Parallel_task() {}
+
+  /** Runs job \c index. \c thread_id, in [0, number of threads), identifies 
+  * the thread running the job: two jobs running at the same time never have 
+  * the same thread_id, so it can be used to select per-thread objects 
+  * (neighborhoods, buffers, ...).
+  * @return false if the job failed. The jobs not yet started are then 
+  * cancelled.
+  */
+  virtual bool run( int index, int thread_id ) = 0;
+};
+
+
+
+namespace utils {
+
+  /** Returns the number of threads to use when \c requested threads are 
+  * asked for: a value less than 1 means one thread per processor core.
+  */
+  UTILS_DECL int thread_count( int requested );
+
+  /** Reads the number of threads from the value of an algorithm's 
+  * "Nb_Threads" parameter. Older parameter files do not have that 
+  * parameter: an empty \c value gives 0, ie the algorithm runs serially.
+  */
+  UTILS_DECL int nb_threads_parameter( const std::string& value );
+
+  /** Runs jobs 0 to \c jobs_count-1 of \c task on \c nb_threads threads, and
+  * waits for them to complete. While waiting, the calling thread forwards
+  * the steps reported to \c progress (which can be 0) to its notifier.
+  * If \c nb_threads is 1, the jobs are run in order by the calling thread.
+  * @return false if a job failed or if the task was interrupted.
+  */
+  UTILS_DECL bool run_parallel( Parallel_task& task, int jobs_count, 
+                                int nb_threads, 
+                                Parallel_progress* progress = 0 );
+
+}
+
+
+#endif
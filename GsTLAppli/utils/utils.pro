@@ -23,6 +23,7 @@ HEADERS += clock.h \
            lineeditkey.h \
            manager.h \
            named_interface.h \
+           parallel_tasks.h \
            progress_notifier.h \
            simpleps.h \
            singleton_holder.h \
@@ -33,6 +34,7 @@ SOURCES += clock.cpp \
            gstl_messages_private.cpp \
            main.cpp \
            manager.cpp \
+           parallel_tasks.cpp \
            progress_notifier.cpp \
            simpleps.cpp \
            string_manipulation.cpp